@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "checksum.h"
+#include "dberror.h"
+#include "storage_mgr.h"
+
+/* benchmark files */
+#define BENCH_PLAIN "bench_plain.bin"
+#define BENCH_CRC "bench_crc.bin"
+
+#define BENCH_PAGES 2048
+#define BENCH_ROUNDS 20
+
+static double
+nowNs (void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// ns per page to checksum BENCH_PAGES pages with the given function
+static double
+benchChecksum (uint32_t (*fn) (const void *, size_t), char *pages)
+{
+	volatile uint32_t sink = 0;
+	double start = nowNs();
+
+	for (int round = 0; round < BENCH_ROUNDS; round++)
+		for (int i = 0; i < BENCH_PAGES; i++)
+			sink ^= fn(pages + (size_t) i * PAGE_SIZE, PAGE_SIZE - PAGE_CHECKSUM_SIZE);
+	(void) sink;
+	return (nowNs() - start) / (BENCH_ROUNDS * BENCH_PAGES);
+}
+
+// ns per page to write and then read back BENCH_PAGES pages of a page file
+static void
+benchPageFile (char *name, int flags, char *pages, double *writeNs, double *readNs, double *directNs)
+{
+	SM_FileHandle fh;
+	SM_FileOptions options = { flags };
+	double start;
+	void *aligned;
+
+	CHECK(createPageFileWithOptions(name, &options));
+	CHECK(openPageFile(name, &fh));
+	CHECK(ensureCapacity(BENCH_PAGES, &fh));
+
+	start = nowNs();
+	for (int round = 0; round < BENCH_ROUNDS; round++)
+		for (int i = 0; i < BENCH_PAGES; i++)
+			CHECK(writeBlock(i, &fh, pages + (size_t) i * PAGE_SIZE));
+	*writeNs = (nowNs() - start) / (BENCH_ROUNDS * BENCH_PAGES);
+
+	// reads are served from the page cache, the worst case for relative overhead
+	start = nowNs();
+	for (int round = 0; round < BENCH_ROUNDS; round++)
+		for (int i = 0; i < BENCH_PAGES; i++)
+			CHECK(readBlock(i, &fh, pages + (size_t) i * PAGE_SIZE));
+	*readNs = (nowNs() - start) / (BENCH_ROUNDS * BENCH_PAGES);
+	CHECK(closePageFile(&fh));
+
+	// O_DIRECT reads go to the device and show the overhead against real I/O
+	if (posix_memalign(&aligned, SM_DIRECT_IO_ALIGNMENT, PAGE_SIZE) != 0)
+		exit(1);
+	CHECK(openPageFileWithFlags(name, &fh, SM_OPEN_DIRECT));
+	start = nowNs();
+	for (int i = 0; i < BENCH_PAGES; i++)
+		CHECK(readBlock(i, &fh, (SM_PageHandle) aligned));
+	*directNs = (nowNs() - start) / BENCH_PAGES;
+	CHECK(closePageFile(&fh));
+	free(aligned);
+
+	CHECK(destroyPageFile(name));
+}
+
+int
+main (void)
+{
+	char *pages = (char *) malloc((size_t) BENCH_PAGES * PAGE_SIZE);
+	double hwNs, swNs, plainWrite, plainRead, plainDirect, crcWrite, crcRead, crcDirect;
+
+	for (size_t i = 0; i < (size_t) BENCH_PAGES * PAGE_SIZE; i++)
+		pages[i] = (char) (rand() & 0xff);
+
+	hwNs = benchChecksum(crc32c, pages);
+	swNs = benchChecksum(crc32cSoftware, pages);
+	benchPageFile(BENCH_PLAIN, 0, pages, &plainWrite, &plainRead, &plainDirect);
+	benchPageFile(BENCH_CRC, SM_FILE_CHECKSUM, pages, &crcWrite, &crcRead, &crcDirect);
+
+	printf("crc32c implementation : %s\n", crc32cImplementation());
+	printf("crc32c per 4 KB page  : %8.1f ns (%.2f GB/s)\n", hwNs, PAGE_SIZE / hwNs);
+	printf("software per 4 KB page: %8.1f ns (%.2f GB/s)\n", swNs, PAGE_SIZE / swNs);
+	printf("writeBlock plain      : %8.1f ns/page\n", plainWrite);
+	printf("writeBlock checksummed: %8.1f ns/page (%+.2f%%)\n", crcWrite,
+			100.0 * (crcWrite - plainWrite) / plainWrite);
+	printf("readBlock plain       : %8.1f ns/page (page cache hit)\n", plainRead);
+	printf("readBlock checksummed : %8.1f ns/page (%+.2f%%)\n", crcRead,
+			100.0 * (crcRead - plainRead) / plainRead);
+	printf("O_DIRECT read plain   : %8.1f ns/page (device)\n", plainDirect);
+	printf("O_DIRECT read checksum: %8.1f ns/page\n", crcDirect);
+	printf("checksum share of device read: %.2f%%\n", 100.0 * hwNs / plainDirect);
+
+	free(pages);
+	return 0;
+}
@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "buffer_mgr.h"
+#include "dberror.h"
+#include "storage_backend.h"
+#include "storage_mgr.h"
+
+/* buffer pool on a simulated network-attached disk: "slow:" wraps a
+ * "mem:" file so only the injected delays are measured */
+#define BENCH_FILE "slow:mem:bench_pool"
+
+#define BENCH_PAGES 1024
+#define BENCH_FRAMES 64
+#define BENCH_PINS 4096
+
+static double
+nowMs (void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// pins BENCH_PINS pages (a scan, or a skewed random pattern with 90% of the
+// pins on a hot tenth of the file), dirtying every writeEvery-th one
+static void
+benchPool (const char *label, ReplacementStrategy strategy, int random, int writeEvery)
+{
+	BM_BufferPool *bm = MAKE_POOL();
+	BM_PageHandle *h = MAKE_PAGE_HANDLE();
+	SM_SlowBackendStats stats;
+	double start, pinMs, flushMs;
+
+	srand(7);
+	CHECK(initBufferPool(bm, BENCH_FILE, BENCH_FRAMES, strategy, NULL));
+	start = nowMs();
+	for (int i = 0; i < BENCH_PINS; i++) {
+		PageNumber page;
+		if (!random)
+			page = i % BENCH_PAGES;
+		else if (rand() % 10 < 9)
+			page = rand() % (BENCH_PAGES / 10);
+		else
+			page = rand() % BENCH_PAGES;
+		CHECK(pinPage(bm, h, page));
+		if (writeEvery && i % writeEvery == 0)
+			CHECK(markDirty(bm, h));
+		CHECK(unpinPage(bm, h));
+	}
+	pinMs = nowMs() - start;
+	start = nowMs();
+	CHECK(forceFlushPool(bm));
+	flushMs = nowMs() - start;
+
+	printf("%-24s %-4s : %7.1f ms pins, %6.1f ms flush, %5d reads, %5d writes",
+			label, strategy == RS_FIFO ? "FIFO" : "LRU", pinMs, flushMs,
+			getNumReadIO(bm), getNumWriteIO(bm));
+	CHECK(shutdownBufferPool(bm));
+	getSlowBackendStats(&stats);
+	printf(", %ld slow I/Os\n", stats.slowIOs);
+
+	free(bm);
+	free(h);
+}
+
+int
+main (int argc, char *argv[])
+{
+	SM_SlowBackendConfig config;
+	SM_FileHandle fh;
+
+	memset(&config, 0, sizeof(config));
+	config.distribution = SM_LATENCY_NORMAL;
+	config.readLatencyMicros = argc > 1 ? atol(argv[1]) : 200;
+	config.writeLatencyMicros = config.readLatencyMicros;
+	config.syncLatencyMicros = 4 * config.readLatencyMicros;
+	config.jitterMicros = config.readLatencyMicros / 4;
+	config.bandwidthBytesPerSec = argc > 2 ? atol(argv[2]) : 100L * 1024 * 1024;
+	config.slowFraction = 0.01;
+	config.slowLatencyMicros = 20 * config.readLatencyMicros;
+	config.seed = 1;
+
+	CHECK(createPageFile(BENCH_FILE));
+	CHECK(openPageFile(BENCH_FILE, &fh));
+	CHECK(ensureCapacity(BENCH_PAGES, &fh));
+	CHECK(closePageFile(&fh));
+
+	printf("latency %ld us (normal, jitter %ld us), %ld B/s, %.0f%% slow I/Os of %ld us\n",
+			config.readLatencyMicros, config.jitterMicros, config.bandwidthBytesPerSec,
+			100 * config.slowFraction, config.slowLatencyMicros);
+	printf("%d pins of %d pages through %d frames\n", BENCH_PINS, BENCH_PAGES, BENCH_FRAMES);
+
+	setSlowBackendConfig(&config);
+	benchPool("sequential scan", RS_FIFO, 0, 0);
+	setSlowBackendConfig(&config);
+	benchPool("sequential scan", RS_LRU, 0, 0);
+	setSlowBackendConfig(&config);
+	benchPool("skewed random reads", RS_FIFO, 1, 0);
+	setSlowBackendConfig(&config);
+	benchPool("skewed random reads", RS_LRU, 1, 0);
+	setSlowBackendConfig(&config);
+	benchPool("skewed random, 1/4 dirty", RS_FIFO, 1, 4);
+	setSlowBackendConfig(&config);
+	benchPool("skewed random, 1/4 dirty", RS_LRU, 1, 4);
+
+	setSlowBackendConfig(NULL);
+	CHECK(destroyPageFile(BENCH_FILE));
+	return 0;
+}
@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dberror.h"
+#include "expr.h"
+#include "record_mgr.h"
+#include "storage_backend.h"
+#include "tables.h"
+
+/* full-table scans of an in-memory table ("mem:", measures the scan code
+ * alone) and of the same table behind simulated disk latency ("slow:") */
+#define BENCH_TABLE "mem:bench_scan"
+#define BENCH_SLOW_TABLE "slow:mem:bench_scan"
+#define BENCH_ROWS 1000000
+#define BENCH_LOAD_BATCH 10000
+#define BENCH_MAX_WORKERS 64
+
+static double
+nowMs (void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static Schema *
+benchSchema (void)
+{
+	char **names = (char **) malloc(sizeof(char *) * 3);
+	DataType *types = (DataType *) malloc(sizeof(DataType) * 3);
+	int *lengths = (int *) malloc(sizeof(int) * 3);
+	int *keys = (int *) malloc(sizeof(int));
+
+	names[0] = strdup("a");
+	names[1] = strdup("b");
+	names[2] = strdup("c");
+	types[0] = DT_INT;
+	types[1] = DT_STRING;
+	types[2] = DT_INT;
+	lengths[0] = 0;
+	lengths[1] = 16;
+	lengths[2] = 0;
+	keys[0] = 0;
+	return createSchema(3, names, types, lengths, 1, keys);
+}
+
+// scans the table once and reports rows and bytes per second
+static void
+benchScan (const char *label, char *table, Expr *cond)
+{
+	RM_TableData rel;
+	RM_ScanHandle sc;
+	Record *r;
+	double start, ms;
+	long rows = 0;
+	RC rc;
+
+	CHECK(openTable(&rel, table));
+	CHECK(createRecord(&r, rel.schema));
+	start = nowMs();
+	CHECK(startScan(&rel, &sc, cond));
+	while ((rc = next(&sc, r)) == RC_OK)
+		rows++;
+	if (rc != RC_RM_NO_MORE_TUPLES)
+		CHECK(rc);
+	CHECK(closeScan(&sc));
+	ms = nowMs() - start;
+
+	printf("%-28s : %8.1f ms, %8ld rows, %7.2f Mrows/s, %7.1f MB/s\n", label, ms, rows,
+			BENCH_ROWS / ms / 1e3,
+			(double) BENCH_ROWS * getRecordSize(rel.schema) / ms / 1e3);
+	freeRecord(r);
+	CHECK(closeTable(&rel));
+}
+
+// scans the table in batches of columns, summing column a in a tight loop
+static void
+benchBatchScan (int capacity, char *table, Expr *cond)
+{
+	RM_TableData rel;
+	RM_ScanHandle sc;
+	RM_ColumnBatch *batch;
+	double start, ms;
+	long rows = 0, sum = 0;
+	char label[32];
+	RC rc;
+
+	CHECK(openTable(&rel, table));
+	CHECK(createColumnBatch(&batch, rel.schema, capacity));
+	start = nowMs();
+	CHECK(startScan(&rel, &sc, cond));
+	while ((rc = nextBatch(&sc, batch)) == RC_OK) {
+		int *a = (int *) batch->columns[0];
+		for (int i = 0; i < batch->numSelected; i++)
+			sum += a[batch->selection[i]];
+		rows += batch->numSelected;
+	}
+	if (rc != RC_RM_NO_MORE_TUPLES)
+		CHECK(rc);
+	CHECK(closeScan(&sc));
+	ms = nowMs() - start;
+
+	snprintf(label, sizeof(label), "batches of %d", capacity);
+	printf("%-28s : %8.1f ms, %8ld rows, %7.2f Mrows/s (sum %ld)\n", label, ms, rows,
+			BENCH_ROWS / ms / 1e3, sum);
+	CHECK(freeColumnBatch(batch));
+	CHECK(closeTable(&rel));
+}
+
+static RC
+countMatch (int worker, Record *record, void *context)
+{
+	((long *) context)[worker * 8]++;	/* a cache line per worker */
+	return RC_OK;
+}
+
+// parallelScan with the given number of workers
+static void
+benchParallelScan (int numWorkers, char *table, Expr *cond)
+{
+	static long counts[BENCH_MAX_WORKERS * 8];
+	RM_TableData rel;
+	double start, ms;
+	long rows = 0;
+	char label[32];
+
+	memset(counts, 0, sizeof(counts));
+	CHECK(openTable(&rel, table));
+	start = nowMs();
+	CHECK(parallelScan(&rel, cond, numWorkers, countMatch, counts));
+	ms = nowMs() - start;
+	for (int i = 0; i < numWorkers; i++)
+		rows += counts[i * 8];
+
+	snprintf(label, sizeof(label), "parallel, %d workers", numWorkers);
+	printf("%-28s : %8.1f ms, %8ld rows, %7.2f Mrows/s\n", label, ms, rows, BENCH_ROWS / ms / 1e3);
+	CHECK(closeTable(&rel));
+}
+
+int
+main (int argc, char *argv[])
+{
+	SM_SlowBackendConfig config;
+	Schema *schema = benchSchema();
+	Record **records = (Record **) malloc(sizeof(Record *) * BENCH_LOAD_BATCH);
+	RM_TableData rel;
+	Expr *sel, *left, *right;
+	char text[16];
+
+	CHECK(initRecordManager(NULL));
+	CHECK(createTable(BENCH_TABLE, schema));
+	CHECK(openTable(&rel, BENCH_TABLE));
+	for (int i = 0; i < BENCH_LOAD_BATCH; i++)
+		CHECK(createRecord(&records[i], schema));
+	for (int done = 0; done < BENCH_ROWS; done += BENCH_LOAD_BATCH) {
+		for (int i = 0; i < BENCH_LOAD_BATCH; i++) {
+			int a = done + i, c = a % 100;
+			memset(text, 0, sizeof(text));
+			snprintf(text, sizeof(text), "row%d", a);
+			memcpy(records[i]->data, &a, sizeof(int));
+			memcpy(records[i]->data + sizeof(int), text, 16);
+			memcpy(records[i]->data + sizeof(int) + 16, &c, sizeof(int));
+		}
+		CHECK(insertRecords(&rel, records, BENCH_LOAD_BATCH, NULL));
+	}
+	CHECK(closeTable(&rel));
+	printf("%d rows of %d bytes\n", BENCH_ROWS, getRecordSize(schema));
+
+	// c < 10 selects a tenth of the rows
+	MAKE_ATTRREF(left, 2);
+	MAKE_CONS(right, stringToValue("i10"));
+	MAKE_BINOP_EXPR(sel, left, right, OP_COMP_SMALLER);
+
+	benchScan("memory, all rows", BENCH_TABLE, NULL);
+	benchScan("memory, c < 10", BENCH_TABLE, sel);
+	benchBatchScan(1024, BENCH_TABLE, NULL);
+	benchBatchScan(1024, BENCH_TABLE, sel);
+	for (int workers = 1; workers <= BENCH_MAX_WORKERS; workers *= 2)
+		benchParallelScan(workers, BENCH_TABLE, sel);
+
+	memset(&config, 0, sizeof(config));
+	config.readLatencyMicros = argc > 1 ? atol(argv[1]) : 100;
+	config.bandwidthBytesPerSec = argc > 2 ? atol(argv[2]) : 500L * 1024 * 1024;
+	setSlowBackendConfig(&config);
+	printf("slow disk: %ld us per read, %ld B/s\n", config.readLatencyMicros,
+			config.bandwidthBytesPerSec);
+	benchScan("slow disk, all rows", BENCH_SLOW_TABLE, NULL);
+	benchParallelScan(8, BENCH_SLOW_TABLE, NULL);
+
+	for (int i = 0; i < BENCH_LOAD_BATCH; i++)
+		freeRecord(records[i]);
+	free(records);
+	freeExpr(sel);
+	freeSchema(schema);
+	CHECK(deleteTable(BENCH_TABLE));
+	return 0;
+}
@@ -6,31 +6,265 @@
 #include "storage_mgr.h"
 #include "dberror.h"
 #include "dt.h"
+#include "trace.h"
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-/* Internal structure representing a single frame in the buffer pool */
+/* Internal structure representing a single frame in the buffer pool. Frames hold no
+ * pointers so that shared pools can keep them in shared memory; the page content of
+ * frame i is at frameData(mgmt, i). */
 typedef struct BM_Frame {
-    int pageNum;      // The page number stored in this frame (NO_PAGE if empty)
-    char *data;       // Pointer to the page content (allocated PAGE_SIZE bytes)
+    PageNumber pageNum; // The page number stored in this frame (NO_PAGE if empty)
     int fixCount;     // Number of clients currently pinning this page
     bool dirty;       // TRUE if the page has been modified
     int loadTime;     // Time when the page was loaded (for FIFO)
     int lastUsed;     // Last access time (for LRU)
 } BM_Frame;
 
+/* Header of the shared-memory segment of a shared pool; the frames, one latch per
+ * frame and the page contents follow it */
+#define BM_SHARED_MAGIC "BMSHPOOL"
+
+/* how long a process joining a segment waits for its creator to size and initialize it */
+#define BM_ATTACH_TIMEOUT_MS 5000
+
+typedef struct BM_SharedPool {
+    char magic[8];            // BM_SHARED_MAGIC
+    atomic_int ready;         // set once the creating process has initialized the segment
+    int numFrames;
+    int pageSize;
+    int attached;             // processes using the pool
+    int closed;               // the last process left; the segment is unlinked
+    int time;                 // Global time counter for replacement decisions
+    char pageFile[256];       // page file the frames cache
+    pthread_mutex_t latch;    // guards the header and all frame descriptors
+} BM_SharedPool;
+
 /* Internal management structure for the entire buffer pool */
 typedef struct BM_MgmtData {
     BM_Frame *frames;         // Array of frames
+    char *frameData;          // Page contents, pageSize bytes per frame
     int numFrames;            // Number of frames (same as bm->numPages)
+    int pageSize;             // Bytes per frame
     int readIO;               // Count of page reads from disk
     int writeIO;              // Count of page writes to disk
     int time;                 // Global time counter for replacement decisions
     SM_FileHandle fileHandle; // Storage manager file handle for the page file
+    BM_SharedPool *shared;    // Shared segment (NULL for a private pool)
+    pthread_mutex_t *frameLatches; // Held while a frame is loaded (shared pools only)
+    size_t sharedSize;        // Bytes mapped for the segment
+    char *sharedName;         // Name passed to shm_open
+    int localPins;            // Pins held by this process (shared pools only)
 } BM_MgmtData;
 
+/* 
+ * frameData: Returns the page content of a frame.
+ */
+static char *frameData(BM_MgmtData *mgmt, int frame) {
+    return mgmt->frameData + (size_t) frame * mgmt->pageSize;
+}
+
+/* 
+ * lockLatch: Locks a process-shared latch. A process that died holding it leaves the
+ * latch marked inconsistent; the descriptors it guards are still valid, so it is reclaimed.
+ */
+static void lockLatch(pthread_mutex_t *latch) {
+    if (pthread_mutex_lock(latch) == EOWNERDEAD) {
+         pthread_mutex_consistent(latch);
+    }
+}
+
+/* 
+ * lockPool / unlockPool: Guard the frame descriptors of a shared pool; no-ops otherwise.
+ */
+static void lockPool(BM_MgmtData *mgmt) {
+    if (mgmt->shared != NULL) {
+         lockLatch(&mgmt->shared->latch);
+    }
+}
+
+static void unlockPool(BM_MgmtData *mgmt) {
+    if (mgmt->shared != NULL) {
+         pthread_mutex_unlock(&mgmt->shared->latch);
+    }
+}
+
+/* 
+ * tick: Advances the replacement clock, which shared pools keep in the segment.
+ */
+static int tick(BM_MgmtData *mgmt) {
+    return mgmt->shared != NULL ? ++mgmt->shared->time : ++mgmt->time;
+}
+
+/* 
+ * sharedLayout: Computes where the frames, latches and page contents of a shared
+ * segment start, and returns the size of the whole segment.
+ */
+static size_t sharedLayout(int numFrames, int pageSize, size_t *latchesOffset, size_t *dataOffset) {
+    size_t framesOffset = sizeof(BM_SharedPool);
+    *latchesOffset = framesOffset + sizeof(BM_Frame) * numFrames;
+    *latchesOffset = (*latchesOffset + sizeof(long long) - 1) / sizeof(long long) * sizeof(long long);
+    *dataOffset = *latchesOffset + sizeof(pthread_mutex_t) * numFrames;
+    *dataOffset = (*dataOffset + SM_DIRECT_IO_ALIGNMENT - 1) / SM_DIRECT_IO_ALIGNMENT * SM_DIRECT_IO_ALIGNMENT;
+    return *dataOffset + (size_t) numFrames * pageSize;
+}
+
+/* 
+ * initLatch: Initializes a latch usable across processes that survives its holder dying.
+ */
+static void initLatch(pthread_mutex_t *latch) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(latch, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+/* 
+ * pastDeadline: Tells whether the monotonic clock has passed deadline.
+ */
+static int pastDeadline(const struct timespec *deadline) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec > deadline->tv_sec ||
+           (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec);
+}
+
+/* 
+ * attachSharedPool: Maps the shared segment of a pool, creating and initializing it if no
+ * process has it yet, and registers this process with it.
+ */
+static RC attachSharedPool(BM_MgmtData *mgmt, const char *shmName, const char *pageFileName) {
+    size_t latchesOffset, dataOffset;
+    size_t size = sharedLayout(mgmt->numFrames, mgmt->pageSize, &latchesOffset, &dataOffset);
+
+    for (int attempt = 0; attempt < 100; attempt++) {
+         int created = 1;
+         int fd = shm_open(shmName, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+         if (fd == -1 && errno == EEXIST) {
+              created = 0;
+              fd = shm_open(shmName, O_RDWR, 0);
+         }
+         if (fd == -1) {
+              if (errno == ENOENT) {
+                   continue; // unlinked by its last user in the meantime
+              }
+              TRACE(TRACE_ERROR, TRACE_CAT_BUFFER, TE_ERR_SYSCALL, errno, __LINE__);
+              return RC_FILE_NOT_FOUND;
+         }
+         if (created && ftruncate(fd, size) != 0) {
+              TRACE(TRACE_ERROR, TRACE_CAT_BUFFER, TE_ERR_SYSCALL, errno, __LINE__);
+              close(fd);
+              shm_unlink(shmName);
+              return RC_WRITE_FAILED;
+         }
+         // the creator may not have sized the segment yet; it may also have died or
+         // failed before doing so, so give up after BM_ATTACH_TIMEOUT_MS
+         struct stat st;
+         struct timespec pause = { 0, 1000000 };
+         struct timespec deadline;
+         clock_gettime(CLOCK_MONOTONIC, &deadline);
+         deadline.tv_sec += BM_ATTACH_TIMEOUT_MS / 1000;
+         deadline.tv_nsec += (BM_ATTACH_TIMEOUT_MS % 1000) * 1000000L;
+         if (deadline.tv_nsec >= 1000000000L) {
+              deadline.tv_sec++;
+              deadline.tv_nsec -= 1000000000L;
+         }
+         while (!created) {
+              if (fstat(fd, &st) != 0) {
+                   TRACE(TRACE_ERROR, TRACE_CAT_BUFFER, TE_ERR_SYSCALL, errno, __LINE__);
+                   close(fd);
+                   return RC_FILE_NOT_FOUND;
+              }
+              if ((size_t) st.st_size >= sizeof(BM_SharedPool)) {
+                   break;
+              }
+              if (pastDeadline(&deadline)) {
+                   TRACE(TRACE_ERROR, TRACE_CAT_BUFFER, TE_ERR_SYSCALL, ETIMEDOUT, __LINE__);
+                   close(fd);
+                   return RC_FILE_NOT_FOUND;
+              }
+              nanosleep(&pause, NULL);
+         }
+         if (!created && (size_t) st.st_size != size) {
+              TRACE(TRACE_ERROR, TRACE_CAT_BUFFER, TE_ERR_INVALID_ARGUMENT, (long) st.st_size, __LINE__);
+              close(fd);
+              return RC_INVALID_ARGUMENT;
+         }
+         void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+         close(fd);
+         if (map == MAP_FAILED) {
+              TRACE(TRACE_ERROR, TRACE_CAT_BUFFER, TE_ERR_SYSCALL, errno, __LINE__);
+              if (created) {
+                   shm_unlink(shmName);
+              }
+              return RC_WRITE_FAILED;
+         }
+         BM_SharedPool *shared = (BM_SharedPool *) map;
+         mgmt->shared = shared;
+         mgmt->frames = (BM_Frame *) ((char *) map + sizeof(BM_SharedPool));
+         mgmt->frameLatches = (pthread_mutex_t *) ((char *) map + latchesOffset);
+         mgmt->frameData = (char *) map + dataOffset;
+         mgmt->sharedSize = size;
+
+         if (created) {
+              shared->numFrames = mgmt->numFrames;
+              shared->pageSize = mgmt->pageSize;
+              snprintf(shared->pageFile, sizeof(shared->pageFile), "%s", pageFileName);
+              initLatch(&shared->latch);
+              for (int i = 0; i < mgmt->numFrames; i++) {
+                   mgmt->frames[i].pageNum = NO_PAGE;
+                   initLatch(&mgmt->frameLatches[i]);
+              }
+              memcpy(shared->magic, BM_SHARED_MAGIC, sizeof(shared->magic));
+              atomic_store_explicit(&shared->ready, 1, memory_order_release);
+         } else {
+              while (!atomic_load_explicit(&shared->ready, memory_order_acquire)) {
+                   if (pastDeadline(&deadline)) {
+                        TRACE(TRACE_ERROR, TRACE_CAT_BUFFER, TE_ERR_SYSCALL, ETIMEDOUT, __LINE__);
+                        munmap(map, size);
+                        mgmt->shared = NULL;
+                        return RC_FILE_NOT_FOUND;
+                   }
+                   nanosleep(&pause, NULL);
+              }
+              if (memcmp(shared->magic, BM_SHARED_MAGIC, sizeof(shared->magic)) != 0 ||
+                  shared->numFrames != mgmt->numFrames || shared->pageSize != mgmt->pageSize ||
+                  strncmp(shared->pageFile, pageFileName, sizeof(shared->pageFile)) != 0) {
+                   TRACE(TRACE_ERROR, TRACE_CAT_BUFFER, TE_ERR_INVALID_ARGUMENT, shared->numFrames, __LINE__);
+                   munmap(map, size);
+                   mgmt->shared = NULL;
+                   return RC_INVALID_ARGUMENT;
+              }
+         }
+
+         lockLatch(&shared->latch);
+         if (shared->closed) {
+              // the last user left while we attached; start over with a new segment
+              pthread_mutex_unlock(&shared->latch);
+              munmap(map, size);
+              mgmt->shared = NULL;
+              continue;
+         }
+         shared->attached++;
+         pthread_mutex_unlock(&shared->latch);
+         return RC_OK;
+    }
+    TRACE(TRACE_ERROR, TRACE_CAT_BUFFER, TE_ERR_SYSCALL, errno, __LINE__);
+    return RC_FILE_NOT_FOUND;
+}
+
 /* 
  * initBufferPool: Creates a new buffer pool with the given number of pages and replacement strategy.
  * It allocates the frames, initializes them as empty, opens the page file using the storage manager,
@@ -39,115 +273,281 @@ typedef struct BM_MgmtData {
 RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName,
                   const int numPages, ReplacementStrategy strategy,
                   void *stratData) {
+    return initBufferPoolWithFlags(bm, pageFileName, numPages, strategy, stratData, SM_OPEN_DEFAULT);
+}
+
+/* 
+ * createPool: Shared part of the pool constructors; shmName is NULL for a private pool.
+ */
+static RC createPool(BM_BufferPool *const bm, const char *const pageFileName,
+                  const int numPages, ReplacementStrategy strategy, int openFlags,
+                  const char *const shmName) {
     if (bm == NULL || pageFileName == NULL || numPages <= 0) {
          return RC_FILE_HANDLE_NOT_INIT;
     }
-    bm->pageFile = strdup(pageFileName);
-    bm->numPages = numPages;
-    bm->strategy = strategy;
-    
-    BM_MgmtData *mgmt = (BM_MgmtData *) malloc(sizeof(BM_MgmtData));
+
+    BM_MgmtData *mgmt = (BM_MgmtData *) calloc(1, sizeof(BM_MgmtData));
     if (!mgmt) return RC_WRITE_FAILED;
-    
+
     mgmt->numFrames = numPages;
     mgmt->readIO = 0;
     mgmt->writeIO = 0;
     mgmt->time = 0;
-    
-    mgmt->frames = (BM_Frame *) malloc(sizeof(BM_Frame) * numPages);
-    if (!mgmt->frames) {
+
+    RC rc = openPageFileWithFlags((char *)pageFileName, &mgmt->fileHandle, openFlags);
+    if (rc != RC_OK) {
          free(mgmt);
-         return RC_WRITE_FAILED;
+         return rc;
     }
-    
-    for (int i = 0; i < numPages; i++) {
-         mgmt->frames[i].pageNum = NO_PAGE;
-         mgmt->frames[i].data = (char *) malloc(PAGE_SIZE);
-         if (!mgmt->frames[i].data) {
-             for (int j = 0; j < i; j++) {
-                free(mgmt->frames[j].data);
-             }
-             free(mgmt->frames);
-             free(mgmt);
-             return RC_WRITE_FAILED;
-         }
-         memset(mgmt->frames[i].data, 0, PAGE_SIZE);
-         mgmt->frames[i].fixCount = 0;
-         mgmt->frames[i].dirty = false;
-         mgmt->frames[i].loadTime = 0;
-         mgmt->frames[i].lastUsed = 0;
-    }
-    
-    RC rc = openPageFile((char *)pageFileName, &mgmt->fileHandle);
-    if (rc != RC_OK) {
+    mgmt->pageSize = mgmt->fileHandle.pageSize;
+
+    if (shmName != NULL) {
+         // compressed and striped files keep their page map or page count in each handle,
+         // which refreshPageFile cannot bring up to date across processes
+         if (getPageFileFormat(&mgmt->fileHandle) & (SM_FILE_COMPRESSED | SM_FILE_STRIPED)) {
+              TRACE(TRACE_ERROR, TRACE_CAT_BUFFER, TE_ERR_INVALID_ARGUMENT, getPageFileFormat(&mgmt->fileHandle), __LINE__);
+              closePageFile(&mgmt->fileHandle);
+              free(mgmt);
+              return RC_INVALID_ARGUMENT;
+         }
+         mgmt->sharedName = strdup(shmName);
+         rc = mgmt->sharedName ? attachSharedPool(mgmt, shmName, pageFileName) : RC_WRITE_FAILED;
+         if (rc != RC_OK) {
+              free(mgmt->sharedName);
+              closePageFile(&mgmt->fileHandle);
+              free(mgmt);
+              return rc;
+         }
+    } else {
+         void *data = NULL;
+         mgmt->frames = (BM_Frame *) malloc(sizeof(BM_Frame) * numPages);
+         if (posix_memalign(&data, SM_DIRECT_IO_ALIGNMENT, (size_t) numPages * mgmt->pageSize) != 0) {
+              data = NULL;
+         }
+         mgmt->frameData = (char *) data;
+         if (!mgmt->frames || !mgmt->frameData) {
+              free(mgmt->frames);
+              free(mgmt->frameData);
+              closePageFile(&mgmt->fileHandle);
+              free(mgmt);
+              return RC_WRITE_FAILED;
+         }
+         memset(mgmt->frameData, 0, (size_t) numPages * mgmt->pageSize);
          for (int i = 0; i < numPages; i++) {
-             free(mgmt->frames[i].data);
+              mgmt->frames[i].pageNum = NO_PAGE;
+              mgmt->frames[i].fixCount = 0;
+              mgmt->frames[i].dirty = false;
+              mgmt->frames[i].loadTime = 0;
+              mgmt->frames[i].lastUsed = 0;
          }
-         free(mgmt->frames);
-         free(mgmt);
-         return rc;
     }
-    
+
+    bm->pageFile = strdup(pageFileName);
+    bm->numPages = numPages;
+    bm->strategy = strategy;
+    bm->pageSize = mgmt->pageSize;
     bm->mgmtData = mgmt;
     return RC_OK;
 }
 
+/* 
+ * initBufferPoolWithFlags: Same as initBufferPool, but opens the page file with the given
+ * SM_OPEN_* flags. Frames are always aligned to SM_DIRECT_IO_ALIGNMENT so that the pool
+ * can be used with SM_OPEN_DIRECT, and are as large as the pages of the file.
+ */
+RC initBufferPoolWithFlags(BM_BufferPool *const bm, const char *const pageFileName,
+                  const int numPages, ReplacementStrategy strategy,
+                  void *stratData, int openFlags) {
+    return createPool(bm, pageFileName, numPages, strategy, openFlags, NULL);
+}
+
+/* 
+ * initSharedBufferPool: Same as initBufferPool, but the frames, their descriptors and
+ * the replacement clock live in the POSIX shared-memory object shmName (e.g. "/tables").
+ * Every process that initializes a pool with the same name, page file and size shares
+ * one cache: a page read by one process is a hit for all others. Pin counts are global;
+ * each process opens the page file itself and writes back whatever frames it evicts.
+ * The segment is removed when the last process shuts its pool down. Compressed and
+ * striped page files cannot be shared and are rejected with RC_INVALID_ARGUMENT.
+ */
+RC initSharedBufferPool(BM_BufferPool *const bm, const char *const pageFileName,
+                  const int numPages, ReplacementStrategy strategy,
+                  void *stratData, const char *const shmName) {
+    if (shmName == NULL) {
+         TRACE(TRACE_ERROR, TRACE_CAT_BUFFER, TE_ERR_INVALID_ARGUMENT, 0, __LINE__);
+         return RC_INVALID_ARGUMENT;
+    }
+    return createPool(bm, pageFileName, numPages, strategy, SM_OPEN_DEFAULT, shmName);
+}
+
 /* 
  * shutdownBufferPool: Flushes any dirty pages (if needed), checks that no pages are pinned,
  * frees all allocated memory for frames and mgmtData, closes the page file, and clears mgmtData.
+ * A shared pool only checks the pins of this process and leaves the segment to the others.
  */
 RC shutdownBufferPool(BM_BufferPool *const bm) {
     if (bm == NULL || bm->mgmtData == NULL) {
          return RC_FILE_HANDLE_NOT_INIT;
     }
     BM_MgmtData *mgmt = (BM_MgmtData *) bm->mgmtData;
-    
-    for (int i = 0; i < mgmt->numFrames; i++) {
-         if (mgmt->frames[i].fixCount > 0) {
-              printf("Error: Attempting to shutdown buffer pool with pinned pages.\n");
+
+    if (mgmt->shared != NULL) {
+         if (mgmt->localPins > 0) {
+              TRACE(TRACE_ERROR, TRACE_CAT_BUFFER, TE_ERR_PAGE_PINNED, mgmt->localPins, __LINE__);
               return RC_IM_NO_MORE_ENTRIES;
          }
+    } else {
+         for (int i = 0; i < mgmt->numFrames; i++) {
+              if (mgmt->frames[i].fixCount > 0) {
+                   TRACE(TRACE_ERROR, TRACE_CAT_BUFFER, TE_ERR_PAGE_PINNED, mgmt->frames[i].pageNum, __LINE__);
+                   return RC_IM_NO_MORE_ENTRIES;
+              }
+         }
     }
-    
+
     forceFlushPool(bm);
-    
-    for (int i = 0; i < mgmt->numFrames; i++) {
-         free(mgmt->frames[i].data);
+
+    if (mgmt->shared != NULL) {
+         // closePageFile saves this handle's free-page bitmap; pick up the pages other
+         // processes appended first, so their bits are saved as allocated too
+         refreshPageFile(&mgmt->fileHandle);
+         lockPool(mgmt);
+         if (--mgmt->shared->attached == 0) {
+              mgmt->shared->closed = 1;
+              shm_unlink(mgmt->sharedName);
+         }
+         unlockPool(mgmt);
+         munmap(mgmt->shared, mgmt->sharedSize);
+         free(mgmt->sharedName);
+    } else {
+         free(mgmt->frameData);
+         free(mgmt->frames);
     }
-    free(mgmt->frames);
-    
+
     RC rc = closePageFile(&mgmt->fileHandle);
     if (rc != RC_OK) {
          free(mgmt);
          bm->mgmtData = NULL;
          return rc;
     }
-    
+
     free(mgmt);
     free(bm->pageFile);
     bm->mgmtData = NULL;
     return RC_OK;
 }
 
+/* 
+ * compareFramePages: qsort comparator ordering frame pointers by the page they hold.
+ */
+static int compareFramePages(const void *a, const void *b) {
+    PageNumber left = (*(BM_Frame *const *) a)->pageNum;
+    PageNumber right = (*(BM_Frame *const *) b)->pageNum;
+    return (left > right) - (left < right);
+}
+
 /* 
  * forceFlushPool: Writes back all dirty pages (that have fixCount 0) to disk.
- * It iterates through all frames and, if a frame is dirty, writes its content back using writeBlock.
+ * Dirty frames are sorted by page number so that runs of consecutive pages go out
+ * in a single writeBlocks call instead of one writeBlock per page.
  */
 RC forceFlushPool(BM_BufferPool *const bm) {
     if (bm == NULL || bm->mgmtData == NULL) {
          return RC_FILE_HANDLE_NOT_INIT;
     }
     BM_MgmtData *mgmt = (BM_MgmtData *) bm->mgmtData;
-    
+
+    BM_Frame **dirtyFrames = (BM_Frame **) malloc(sizeof(BM_Frame *) * mgmt->numFrames);
+    SM_PageHandle *buffers = (SM_PageHandle *) malloc(sizeof(SM_PageHandle) * mgmt->numFrames);
+    if (!dirtyFrames || !buffers) {
+         free(dirtyFrames);
+         free(buffers);
+         return RC_WRITE_FAILED;
+    }
+
+    lockPool(mgmt);
+    int numDirty = 0;
     for (int i = 0; i < mgmt->numFrames; i++) {
          if (mgmt->frames[i].dirty && mgmt->frames[i].fixCount == 0) {
-              RC rc = writeBlock(mgmt->frames[i].pageNum, &mgmt->fileHandle, mgmt->frames[i].data);
-              if (rc != RC_OK) return rc;
-              mgmt->frames[i].dirty = false;
-              mgmt->writeIO++;
+              dirtyFrames[numDirty++] = &mgmt->frames[i];
          }
     }
-    return RC_OK;
+    qsort(dirtyFrames, numDirty, sizeof(BM_Frame *), compareFramePages);
+
+    RC rc = RC_OK;
+    int runStart = 0;
+    while (runStart < numDirty && rc == RC_OK) {
+         int runLength = 1;
+         buffers[0] = frameData(mgmt, dirtyFrames[runStart] - mgmt->frames);
+         while (runStart + runLength < numDirty &&
+                dirtyFrames[runStart + runLength]->pageNum ==
+                dirtyFrames[runStart]->pageNum + runLength) {
+              buffers[runLength] = frameData(mgmt, dirtyFrames[runStart + runLength] - mgmt->frames);
+              runLength++;
+         }
+         rc = writeBlocks(dirtyFrames[runStart]->pageNum, runLength,
+                          &mgmt->fileHandle, buffers);
+         if (rc == RC_OK) {
+              for (int i = runStart; i < runStart + runLength; i++) {
+                   dirtyFrames[i]->dirty = false;
+                   mgmt->writeIO++;
+              }
+         }
+         runStart += runLength;
+    }
+    unlockPool(mgmt);
+
+    free(dirtyFrames);
+    free(buffers);
+    if (rc == RC_OK) {
+         rc = syncPageFile(&mgmt->fileHandle);
+    }
+    return rc;
+}
+
+/* 
+ * checkpointBufferPool: Writes the dirty unpinned pages and the page file's metadata, so
+ * other handles opened on the file afterwards see what the pool holds.
+ */
+RC checkpointBufferPool(BM_BufferPool *const bm) {
+    if (bm == NULL || bm->mgmtData == NULL) {
+         return RC_FILE_HANDLE_NOT_INIT;
+    }
+    BM_MgmtData *mgmt = (BM_MgmtData *) bm->mgmtData;
+    RC rc = forceFlushPool(bm);
+    if (rc == RC_OK) {
+         rc = savePageFileMetadata(&mgmt->fileHandle);
+    }
+    return rc;
+}
+
+/* 
+ * backupBufferPool: Copies the pool's page file to backupFileName while the pool stays in use.
+ * The pool is checkpointed first; pages it writes during the copy are copied again by
+ * backupPageFile, pages still dirty in the pool are not.
+ */
+RC backupBufferPool(BM_BufferPool *const bm, const char *const backupFileName) {
+    if (bm == NULL || bm->mgmtData == NULL || backupFileName == NULL) {
+         return RC_FILE_HANDLE_NOT_INIT;
+    }
+    BM_MgmtData *mgmt = (BM_MgmtData *) bm->mgmtData;
+    RC rc = checkpointBufferPool(bm);
+    if (rc == RC_OK) {
+         rc = backupPageFile(mgmt->fileHandle.fileName, (char *) backupFileName);
+    }
+    return rc;
+}
+
+/* 
+ * setPoolDurability: Selects the SM_DURABILITY_* mode of the pool's page file. In any mode
+ * but SM_DURABILITY_NONE, forceFlushPool returns only once the flushed pages are durable.
+ */
+RC setPoolDurability(BM_BufferPool *const bm, int durabilityMode, int maxWaitMicros) {
+    if (bm == NULL || bm->mgmtData == NULL) {
+         return RC_FILE_HANDLE_NOT_INIT;
+    }
+    BM_MgmtData *mgmt = (BM_MgmtData *) bm->mgmtData;
+    return setDurabilityMode(&mgmt->fileHandle, (SM_DurabilityMode) durabilityMode, maxWaitMicros);
 }
 
 /* 
@@ -158,13 +558,16 @@ RC markDirty (BM_BufferPool *const bm, BM_PageHandle *const page) {
          return RC_FILE_HANDLE_NOT_INIT;
     }
     BM_MgmtData *mgmt = (BM_MgmtData *) bm->mgmtData;
+    lockPool(mgmt);
     for (int i = 0; i < mgmt->numFrames; i++) {
          if (mgmt->frames[i].pageNum == page->pageNum) {
               mgmt->frames[i].dirty = true;
+              unlockPool(mgmt);
               return RC_OK;
          }
     }
-    printf("Error: markDirty: Page not found in buffer pool.\n");
+    unlockPool(mgmt);
+    TRACE(TRACE_ERROR, TRACE_CAT_BUFFER, TE_ERR_PAGE_NOT_RESIDENT, page->pageNum, __LINE__);
     return RC_IM_KEY_NOT_FOUND;
 }
 
@@ -177,17 +580,22 @@ RC unpinPage (BM_BufferPool *const bm, BM_PageHandle *const page) {
          return RC_FILE_HANDLE_NOT_INIT;
     }
     BM_MgmtData *mgmt = (BM_MgmtData *) bm->mgmtData;
+    lockPool(mgmt);
     for (int i = 0; i < mgmt->numFrames; i++) {
          if (mgmt->frames[i].pageNum == page->pageNum) {
               if (mgmt->frames[i].fixCount <= 0) {
-                   printf("Error: unpinPage: Page fix count is already 0.\n");
+                   unlockPool(mgmt);
+                   TRACE(TRACE_ERROR, TRACE_CAT_BUFFER, TE_ERR_PAGE_NOT_PINNED, page->pageNum, __LINE__);
                    return RC_IM_NO_MORE_ENTRIES;
               }
               mgmt->frames[i].fixCount--;
+              mgmt->localPins--;
+              unlockPool(mgmt);
               return RC_OK;
          }
     }
-    printf("Error: unpinPage: Page not found in buffer pool.\n");
+    unlockPool(mgmt);
+    TRACE(TRACE_ERROR, TRACE_CAT_BUFFER, TE_ERR_PAGE_NOT_RESIDENT, page->pageNum, __LINE__);
     return RC_IM_KEY_NOT_FOUND;
 }
 
@@ -199,16 +607,20 @@ RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page) {
          return RC_FILE_HANDLE_NOT_INIT;
     }
     BM_MgmtData *mgmt = (BM_MgmtData *) bm->mgmtData;
+    lockPool(mgmt);
     for (int i = 0; i < mgmt->numFrames; i++) {
          if (mgmt->frames[i].pageNum == page->pageNum) {
-              RC rc = writeBlock(mgmt->frames[i].pageNum, &mgmt->fileHandle, mgmt->frames[i].data);
-              if (rc != RC_OK) return rc;
-              mgmt->frames[i].dirty = false;
-              mgmt->writeIO++;
-              return RC_OK;
+              RC rc = writeBlock(mgmt->frames[i].pageNum, &mgmt->fileHandle, frameData(mgmt, i));
+              if (rc == RC_OK) {
+                   mgmt->frames[i].dirty = false;
+                   mgmt->writeIO++;
+              }
+              unlockPool(mgmt);
+              return rc;
          }
     }
-    printf("Error: forcePage: Page not found in buffer pool.\n");
+    unlockPool(mgmt);
+    TRACE(TRACE_ERROR, TRACE_CAT_BUFFER, TE_ERR_PAGE_NOT_RESIDENT, page->pageNum, __LINE__);
     return RC_IM_KEY_NOT_FOUND;
 }
 
@@ -216,40 +628,65 @@ RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page) {
  * pinPage: Brings the requested page into the buffer pool (if not already present) and pins it.
  * If the page is not in memory, an available (or victim) frame is chosen using the replacement strategy.
  * If the victim is dirty, it is written back to disk before the new page is read.
+ * In a shared pool the page is read with only the frame's latch held, and a process that
+ * pins a page another process is still reading waits on that latch.
  */
 RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, const PageNumber pageNum) {
     if (bm == NULL || bm->mgmtData == NULL || page == NULL) {
          return RC_FILE_HANDLE_NOT_INIT;
     }
     if (pageNum < 0) {
-         printf("Error: pinPage: Negative page number.\n");
+         TRACE(TRACE_ERROR, TRACE_CAT_BUFFER, TE_ERR_INVALID_ARGUMENT, pageNum, __LINE__);
          return RC_READ_NON_EXISTING_PAGE;
     }
-    
+
     BM_MgmtData *mgmt = (BM_MgmtData *) bm->mgmtData;
-    mgmt->time++; // update global time
+    lockPool(mgmt);
+    int now = tick(mgmt); // update global time
 
-    // Ensure the file has enough pages for the requested page.
+    // Ensure the file has enough pages for the requested page; other processes
+    // sharing the pool may have grown it already.
     if (pageNum >= mgmt->fileHandle.totalNumPages) {
-         RC rc = ensureCapacity(pageNum + 1, &mgmt->fileHandle);
-         if (rc != RC_OK) return rc;
+         RC rc = (mgmt->shared != NULL) ? refreshPageFile(&mgmt->fileHandle) : RC_OK;
+         if (rc == RC_OK && pageNum >= mgmt->fileHandle.totalNumPages) {
+              rc = ensureCapacity(pageNum + 1, &mgmt->fileHandle);
+         }
+         if (rc != RC_OK) {
+              unlockPool(mgmt);
+              return rc;
+         }
     }
-    
+
     // Check if the requested page is already in the pool.
     for (int i = 0; i < mgmt->numFrames; i++) {
          if (mgmt->frames[i].pageNum == pageNum) {
               mgmt->frames[i].fixCount++;
-              mgmt->frames[i].lastUsed = mgmt->time;
+              mgmt->frames[i].lastUsed = now;
+              unlockPool(mgmt);
+              if (mgmt->shared != NULL) {
+                   // wait until the process loading the page is done
+                   lockLatch(&mgmt->frameLatches[i]);
+                   pthread_mutex_unlock(&mgmt->frameLatches[i]);
+                   lockPool(mgmt);
+                   if (mgmt->frames[i].pageNum != pageNum) {
+                        // the load failed
+                        mgmt->frames[i].fixCount--;
+                        unlockPool(mgmt);
+                        return RC_READ_NON_EXISTING_PAGE;
+                   }
+                   unlockPool(mgmt);
+              }
+              mgmt->localPins++;
               page->pageNum = pageNum;
-              page->data = mgmt->frames[i].data;
+              page->data = frameData(mgmt, i);
               return RC_OK;
          }
     }
-    
+
     // Look for an empty frame.
     int victim = -1;
     for (int i = 0; i < mgmt->numFrames; i++) {
-         if (mgmt->frames[i].pageNum == NO_PAGE) {
+         if (mgmt->frames[i].pageNum == NO_PAGE && mgmt->frames[i].fixCount == 0) {
               victim = i;
               break;
          }
@@ -280,40 +717,112 @@ RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, const PageNumber
          }
     }
     if (victim == -1) {
-         printf("Error: pinPage: No available frame to evict (all pages are pinned).\n");
+         unlockPool(mgmt);
+         TRACE(TRACE_ERROR, TRACE_CAT_BUFFER, TE_ERR_NO_FREE_FRAME, pageNum, __LINE__);
          return RC_IM_NO_MORE_ENTRIES;
     }
-    
-    /* Evict victim frame if it is not empty */
+
+    /* Evict victim frame if it is not empty; written back under the pool latch so that
+     * no process rereads the page before it is on disk */
     if (mgmt->frames[victim].pageNum != NO_PAGE) {
+         TRACE(TRACE_DEBUG, TRACE_CAT_BUFFER, TE_BM_EVICT, mgmt->frames[victim].pageNum, victim);
          if (mgmt->frames[victim].fixCount != 0) {
-              printf("Error: pinPage: Selected victim frame is pinned.\n");
+              unlockPool(mgmt);
+              TRACE(TRACE_ERROR, TRACE_CAT_BUFFER, TE_ERR_PAGE_PINNED, mgmt->frames[victim].pageNum, __LINE__);
               return RC_IM_NO_MORE_ENTRIES;
          }
          if (mgmt->frames[victim].dirty) {
-              RC rc = writeBlock(mgmt->frames[victim].pageNum, &mgmt->fileHandle, mgmt->frames[victim].data);
-              if (rc != RC_OK) return rc;
+              RC rc = writeBlock(mgmt->frames[victim].pageNum, &mgmt->fileHandle, frameData(mgmt, victim));
+              if (rc != RC_OK) {
+                   unlockPool(mgmt);
+                   return rc;
+              }
               mgmt->frames[victim].dirty = false;
               mgmt->writeIO++;
          }
     }
-    
-    /* Read the requested page from disk into the victim frame */
-    RC rc = readBlock(pageNum, &mgmt->fileHandle, mgmt->frames[victim].data);
-    if (rc != RC_OK) return rc;
-    mgmt->readIO++;
-    
+
+    /* Claim the frame for the requested page; it is pinned, so no one evicts it while
+     * it is read */
     mgmt->frames[victim].pageNum = pageNum;
     mgmt->frames[victim].fixCount = 1; // page is now pinned
     mgmt->frames[victim].dirty = false;
-    mgmt->frames[victim].loadTime = mgmt->time;
-    mgmt->frames[victim].lastUsed = mgmt->time;
-    
+    mgmt->frames[victim].loadTime = now;
+    mgmt->frames[victim].lastUsed = now;
+    if (mgmt->shared != NULL) {
+         lockLatch(&mgmt->frameLatches[victim]);
+    }
+    unlockPool(mgmt);
+
+    /* Read the requested page from disk into the victim frame */
+    RC rc = readBlock(pageNum, &mgmt->fileHandle, frameData(mgmt, victim));
+    if (rc != RC_OK) {
+         lockPool(mgmt);
+         mgmt->frames[victim].pageNum = NO_PAGE;
+         mgmt->frames[victim].fixCount--;
+         unlockPool(mgmt);
+    }
+    if (mgmt->shared != NULL) {
+         pthread_mutex_unlock(&mgmt->frameLatches[victim]);
+    }
+    if (rc != RC_OK) return rc;
+    mgmt->readIO++;
+    mgmt->localPins++;
+    TRACE(TRACE_DEBUG, TRACE_CAT_BUFFER, TE_BM_PIN, pageNum, victim);
+
     page->pageNum = pageNum;
-    page->data = mgmt->frames[victim].data;
+    page->data = frameData(mgmt, victim);
     return RC_OK;
 }
 
+/* 
+ * writePagesDirect: Writes count consecutive pages straight to the page file with one
+ * writeBlocks call, growing the file as needed, without taking frames for them. Unpinned
+ * frames holding any of the pages are refreshed with the new contents; pinned ones make
+ * the call fail before anything is written. Meant for bulk loads of new pages.
+ */
+RC writePagesDirect (BM_BufferPool *const bm, const PageNumber firstPage, const int count,
+                  char **pages) {
+    if (bm == NULL || bm->mgmtData == NULL || pages == NULL) {
+         return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (firstPage < 0 || count <= 0) {
+         TRACE(TRACE_ERROR, TRACE_CAT_BUFFER, TE_ERR_INVALID_ARGUMENT, firstPage, __LINE__);
+         return RC_INVALID_ARGUMENT;
+    }
+    BM_MgmtData *mgmt = (BM_MgmtData *) bm->mgmtData;
+    lockPool(mgmt);
+    for (int i = 0; i < mgmt->numFrames; i++) {
+         PageNumber pageNum = mgmt->frames[i].pageNum;
+         if (pageNum != NO_PAGE && pageNum >= firstPage && pageNum < firstPage + count &&
+             mgmt->frames[i].fixCount > 0) {
+              unlockPool(mgmt);
+              TRACE(TRACE_ERROR, TRACE_CAT_BUFFER, TE_ERR_PAGE_PINNED, pageNum, __LINE__);
+              return RC_IM_NO_MORE_ENTRIES;
+         }
+    }
+
+    RC rc = RC_OK;
+    if (firstPage + count > mgmt->fileHandle.totalNumPages) {
+         rc = ensureCapacity(firstPage + count, &mgmt->fileHandle);
+    }
+    if (rc == RC_OK) {
+         rc = writeBlocks(firstPage, count, &mgmt->fileHandle, pages);
+    }
+    if (rc == RC_OK) {
+         mgmt->writeIO += count;
+         for (int i = 0; i < mgmt->numFrames; i++) {
+              PageNumber pageNum = mgmt->frames[i].pageNum;
+              if (pageNum != NO_PAGE && pageNum >= firstPage && pageNum < firstPage + count) {
+                   memcpy(frameData(mgmt, i), pages[pageNum - firstPage], mgmt->pageSize);
+                   mgmt->frames[i].dirty = false;
+              }
+         }
+    }
+    unlockPool(mgmt);
+    return rc;
+}
+
 /* 
  * getFrameContents: Returns an array (of size numPages) with the page numbers stored in each frame.
  * An empty frame is represented by NO_PAGE.
@@ -322,9 +831,11 @@ PageNumber *getFrameContents (BM_BufferPool *const bm) {
     if (bm == NULL || bm->mgmtData == NULL) return NULL;
     BM_MgmtData *mgmt = (BM_MgmtData *) bm->mgmtData;
     PageNumber *contents = (PageNumber *) malloc(sizeof(PageNumber) * mgmt->numFrames);
+    lockPool(mgmt);
     for (int i = 0; i < mgmt->numFrames; i++) {
          contents[i] = mgmt->frames[i].pageNum;
     }
+    unlockPool(mgmt);
     return contents;
 }
 
@@ -335,9 +846,11 @@ bool *getDirtyFlags (BM_BufferPool *const bm) {
     if (bm == NULL || bm->mgmtData == NULL) return NULL;
     BM_MgmtData *mgmt = (BM_MgmtData *) bm->mgmtData;
     bool *flags = (bool *) malloc(sizeof(bool) * mgmt->numFrames);
+    lockPool(mgmt);
     for (int i = 0; i < mgmt->numFrames; i++) {
          flags[i] = mgmt->frames[i].dirty;
     }
+    unlockPool(mgmt);
     return flags;
 }
 
@@ -348,9 +861,11 @@ int *getFixCounts (BM_BufferPool *const bm) {
     if (bm == NULL || bm->mgmtData == NULL) return NULL;
     BM_MgmtData *mgmt = (BM_MgmtData *) bm->mgmtData;
     int *fixCounts = (int *) malloc(sizeof(int) * mgmt->numFrames);
+    lockPool(mgmt);
     for (int i = 0; i < mgmt->numFrames; i++) {
          fixCounts[i] = mgmt->frames[i].fixCount;
     }
+    unlockPool(mgmt);
     return fixCounts;
 }
 
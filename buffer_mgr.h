@@ -17,12 +17,12 @@ typedef enum ReplacementStrategy {
 } ReplacementStrategy;
 
 // Data Types and Structures
-typedef int PageNumber;
 #define NO_PAGE -1
 
 typedef struct BM_BufferPool {
 	char *pageFile;
 	int numPages;
+	int pageSize; // bytes per page of the page file, set by initBufferPool
 	ReplacementStrategy strategy;
 	void *mgmtData; // use this one to store the bookkeeping info your buffer
 	// manager needs for a buffer pool
@@ -44,8 +44,19 @@ typedef struct BM_PageHandle {
 RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName, 
 		const int numPages, ReplacementStrategy strategy,
 		void *stratData);
+RC initBufferPoolWithFlags(BM_BufferPool *const bm, const char *const pageFileName,
+		const int numPages, ReplacementStrategy strategy,
+		void *stratData, int openFlags);
+/* pool whose frames live in the shared-memory object shmName and are shared by
+ * every process that attaches to it with the same page file and size */
+RC initSharedBufferPool(BM_BufferPool *const bm, const char *const pageFileName,
+		const int numPages, ReplacementStrategy strategy,
+		void *stratData, const char *const shmName);
 RC shutdownBufferPool(BM_BufferPool *const bm);
 RC forceFlushPool(BM_BufferPool *const bm);
+RC setPoolDurability(BM_BufferPool *const bm, int durabilityMode, int maxWaitMicros);
+RC checkpointBufferPool(BM_BufferPool *const bm);
+RC backupBufferPool(BM_BufferPool *const bm, const char *const backupFileName);
 
 // Buffer Manager Interface Access Pages
 RC markDirty (BM_BufferPool *const bm, BM_PageHandle *const page);
@@ -53,6 +64,10 @@ RC unpinPage (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, 
 		const PageNumber pageNum);
+/* writes count consecutive pages straight to the file, bypassing the frames;
+ * for bulk loads */
+RC writePagesDirect (BM_BufferPool *const bm, const PageNumber firstPage, const int count,
+		char **pages);
 
 // Statistics Interface
 PageNumber *getFrameContents (BM_BufferPool *const bm);
@@ -25,7 +25,7 @@ printPoolContent (BM_BufferPool *const bm)
 	printf(" %i}: ", bm->numPages);
 
 	for (i = 0; i < bm->numPages; i++)
-		printf("%s[%i%s%i]", ((i == 0) ? "" : ",") , frameContent[i], (dirty[i] ? "x": " "), fixCount[i]);
+		printf("%s[%lld%s%i]", ((i == 0) ? "" : ",") , (long long) frameContent[i], (dirty[i] ? "x": " "), fixCount[i]);
 	printf("\n");
 }
 
@@ -39,43 +39,61 @@ sprintPoolContent (BM_BufferPool *const bm)
 	char *message;
 	int pos = 0;
 
-	message = (char *) malloc(256 + (22 * bm->numPages));
+	message = (char *) malloc(256 + (40 * bm->numPages));
 	frameContent = getFrameContents(bm);
 	dirty = getDirtyFlags(bm);
 	fixCount = getFixCounts(bm);
 
 	for (i = 0; i < bm->numPages; i++)
-		pos += sprintf(message + pos, "%s[%i%s%i]", ((i == 0) ? "" : ",") , frameContent[i], (dirty[i] ? "x": " "), fixCount[i]);
+		pos += sprintf(message + pos, "%s[%lld%s%i]", ((i == 0) ? "" : ",") , (long long) frameContent[i], (dirty[i] ? "x": " "), fixCount[i]);
 
 	return message;
 }
 
 
-void
-printPageContent (BM_PageHandle *const page)
+static char *
+sprintPageBytes (BM_PageHandle *const page, int pageSize)
 {
 	int i;
+	char *message;
+	int pos = 0;
+
+	// two hex digits per byte, a space after every 8 and a newline after every 64
+	message = (char *) malloc(30 + (2 * pageSize) + (pageSize / 8) + (pageSize / 64) + 1);
+	pos += sprintf(message + pos, "[Page %lld]\n", (long long) page->pageNum);
 
-	printf("[Page %i]\n", page->pageNum);
+	for (i = 1; i <= pageSize; i++)
+		pos += sprintf(message + pos, "%02X%s%s", (unsigned char) page->data[i - 1], (i % 8) ? "" : " ", (i % 64) ? "" : "\n");
 
-	for (i = 1; i <= PAGE_SIZE; i++)
-		printf("%02X%s%s", page->data[i], (i % 8) ? "" : " ", (i % 64) ? "" : "\n");
+	return message;
+}
+
+void
+printPageContent (BM_PageHandle *const page)
+{
+	char *message = sprintPageBytes(page, PAGE_SIZE);
+	printf("%s", message);
+	free(message);
 }
 
 char *
 sprintPageContent (BM_PageHandle *const page)
 {
-	int i;
-	char *message;
-	int pos = 0;
-
-	message = (char *) malloc(30 + (2 * PAGE_SIZE) + (PAGE_SIZE % 64) + (PAGE_SIZE % 8));
-	pos += sprintf(message + pos, "[Page %i]\n", page->pageNum);
+	return sprintPageBytes(page, PAGE_SIZE);
+}
 
-	for (i = 1; i <= PAGE_SIZE; i++)
-		pos += sprintf(message + pos, "%02X%s%s", page->data[i], (i % 8) ? "" : " ", (i % 64) ? "" : "\n");
+void
+printPoolPageContent (BM_BufferPool *const bm, BM_PageHandle *const page)
+{
+	char *message = sprintPageBytes(page, bm->pageSize);
+	printf("%s", message);
+	free(message);
+}
 
-	return message;
+char *
+sprintPoolPageContent (BM_BufferPool *const bm, BM_PageHandle *const page)
+{
+	return sprintPageBytes(page, bm->pageSize);
 }
 
 void
@@ -9,4 +9,9 @@ void printPageContent (BM_PageHandle *const page);
 char *sprintPoolContent (BM_BufferPool *const bm);
 char *sprintPageContent (BM_PageHandle *const page);
 
+// printPageContent and sprintPageContent show the first PAGE_SIZE bytes of a
+// page; these show the whole page of a pool whose file has larger pages
+void printPoolPageContent (BM_BufferPool *const bm, BM_PageHandle *const page);
+char *sprintPoolPageContent (BM_BufferPool *const bm, BM_PageHandle *const page);
+
 #endif
@@ -0,0 +1,285 @@
+#include "checksum.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+#define CRC32C_POLY 0x82F63B78u	/* reflected Castagnoli polynomial */
+
+// bytes per stream when the hardware paths run three CRCs side by side
+#define CRC_STRIPE 256
+
+// slice-by-8 lookup tables, built once
+static uint32_t crcTable[8][256];
+
+// shifts a CRC over CRC_STRIPE zero bytes, so interleaved streams can be combined
+static uint32_t crcStripeShift[4][256];
+static pthread_once_t crcInitOnce = PTHREAD_ONCE_INIT;
+
+typedef uint32_t (*crcFunction) (uint32_t crc, const unsigned char *p, size_t len);
+static crcFunction crcImpl;
+static const char *crcImplName;
+
+// ************************************************************
+// software implementation
+
+static uint32_t
+crcUpdateSoftware (uint32_t crc, const unsigned char *p, size_t len)
+{
+	// align to 8 bytes, then consume 8 bytes per step
+	while (len > 0 && ((uintptr_t) p & 7) != 0)
+	{
+		crc = crcTable[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+		len--;
+	}
+	while (len >= 8)
+	{
+		uint64_t word;
+		memcpy(&word, p, 8);
+		word ^= crc;
+		crc = crcTable[7][word & 0xff] ^
+			crcTable[6][(word >> 8) & 0xff] ^
+			crcTable[5][(word >> 16) & 0xff] ^
+			crcTable[4][(word >> 24) & 0xff] ^
+			crcTable[3][(word >> 32) & 0xff] ^
+			crcTable[2][(word >> 40) & 0xff] ^
+			crcTable[1][(word >> 48) & 0xff] ^
+			crcTable[0][word >> 56];
+		p += 8;
+		len -= 8;
+	}
+	while (len > 0)
+	{
+		crc = crcTable[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+		len--;
+	}
+	return crc;
+}
+
+// ************************************************************
+// combining interleaved streams
+
+// multiplies a GF(2) 32x32 matrix with a vector
+static uint32_t
+gf2MatrixTimes (const uint32_t *mat, uint32_t vec)
+{
+	uint32_t sum = 0;
+
+	while (vec)
+	{
+		if (vec & 1)
+			sum ^= *mat;
+		vec >>= 1;
+		mat++;
+	}
+	return sum;
+}
+
+static void
+gf2MatrixSquare (uint32_t *square, const uint32_t *mat)
+{
+	for (int n = 0; n < 32; n++)
+		square[n] = gf2MatrixTimes(mat, mat[n]);
+}
+
+// builds the table that appends len (a power of two) zero bytes to a CRC
+static void
+crcZerosTable (uint32_t table[4][256], size_t len)
+{
+	uint32_t even[32], odd[32];
+	uint32_t *op = even;
+
+	// operator for one zero bit, then square up to one zero byte and beyond
+	odd[0] = CRC32C_POLY;
+	for (int n = 1; n < 32; n++)
+		odd[n] = 1u << (n - 1);
+	gf2MatrixSquare(even, odd);
+	gf2MatrixSquare(odd, even);
+	for (;;)
+	{
+		gf2MatrixSquare(even, odd);
+		op = even;
+		len >>= 1;
+		if (len == 0)
+			break;
+		gf2MatrixSquare(odd, even);
+		op = odd;
+		len >>= 1;
+		if (len == 0)
+			break;
+	}
+
+	for (uint32_t n = 0; n < 256; n++)
+	{
+		table[0][n] = gf2MatrixTimes(op, n);
+		table[1][n] = gf2MatrixTimes(op, n << 8);
+		table[2][n] = gf2MatrixTimes(op, n << 16);
+		table[3][n] = gf2MatrixTimes(op, n << 24);
+	}
+}
+
+static uint32_t
+crcShift (uint32_t crc)
+{
+	return crcStripeShift[0][crc & 0xff] ^ crcStripeShift[1][(crc >> 8) & 0xff] ^
+		crcStripeShift[2][(crc >> 16) & 0xff] ^ crcStripeShift[3][crc >> 24];
+}
+
+// ************************************************************
+// hardware implementations
+//
+// The CRC instructions have a latency of three cycles but a throughput of one,
+// so 3 * CRC_STRIPE bytes are processed as three independent streams whose
+// results are merged with crcShift.
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t
+crcUpdateSse42 (uint32_t crc, const unsigned char *p, size_t len)
+{
+	uint64_t crc64 = crc;
+
+	while (len > 0 && ((uintptr_t) p & 7) != 0)
+	{
+		crc64 = __builtin_ia32_crc32qi((uint32_t) crc64, *p++);
+		len--;
+	}
+	while (len >= 3 * CRC_STRIPE)
+	{
+		uint64_t crc1 = 0, crc2 = 0;
+		for (const unsigned char *end = p + CRC_STRIPE; p < end; p += 8)
+		{
+			uint64_t w0, w1, w2;
+			memcpy(&w0, p, 8);
+			memcpy(&w1, p + CRC_STRIPE, 8);
+			memcpy(&w2, p + 2 * CRC_STRIPE, 8);
+			crc64 = __builtin_ia32_crc32di(crc64, w0);
+			crc1 = __builtin_ia32_crc32di(crc1, w1);
+			crc2 = __builtin_ia32_crc32di(crc2, w2);
+		}
+		crc64 = crcShift((uint32_t) crc64) ^ crc1;
+		crc64 = crcShift((uint32_t) crc64) ^ crc2;
+		p += 2 * CRC_STRIPE;
+		len -= 3 * CRC_STRIPE;
+	}
+	while (len >= 8)
+	{
+		uint64_t word;
+		memcpy(&word, p, 8);
+		crc64 = __builtin_ia32_crc32di(crc64, word);
+		p += 8;
+		len -= 8;
+	}
+	while (len > 0)
+	{
+		crc64 = __builtin_ia32_crc32qi((uint32_t) crc64, *p++);
+		len--;
+	}
+	return (uint32_t) crc64;
+}
+#endif
+
+#if defined(__aarch64__) && defined(__linux__)
+__attribute__((target("arch=armv8-a+crc")))
+static uint32_t
+crcUpdateArmv8 (uint32_t crc, const unsigned char *p, size_t len)
+{
+	while (len > 0 && ((uintptr_t) p & 7) != 0)
+	{
+		crc = __builtin_aarch64_crc32cb(crc, *p++);
+		len--;
+	}
+	while (len >= 3 * CRC_STRIPE)
+	{
+		uint32_t crc1 = 0, crc2 = 0;
+		for (const unsigned char *end = p + CRC_STRIPE; p < end; p += 8)
+		{
+			uint64_t w0, w1, w2;
+			memcpy(&w0, p, 8);
+			memcpy(&w1, p + CRC_STRIPE, 8);
+			memcpy(&w2, p + 2 * CRC_STRIPE, 8);
+			crc = __builtin_aarch64_crc32cx(crc, w0);
+			crc1 = __builtin_aarch64_crc32cx(crc1, w1);
+			crc2 = __builtin_aarch64_crc32cx(crc2, w2);
+		}
+		crc = crcShift(crc) ^ crc1;
+		crc = crcShift(crc) ^ crc2;
+		p += 2 * CRC_STRIPE;
+		len -= 3 * CRC_STRIPE;
+	}
+	while (len >= 8)
+	{
+		uint64_t word;
+		memcpy(&word, p, 8);
+		crc = __builtin_aarch64_crc32cx(crc, word);
+		p += 8;
+		len -= 8;
+	}
+	while (len > 0)
+	{
+		crc = __builtin_aarch64_crc32cb(crc, *p++);
+		len--;
+	}
+	return crc;
+}
+#endif
+
+// ************************************************************
+// dispatch
+
+static void
+crcInit (void)
+{
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		uint32_t crc = i;
+		for (int bit = 0; bit < 8; bit++)
+			crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+		crcTable[0][i] = crc;
+	}
+	for (uint32_t i = 0; i < 256; i++)
+		for (int slice = 1; slice < 8; slice++)
+			crcTable[slice][i] = crcTable[0][crcTable[slice - 1][i] & 0xff] ^ (crcTable[slice - 1][i] >> 8);
+	crcZerosTable(crcStripeShift, CRC_STRIPE);
+
+	crcImpl = crcUpdateSoftware;
+	crcImplName = "software";
+#if defined(__x86_64__)
+	if (__builtin_cpu_supports("sse4.2"))
+	{
+		crcImpl = crcUpdateSse42;
+		crcImplName = "sse4.2";
+	}
+#elif defined(__aarch64__) && defined(__linux__)
+	if (getauxval(AT_HWCAP) & HWCAP_CRC32)
+	{
+		crcImpl = crcUpdateArmv8;
+		crcImplName = "armv8";
+	}
+#endif
+}
+
+uint32_t
+crc32c (const void *data, size_t len)
+{
+	pthread_once(&crcInitOnce, crcInit);
+	return ~crcImpl(0xFFFFFFFFu, (const unsigned char *) data, len);
+}
+
+uint32_t
+crc32cSoftware (const void *data, size_t len)
+{
+	pthread_once(&crcInitOnce, crcInit);
+	return ~crcUpdateSoftware(0xFFFFFFFFu, (const unsigned char *) data, len);
+}
+
+const char *
+crc32cImplementation (void)
+{
+	pthread_once(&crcInitOnce, crcInit);
+	return crcImplName;
+}
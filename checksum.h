@@ -0,0 +1,20 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/************************************************************
+ *                    CRC32C (Castagnoli)                   *
+ ************************************************************/
+/* checksum of len bytes; uses the SSE4.2 or ARMv8 CRC32 instructions when
+ * the CPU has them and a table-driven implementation otherwise */
+extern uint32_t crc32c (const void *data, size_t len);
+
+/* the portable implementation, always available for comparison */
+extern uint32_t crc32cSoftware (const void *data, size_t len);
+
+/* name of the implementation crc32c dispatches to ("sse4.2", "armv8", "software") */
+extern const char *crc32cImplementation (void);
+
+#endif
@@ -0,0 +1,176 @@
+#include "compress.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define MIN_MATCH 4
+#define HASH_BITS 12
+#define MAX_OFFSET 65535
+#define LAST_LITERALS 5		/* the final bytes are always emitted as literals */
+
+static uint32_t
+read32 (const char *p)
+{
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+static int
+hashSequence (uint32_t sequence)
+{
+	return (int) ((sequence * 2654435761u) >> (32 - HASH_BITS));
+}
+
+// writes a length continuation (bytes of 255 then the remainder); returns the new output position
+static char *
+writeLength (char *op, const char *oend, int len)
+{
+	while (len >= 255)
+	{
+		if (op >= oend)
+			return NULL;
+		*op++ = (char) 255;
+		len -= 255;
+	}
+	if (op >= oend)
+		return NULL;
+	*op++ = (char) len;
+	return op;
+}
+
+// emits one sequence: literals followed by an optional match
+static char *
+writeSequence (char *op, const char *oend, const char *literals, int litLen, int offset, int matchLen)
+{
+	char *token = op++;
+	int matchCode = matchLen ? matchLen - MIN_MATCH : 0;
+
+	if (op > oend)
+		return NULL;
+	*token = (char) (((litLen >= 15 ? 15 : litLen) << 4) | (matchCode >= 15 ? 15 : matchCode));
+	if (litLen >= 15 && (op = writeLength(op, oend, litLen - 15)) == NULL)
+		return NULL;
+	if (op + litLen > oend)
+		return NULL;
+	memcpy(op, literals, litLen);
+	op += litLen;
+
+	if (matchLen)
+	{
+		if (op + 2 > oend)
+			return NULL;
+		*op++ = (char) (offset & 0xff);
+		*op++ = (char) (offset >> 8);
+		if (matchCode >= 15 && (op = writeLength(op, oend, matchCode - 15)) == NULL)
+			return NULL;
+	}
+	return op;
+}
+
+int
+pageCompress (const char *src, int srcLen, char *dst, int dstCapacity)
+{
+	int table[1 << HASH_BITS];
+	const char *ip = src;
+	const char *anchor = src;
+	const char *iend = src + srcLen;
+	const char *matchLimit = iend - LAST_LITERALS;
+	char *op = dst;
+	char *oend = dst + (dstCapacity < srcLen - 1 ? dstCapacity : srcLen - 1);
+
+	memset(table, 0xff, sizeof(table));
+
+	while (ip + MIN_MATCH <= matchLimit)
+	{
+		uint32_t sequence = read32(ip);
+		int h = hashSequence(sequence);
+		const char *ref = (table[h] >= 0) ? src + table[h] : NULL;
+		table[h] = (int) (ip - src);
+
+		if (ref == NULL || ip - ref > MAX_OFFSET || read32(ref) != sequence)
+		{
+			ip++;
+			continue;
+		}
+
+		// extend the match forwards
+		int matchLen = MIN_MATCH;
+		while (ip + matchLen < matchLimit && ip[matchLen] == ref[matchLen])
+			matchLen++;
+
+		op = writeSequence(op, oend, anchor, (int) (ip - anchor), (int) (ip - ref), matchLen);
+		if (op == NULL)
+			return 0;
+		ip += matchLen;
+		anchor = ip;
+	}
+
+	op = writeSequence(op, oend, anchor, (int) (iend - anchor), 0, 0);
+	if (op == NULL || op - dst >= srcLen)
+		return 0;
+	return (int) (op - dst);
+}
+
+int
+pageDecompress (const char *src, int srcLen, char *dst, int dstLen)
+{
+	const unsigned char *ip = (const unsigned char *) src;
+	const unsigned char *iend = ip + srcLen;
+	char *op = dst;
+	char *oend = dst + dstLen;
+
+	while (ip < iend)
+	{
+		int token = *ip++;
+		int litLen = token >> 4;
+		int matchLen = token & 15;
+
+		if (litLen == 15)
+		{
+			int b;
+			do
+			{
+				if (ip >= iend)
+					return -1;
+				b = *ip++;
+				litLen += b;
+			} while (b == 255);
+		}
+		if (litLen > iend - ip || litLen > oend - op)
+			return -1;
+		memcpy(op, ip, litLen);
+		ip += litLen;
+		op += litLen;
+
+		// the last sequence carries literals only
+		if (ip == iend)
+			break;
+
+		if (iend - ip < 2)
+			return -1;
+		int offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (matchLen == 15)
+		{
+			int b;
+			do
+			{
+				if (ip >= iend)
+					return -1;
+				b = *ip++;
+				matchLen += b;
+			} while (b == 255);
+		}
+		matchLen += MIN_MATCH;
+		if (offset == 0 || offset > op - dst || matchLen > oend - op)
+			return -1;
+
+		// byte-wise copy handles overlapping matches (runs)
+		const char *ref = op - offset;
+		for (int i = 0; i < matchLen; i++)
+			op[i] = ref[i];
+		op += matchLen;
+	}
+	return (op == oend) ? 0 : -1;
+}
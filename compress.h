@@ -0,0 +1,17 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+/************************************************************
+ *                    page codec                            *
+ ************************************************************/
+/* LZ77 block codec in the LZ4 sequence format, tuned for single pages */
+
+/* compresses srcLen bytes into dst (dstCapacity bytes); returns the
+ * compressed size, or 0 if the result would not be smaller than the input */
+extern int pageCompress (const char *src, int srcLen, char *dst, int dstCapacity);
+
+/* decompresses srcLen bytes into exactly dstLen bytes of dst; returns 0 on
+ * success and -1 if the input is malformed */
+extern int pageDecompress (const char *src, int srcLen, char *dst, int dstLen);
+
+#endif
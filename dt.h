@@ -1,6 +1,8 @@
 #ifndef DT_H
 #define DT_H
 
+#include <stdint.h>
+
 // define bool if not defined
 #ifndef bool
     typedef short bool;
@@ -11,4 +13,7 @@
 #define TRUE true
 #define FALSE false
 
+// page numbers are 64-bit so that files can grow past 2^31 pages
+typedef int64_t PageNumber;
+
 #endif // DT_H
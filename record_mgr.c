@@ -3,22 +3,458 @@
 #include "storage_mgr.h"
 #include "dberror.h"
 #include "tables.h"
+#include "trace.h"
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 
+// Tables are heap files. Page 0 holds the table header: the schema, the
+// tuple count and the number of pages in use. Page 1, and every page
+// fsmEntriesPerPage pages after the previous one, is a free-space map page
+// holding a two-bit space class (RM_SPACE_*) for each of the pages that
+// follow it. Every other page is a slotted page of fixed-size records:
+//
+//   int numLive | slot bitmap, one bit per slot | slot 0 | slot 1 | ...
+//
+// A set bit marks a live record; deleting a record clears its bit and leaves
+// a tombstone, so the RIDs of the other records never change. A RID is the
+// (page, slot) of its record, so getRecord pins exactly one page. Records are
+// stored back to back without padding, and the last PAGE_CHECKSUM_SIZE bytes
+// of every page are left to the storage manager
+#define RM_TABLE_MAGIC "RMTABLE2"
+#define RM_HEADER_PAGE 0
+#define RM_FIRST_SPACE_MAP_PAGE 1
+#define RM_PAGE_HEADER_SIZE ((int)sizeof(int))
+
+// Free space classes of a page; zeroed map pages describe empty pages
+#define RM_SPACE_EMPTY 0    // no live records
+#define RM_SPACE_MOSTLY_FREE 1  // at least half of the slots free
+#define RM_SPACE_PARTIAL 2  // some slots free
+#define RM_SPACE_FULL 3     // no free slot, or not a data page
+#define RM_SPACE_CLASS_BITS 2
+
+// Pages insertRecords fills in memory before writing them in one go
+#define RM_BULK_PAGES 64
+
+// Consecutive pages a parallel scan worker claims, and reads, at a time
+#define RM_MORSEL_PAGES 32
+
+// Where records live on the slotted pages of a table
+typedef struct RM_PageLayout {
+    int recordSize;     // bytes per record
+    int slotsPerPage;   // records per data page
+    int slotsOffset;    // offset of slot 0 within a page
+    int fsmEntriesPerPage;  // pages described by one free-space map page
+} RM_PageLayout;
+
+// In-memory copy of the free-space map. Pages with room are kept in one list
+// per class, so an insert finds its page in constant time: the fullest class
+// with room first, which keeps pages dense, then empty pages, and appends
+// only when every list is empty
+typedef struct RM_SpaceMap {
+    unsigned char *classes;     // class of every page below capacity
+    PageNumber *positions;      // index of a page within its class list
+    PageNumber *lists[RM_SPACE_FULL];   // pages with room, by class
+    PageNumber listSizes[RM_SPACE_FULL];
+    PageNumber listCapacities[RM_SPACE_FULL];
+    PageNumber capacity;        // pages classes and positions can describe
+} RM_SpaceMap;
+
 // Struct for managing table metadata
 typedef struct RM_TableMgmtData {
     BM_BufferPool bufferPool;
     int numTuples;
+    int pageSize;   // bytes per page of the table file
+    RM_PageLayout layout;
+    PageNumber numPages;    // pages in use, header page included
+    RM_SpaceMap spaceMap;
 } RM_TableMgmtData;
 
-// Struct for scan management
+// Struct for snapshot management
+typedef struct RM_SnapshotMgmtData {
+    SM_FileHandle fileHandle;
+    RM_PageLayout layout;
+    PageNumber numPages;    // pages in use, header page included
+} RM_SnapshotMgmtData;
+
+// Struct for scan management. A scan keeps its current page pinned (or, for
+// snapshots, mapped) until it has walked every slot on it
 typedef struct RM_ScanMgmtData {
-    int currentPage;
+    PageNumber currentPage;
     int currentSlot;
     Expr *condition;
+    RM_Snapshot *snap;  // set for scans over a snapshot
+    int *attrOffsets;   // offset of every attribute within a record
+    int recordSize;
+    BM_PageHandle page; // pinned current page of a table scan
+    char *pageData;     // contents of the current page, NULL between pages
 } RM_ScanMgmtData;
 
+// State shared by the workers of a parallel scan. Workers claim morsels by
+// advancing nextMorsel; the first error or callback result other than RC_OK
+// is kept in rc and stops every worker at its next morsel
+typedef struct RM_ParallelScan {
+    RM_TableData *rel;
+    Expr *condition;
+    RM_PageLayout *layout;
+    int *attrOffsets;
+    PageNumber numPages;    // pages in use, header page included
+    atomic_int nextMorsel;
+    atomic_int rc;
+    RM_ScanCallback callback;
+    void *context;
+} RM_ParallelScan;
+
+// One worker of a parallel scan
+typedef struct RM_ScanWorker {
+    RM_ParallelScan *scan;
+    int worker;
+    pthread_t thread;
+} RM_ScanWorker;
+
+// Value of a condition evaluated on the bytes of a record; strings point
+// into the page or the constant instead of being copied
+typedef struct RM_ScanValue {
+    DataType dt;
+    union {
+        int intV;
+        float floatV;
+        bool boolV;
+    } v;
+    const char *string;
+    int length;         // bytes at string, or -1 if it is NUL-terminated
+} RM_ScanValue;
+
+// Computes the slotted page layout of a schema; fails if not even one record fits
+static RC computeLayout(Schema *schema, int pageSize, RM_PageLayout *layout) {
+    int usable = pageSize - PAGE_CHECKSUM_SIZE - RM_PAGE_HEADER_SIZE;
+    layout->recordSize = getRecordSize(schema);
+    if (layout->recordSize <= 0) {
+        TRACE(TRACE_ERROR, TRACE_CAT_RECORD, TE_ERR_INVALID_ARGUMENT, layout->recordSize, __LINE__);
+        return RC_INVALID_ARGUMENT;
+    }
+    // each slot costs its record plus one bit of the bitmap
+    int slots = (int)(8LL * usable / (8LL * layout->recordSize + 1));
+    while (slots > 0 && (slots + 7) / 8 + slots * layout->recordSize > usable) {
+        slots--;
+    }
+    if (slots <= 0) {
+        TRACE(TRACE_ERROR, TRACE_CAT_RECORD, TE_ERR_INVALID_ARGUMENT, layout->recordSize, __LINE__);
+        return RC_INVALID_ARGUMENT;
+    }
+    layout->slotsPerPage = slots;
+    layout->slotsOffset = RM_PAGE_HEADER_SIZE + (slots + 7) / 8;
+    layout->fsmEntriesPerPage = (pageSize - PAGE_CHECKSUM_SIZE) * 8 / RM_SPACE_CLASS_BITS;
+    return RC_OK;
+}
+
+// Tells whether a page of the table holds records
+static bool isDataPage(RM_PageLayout *layout, PageNumber pageNum) {
+    return pageNum > RM_FIRST_SPACE_MAP_PAGE &&
+           (pageNum - RM_FIRST_SPACE_MAP_PAGE) % (layout->fsmEntriesPerPage + 1) != 0;
+}
+
+static int spaceClassOf(RM_PageLayout *layout, int numLive) {
+    int free = layout->slotsPerPage - numLive;
+    if (numLive == 0) {
+        return RM_SPACE_EMPTY;
+    } else if (free == 0) {
+        return RM_SPACE_FULL;
+    } else if (2 * free >= layout->slotsPerPage) {
+        return RM_SPACE_MOSTLY_FREE;
+    }
+    return RM_SPACE_PARTIAL;
+}
+
+static int liveRecords(char *page) {
+    int numLive;
+    memcpy(&numLive, page, sizeof(int));
+    return numLive;
+}
+
+static void setLiveRecords(char *page, int numLive) {
+    memcpy(page, &numLive, sizeof(int));
+}
+
+static bool isSlotUsed(char *page, int slot) {
+    return (page[RM_PAGE_HEADER_SIZE + slot / 8] >> (slot % 8)) & 1;
+}
+
+static void setSlotUsed(char *page, int slot, bool used) {
+    char *bits = page + RM_PAGE_HEADER_SIZE + slot / 8;
+    if (used) {
+        *bits |= (char)(1 << (slot % 8));
+    } else {
+        *bits &= (char)~(1 << (slot % 8));
+    }
+}
+
+static char *slotData(RM_PageLayout *layout, char *page, int slot) {
+    return page + layout->slotsOffset + (size_t)slot * layout->recordSize;
+}
+
+// Appends bytes to the table header; fails once the header page is full
+static RC putBytes(char **pos, char *end, const void *bytes, size_t length) {
+    if ((size_t)(end - *pos) < length) {
+        TRACE(TRACE_ERROR, TRACE_CAT_RECORD, TE_ERR_INVALID_ARGUMENT, (long)length, __LINE__);
+        return RC_INVALID_ARGUMENT;
+    }
+    memcpy(*pos, bytes, length);
+    *pos += length;
+    return RC_OK;
+}
+
+static RC getBytes(char **pos, char *end, void *bytes, size_t length) {
+    if ((size_t)(end - *pos) < length) {
+        TRACE(TRACE_ERROR, TRACE_CAT_RECORD, TE_ERR_BAD_HEADER, (long)length, __LINE__);
+        return RC_BAD_FILE_HEADER;
+    }
+    memcpy(bytes, *pos, length);
+    *pos += length;
+    return RC_OK;
+}
+
+// Serializes the schema, tuple count and page count into a header page
+static RC writeTableHeader(char *page, int pageSize, Schema *schema, int numTuples, PageNumber numPages) {
+    char *pos = page;
+    char *end = page + pageSize - PAGE_CHECKSUM_SIZE;
+    RC rc = putBytes(&pos, end, RM_TABLE_MAGIC, 8);
+    if (rc == RC_OK) rc = putBytes(&pos, end, &numTuples, sizeof(int));
+    if (rc == RC_OK) rc = putBytes(&pos, end, &numPages, sizeof(PageNumber));
+    if (rc == RC_OK) rc = putBytes(&pos, end, &schema->numAttr, sizeof(int));
+    if (rc == RC_OK) rc = putBytes(&pos, end, &schema->keySize, sizeof(int));
+    for (int i = 0; i < schema->numAttr && rc == RC_OK; i++) {
+        int dataType = schema->dataTypes[i];
+        int nameLength = (int)strlen(schema->attrNames[i]);
+        rc = putBytes(&pos, end, &dataType, sizeof(int));
+        if (rc == RC_OK) rc = putBytes(&pos, end, &schema->typeLength[i], sizeof(int));
+        if (rc == RC_OK) rc = putBytes(&pos, end, &nameLength, sizeof(int));
+        if (rc == RC_OK) rc = putBytes(&pos, end, schema->attrNames[i], nameLength);
+    }
+    if (rc == RC_OK && schema->keySize > 0) {
+        rc = putBytes(&pos, end, schema->keyAttrs, sizeof(int) * schema->keySize);
+    }
+    return rc;
+}
+
+// Rebuilds the schema and counters stored in a header page
+static RC readTableHeader(char *page, int pageSize, Schema **schema, int *numTuples, PageNumber *numPages) {
+    char *pos = page;
+    char *end = page + pageSize - PAGE_CHECKSUM_SIZE;
+    char magic[8];
+    int numAttr, keySize;
+    RC rc = getBytes(&pos, end, magic, 8);
+    if (rc == RC_OK && memcmp(magic, RM_TABLE_MAGIC, 8) != 0) {
+        TRACE(TRACE_ERROR, TRACE_CAT_RECORD, TE_ERR_BAD_HEADER, 0, __LINE__);
+        rc = RC_BAD_FILE_HEADER;
+    }
+    if (rc == RC_OK) rc = getBytes(&pos, end, numTuples, sizeof(int));
+    if (rc == RC_OK) rc = getBytes(&pos, end, numPages, sizeof(PageNumber));
+    if (rc == RC_OK) rc = getBytes(&pos, end, &numAttr, sizeof(int));
+    if (rc == RC_OK) rc = getBytes(&pos, end, &keySize, sizeof(int));
+    if (rc != RC_OK) {
+        return rc;
+    }
+    if (numAttr <= 0 || keySize < 0 || keySize > numAttr || *numPages < 1) {
+        TRACE(TRACE_ERROR, TRACE_CAT_RECORD, TE_ERR_BAD_HEADER, numAttr, __LINE__);
+        return RC_BAD_FILE_HEADER;
+    }
+
+    char **attrNames = (char **)calloc(numAttr, sizeof(char *));
+    DataType *dataTypes = (DataType *)malloc(sizeof(DataType) * numAttr);
+    int *typeLength = (int *)malloc(sizeof(int) * numAttr);
+    int *keys = (int *)malloc(sizeof(int) * (keySize > 0 ? keySize : 1));
+    if (!attrNames || !dataTypes || !typeLength || !keys) {
+        rc = RC_WRITE_FAILED;
+    }
+    for (int i = 0; i < numAttr && rc == RC_OK; i++) {
+        int dataType, nameLength;
+        rc = getBytes(&pos, end, &dataType, sizeof(int));
+        if (rc == RC_OK) rc = getBytes(&pos, end, &typeLength[i], sizeof(int));
+        if (rc == RC_OK) rc = getBytes(&pos, end, &nameLength, sizeof(int));
+        if (rc == RC_OK && (nameLength < 0 || nameLength > end - pos)) {
+            rc = RC_BAD_FILE_HEADER;
+        }
+        if (rc == RC_OK) {
+            dataTypes[i] = (DataType)dataType;
+            attrNames[i] = (char *)malloc(nameLength + 1);
+            if (attrNames[i] == NULL) {
+                rc = RC_WRITE_FAILED;
+            } else {
+                rc = getBytes(&pos, end, attrNames[i], nameLength);
+                attrNames[i][nameLength] = '\0';
+            }
+        }
+    }
+    if (rc == RC_OK && keySize > 0) {
+        rc = getBytes(&pos, end, keys, sizeof(int) * keySize);
+    }
+    if (rc != RC_OK) {
+        for (int i = 0; attrNames && i < numAttr; i++) {
+            free(attrNames[i]);
+        }
+        free(attrNames);
+        free(dataTypes);
+        free(typeLength);
+        free(keys);
+        return rc;
+    }
+    *schema = createSchema(numAttr, attrNames, dataTypes, typeLength, keySize, keys);
+    return RC_OK;
+}
+
+// Writes the in-memory counters of an open table to its header page
+static RC saveTableHeader(RM_TableData *rel) {
+    RM_TableMgmtData *mgmtData = (RM_TableMgmtData *)rel->mgmtData;
+    BM_PageHandle header;
+    RC rc = pinPage(&mgmtData->bufferPool, &header, RM_HEADER_PAGE);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    rc = writeTableHeader(header.data, mgmtData->pageSize, rel->schema, mgmtData->numTuples, mgmtData->numPages);
+    if (rc == RC_OK) {
+        rc = markDirty(&mgmtData->bufferPool, &header);
+    }
+    RC unpinRc = unpinPage(&mgmtData->bufferPool, &header);
+    return rc != RC_OK ? rc : unpinRc;
+}
+
+// Makes the space map describe numPages pages; new pages count as full
+static RC growSpaceMap(RM_SpaceMap *map, PageNumber numPages) {
+    if (numPages <= map->capacity) {
+        return RC_OK;
+    }
+    PageNumber capacity = map->capacity ? map->capacity : 64;
+    while (capacity < numPages) {
+        capacity *= 2;
+    }
+    unsigned char *classes = (unsigned char *)realloc(map->classes, capacity);
+    if (classes == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    map->classes = classes;
+    PageNumber *positions = (PageNumber *)realloc(map->positions, sizeof(PageNumber) * capacity);
+    if (positions == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    map->positions = positions;
+    memset(map->classes + map->capacity, RM_SPACE_FULL, capacity - map->capacity);
+    map->capacity = capacity;
+    return RC_OK;
+}
+
+// Moves a page to the list of its new space class
+static RC setSpaceClass(RM_SpaceMap *map, PageNumber pageNum, int spaceClass) {
+    int oldClass = map->classes[pageNum];
+    if (oldClass == spaceClass) {
+        return RC_OK;
+    }
+    if (spaceClass != RM_SPACE_FULL && map->listSizes[spaceClass] == map->listCapacities[spaceClass]) {
+        PageNumber capacity = map->listCapacities[spaceClass] ? 2 * map->listCapacities[spaceClass] : 64;
+        PageNumber *list = (PageNumber *)realloc(map->lists[spaceClass], sizeof(PageNumber) * capacity);
+        if (list == NULL) {
+            return RC_WRITE_FAILED;
+        }
+        map->lists[spaceClass] = list;
+        map->listCapacities[spaceClass] = capacity;
+    }
+    if (oldClass != RM_SPACE_FULL) {
+        // the last page of the list takes the place of the one leaving
+        PageNumber last = map->lists[oldClass][--map->listSizes[oldClass]];
+        map->lists[oldClass][map->positions[pageNum]] = last;
+        map->positions[last] = map->positions[pageNum];
+    }
+    if (spaceClass != RM_SPACE_FULL) {
+        map->positions[pageNum] = map->listSizes[spaceClass];
+        map->lists[spaceClass][map->listSizes[spaceClass]++] = pageNum;
+    }
+    map->classes[pageNum] = (unsigned char)spaceClass;
+    return RC_OK;
+}
+
+// Returns a data page with a free slot, preferring the fullest, or -1 if none has one
+static PageNumber pageWithRoom(RM_SpaceMap *map) {
+    static const int preference[] = { RM_SPACE_PARTIAL, RM_SPACE_MOSTLY_FREE, RM_SPACE_EMPTY };
+    for (int i = 0; i < 3; i++) {
+        int spaceClass = preference[i];
+        if (map->listSizes[spaceClass] > 0) {
+            return map->lists[spaceClass][map->listSizes[spaceClass] - 1];
+        }
+    }
+    return -1;
+}
+
+static void destroySpaceMap(RM_SpaceMap *map) {
+    free(map->classes);
+    free(map->positions);
+    for (int i = 0; i < RM_SPACE_FULL; i++) {
+        free(map->lists[i]);
+    }
+    memset(map, 0, sizeof(RM_SpaceMap));
+}
+
+// Reads the free-space map pages of an open table into memory
+static RC loadSpaceMap(RM_TableMgmtData *mgmtData) {
+    RM_PageLayout *layout = &mgmtData->layout;
+    RM_SpaceMap *map = &mgmtData->spaceMap;
+    memset(map, 0, sizeof(RM_SpaceMap));
+    RC rc = growSpaceMap(map, mgmtData->numPages);
+    for (PageNumber mapPage = RM_FIRST_SPACE_MAP_PAGE; rc == RC_OK && mapPage < mgmtData->numPages;
+         mapPage += layout->fsmEntriesPerPage + 1) {
+        BM_PageHandle page;
+        rc = pinPage(&mgmtData->bufferPool, &page, mapPage);
+        if (rc != RC_OK) {
+            break;
+        }
+        for (int entry = 0; rc == RC_OK && entry < layout->fsmEntriesPerPage; entry++) {
+            PageNumber pageNum = mapPage + 1 + entry;
+            if (pageNum >= mgmtData->numPages) {
+                break;
+            }
+            int shift = (entry % 4) * RM_SPACE_CLASS_BITS;
+            rc = setSpaceClass(map, pageNum, (page.data[entry / 4] >> shift) & 3);
+        }
+        unpinPage(&mgmtData->bufferPool, &page);
+    }
+    if (rc != RC_OK) {
+        destroySpaceMap(map);
+    }
+    return rc;
+}
+
+// Encodes the classes of the pages a map page describes; pages from numPages
+// on are left zeroed, which reads back as empty
+static void encodeSpaceMapPage(RM_TableMgmtData *mgmtData, PageNumber mapPage, char *data, PageNumber numPages) {
+    RM_PageLayout *layout = &mgmtData->layout;
+    memset(data, 0, mgmtData->pageSize - PAGE_CHECKSUM_SIZE);
+    for (int entry = 0; entry < layout->fsmEntriesPerPage; entry++) {
+        PageNumber pageNum = mapPage + 1 + entry;
+        if (pageNum >= numPages) {
+            break;
+        }
+        data[entry / 4] |= (char)(mgmtData->spaceMap.classes[pageNum] << ((entry % 4) * RM_SPACE_CLASS_BITS));
+    }
+}
+
+// Writes the in-memory space classes back to the free-space map pages
+static RC saveSpaceMap(RM_TableMgmtData *mgmtData) {
+    RM_PageLayout *layout = &mgmtData->layout;
+    RC rc = RC_OK;
+    for (PageNumber mapPage = RM_FIRST_SPACE_MAP_PAGE; rc == RC_OK && mapPage < mgmtData->numPages;
+         mapPage += layout->fsmEntriesPerPage + 1) {
+        BM_PageHandle page;
+        rc = pinPage(&mgmtData->bufferPool, &page, mapPage);
+        if (rc != RC_OK) {
+            break;
+        }
+        encodeSpaceMapPage(mgmtData, mapPage, page.data, mgmtData->numPages);
+        markDirty(&mgmtData->bufferPool, &page);
+        rc = unpinPage(&mgmtData->bufferPool, &page);
+    }
+    return rc;
+}
+
 // Initializes the Record Manager
 RC initRecordManager(void *mgmtData) {
     initStorageManager();
@@ -32,35 +468,116 @@ RC shutdownRecordManager() {
 
 // Creates a table
 RC createTable(char *name, Schema *schema) {
-    createPageFile(name);
+    return createTableWithPageSize(name, schema, PAGE_SIZE);
+}
+
+// Creates a table whose file uses pages of pageSize bytes
+RC createTableWithPageSize(char *name, Schema *schema, int pageSize) {
+    if (name == NULL || schema == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    RM_PageLayout layout;
+    RC rc = computeLayout(schema, pageSize, &layout);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    char *header = (char *)calloc(1, pageSize);
+    if (header == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    rc = writeTableHeader(header, pageSize, schema, 0, RM_FIRST_SPACE_MAP_PAGE + 1);
+    if (rc != RC_OK) {
+        free(header);
+        return rc;
+    }
+
+    SM_FileOptions options = { 0, pageSize };
+    rc = createPageFileWithOptions(name, &options);
+    if (rc != RC_OK) {
+        free(header);
+        return rc;
+    }
     SM_FileHandle fh;
-    openPageFile(name, &fh);
-    ensureCapacity(1, &fh);
-    closePageFile(&fh);
-    return RC_OK;
+    rc = openPageFile(name, &fh);
+    if (rc == RC_OK) {
+        rc = ensureCapacity(RM_FIRST_SPACE_MAP_PAGE + 1, &fh);
+        if (rc == RC_OK) {
+            rc = writeBlock(RM_HEADER_PAGE, &fh, header);
+        }
+        RC closeRc = closePageFile(&fh);
+        if (rc == RC_OK) {
+            rc = closeRc;
+        }
+    }
+    free(header);
+    return rc;
 }
 
-// Opens a table
+// Opens a table and reads its schema from the header page
 RC openTable(RM_TableData *rel, char *name) {
+    if (rel == NULL || name == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
     RM_TableMgmtData *mgmtData = (RM_TableMgmtData *)malloc(sizeof(RM_TableMgmtData));
-    initBufferPool(&mgmtData->bufferPool, name, 3, RS_FIFO, NULL);
+    if (mgmtData == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    RC rc = initBufferPool(&mgmtData->bufferPool, name, 3, RS_FIFO, NULL);
+    if (rc != RC_OK) {
+        free(mgmtData);
+        return rc;
+    }
+    mgmtData->pageSize = mgmtData->bufferPool.pageSize;
+
+    BM_PageHandle header;
+    Schema *schema = NULL;
+    rc = pinPage(&mgmtData->bufferPool, &header, RM_HEADER_PAGE);
+    if (rc == RC_OK) {
+        rc = readTableHeader(header.data, mgmtData->pageSize, &schema, &mgmtData->numTuples, &mgmtData->numPages);
+        unpinPage(&mgmtData->bufferPool, &header);
+    }
+    if (rc == RC_OK) {
+        rc = computeLayout(schema, mgmtData->pageSize, &mgmtData->layout);
+        if (rc == RC_OK) {
+            rc = loadSpaceMap(mgmtData);
+        }
+        if (rc != RC_OK) {
+            freeSchema(schema);
+        }
+    }
+    if (rc != RC_OK) {
+        shutdownBufferPool(&mgmtData->bufferPool);
+        free(mgmtData);
+        return rc;
+    }
     rel->mgmtData = mgmtData;
     rel->name = name;
+    rel->schema = schema;
     return RC_OK;
 }
 
-// Closes a table
+// Closes a table, saving its tuple count and writing back its pages
 RC closeTable(RM_TableData *rel) {
+    if (rel == NULL || rel->mgmtData == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
     RM_TableMgmtData *mgmtData = (RM_TableMgmtData *)rel->mgmtData;
-    shutdownBufferPool(&mgmtData->bufferPool);
+    RC rc = saveSpaceMap(mgmtData);
+    if (rc == RC_OK) {
+        rc = saveTableHeader(rel);
+    }
+    RC shutdownRc = shutdownBufferPool(&mgmtData->bufferPool);
+    destroySpaceMap(&mgmtData->spaceMap);
+    freeSchema(rel->schema);
     free(mgmtData);
-    return RC_OK;
+    rel->mgmtData = NULL;
+    rel->schema = NULL;
+    return rc != RC_OK ? rc : shutdownRc;
 }
 
 // Deletes a table
 RC deleteTable(char *name) {
-    destroyPageFile(name);
-    return RC_OK;
+    return destroyPageFile(name);
 }
 
 // Returns the number of tuples
@@ -69,46 +586,885 @@ int getNumTuples(RM_TableData *rel) {
     return mgmtData->numTuples;
 }
 
-// Inserts a record
+// Checks that a RID can name a slot of the table
+static RC checkRID(RM_TableMgmtData *mgmtData, RID id) {
+    if (!isDataPage(&mgmtData->layout, id.page) || id.page >= mgmtData->numPages ||
+        id.slot < 0 || id.slot >= mgmtData->layout.slotsPerPage) {
+        TRACE(TRACE_ERROR, TRACE_CAT_RECORD, TE_ERR_INVALID_ARGUMENT, id.page, __LINE__);
+        return RC_RM_NO_SUCH_RECORD;
+    }
+    return RC_OK;
+}
+
+// Returns the first free slot of a page, or -1 if every slot is used (the
+// space map, saved only by closeTable, can be stale after an unclean exit)
+static int firstFreeSlot(RM_PageLayout *layout, char *page) {
+    unsigned char *bits = (unsigned char *)page + RM_PAGE_HEADER_SIZE;
+    int byte = 0;
+    while (byte * 8 < layout->slotsPerPage && bits[byte] == 0xff) {
+        byte++;
+    }
+    for (int slot = byte * 8; slot < layout->slotsPerPage; slot++) {
+        if (!isSlotUsed(page, slot)) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+// Inserts a record into a page the free-space map knows to have room, or a
+// new page when the table is full, and sets its RID
 RC insertRecord(RM_TableData *rel, Record *record) {
+    if (rel == NULL || rel->mgmtData == NULL || record == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
     RM_TableMgmtData *mgmtData = (RM_TableMgmtData *)rel->mgmtData;
+    RM_PageLayout *layout = &mgmtData->layout;
+    BM_PageHandle page;
+    PageNumber pageNum;
+    int slot = -1;
+    RC rc;
+
+    while (slot < 0) {
+        pageNum = pageWithRoom(&mgmtData->spaceMap);
+        if (pageNum < 0) {
+            // new pages read as zeros: no live records, every slot free, and
+            // a new map page describes only empty pages
+            pageNum = mgmtData->numPages;
+            if (!isDataPage(layout, pageNum)) {
+                pageNum++;
+            }
+            rc = growSpaceMap(&mgmtData->spaceMap, pageNum + 1);
+            if (rc != RC_OK) {
+                return rc;
+            }
+            rc = pinPage(&mgmtData->bufferPool, &page, pageNum);
+            if (rc != RC_OK) {
+                return rc;
+            }
+            mgmtData->numPages = pageNum + 1;
+        } else {
+            rc = pinPage(&mgmtData->bufferPool, &page, pageNum);
+            if (rc != RC_OK) {
+                return rc;
+            }
+        }
+        slot = firstFreeSlot(layout, page.data);
+        if (slot < 0) {
+            // the map was wrong about this page; correct it and look again
+            unpinPage(&mgmtData->bufferPool, &page);
+            rc = setSpaceClass(&mgmtData->spaceMap, pageNum, RM_SPACE_FULL);
+            if (rc != RC_OK) {
+                return rc;
+            }
+        }
+    }
+
+    int numLive = liveRecords(page.data) + 1;
+    memcpy(slotData(layout, page.data, slot), record->data, layout->recordSize);
+    setSlotUsed(page.data, slot, true);
+    setLiveRecords(page.data, numLive);
+    markDirty(&mgmtData->bufferPool, &page);
+    rc = unpinPage(&mgmtData->bufferPool, &page);
+    if (rc == RC_OK) {
+        rc = setSpaceClass(&mgmtData->spaceMap, pageNum, spaceClassOf(layout, numLive));
+    }
+
+    record->id.page = pageNum;
+    record->id.slot = slot;
     mgmtData->numTuples++;
-    return RC_OK;
+    return rc;
 }
 
-// Deletes a record
+// Fills the first count slots of a page built in memory
+static void fillPage(RM_PageLayout *layout, char *page, PageNumber pageNum, Record **records, int count, RID *rids) {
+    for (int slot = 0; slot < count; slot++) {
+        memcpy(slotData(layout, page, slot), records[slot]->data, layout->recordSize);
+        records[slot]->id.page = pageNum;
+        records[slot]->id.slot = slot;
+        if (rids != NULL) {
+            rids[slot] = records[slot]->id;
+        }
+    }
+    memset(page + RM_PAGE_HEADER_SIZE, 0xff, count / 8);
+    if (count % 8 != 0) {
+        page[RM_PAGE_HEADER_SIZE + count / 8] = (char)((1 << (count % 8)) - 1);
+    }
+    setLiveRecords(page, count);
+}
+
+// Bulk load: appends the records to new pages that are filled in memory and
+// written RM_BULK_PAGES at a time with one sequential write, without pins or
+// per-record free-space bookkeeping. Free slots in existing pages are left to
+// insertRecord; on an empty table every page comes out full except the last.
+// The tuple count and the header are updated once per call
+RC insertRecords(RM_TableData *rel, Record **records, int numRecords, RID *rids) {
+    if (rel == NULL || rel->mgmtData == NULL || records == NULL || numRecords < 0) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (numRecords == 0) {
+        return RC_OK;
+    }
+    RM_TableMgmtData *mgmtData = (RM_TableMgmtData *)rel->mgmtData;
+    RM_PageLayout *layout = &mgmtData->layout;
+    size_t batchBytes = (size_t)RM_BULK_PAGES * mgmtData->pageSize;
+    void *buffer = NULL;
+    if (posix_memalign(&buffer, SM_DIRECT_IO_ALIGNMENT, batchBytes) != 0) {
+        return RC_WRITE_FAILED;
+    }
+
+    char *pages[RM_BULK_PAGES];
+    int done = 0;
+    RC rc = RC_OK;
+    while (done < numRecords && rc == RC_OK) {
+        PageNumber firstPage = mgmtData->numPages;
+        PageNumber lastPage = firstPage;
+        int lastLive = 0;
+        int batchRecords = 0;
+        int numPages = 0;
+        memset(buffer, 0, batchBytes);
+        while (numPages < RM_BULK_PAGES && done + batchRecords < numRecords) {
+            PageNumber pageNum = firstPage + numPages;
+            pages[numPages] = (char *)buffer + (size_t)numPages * mgmtData->pageSize;
+            if (isDataPage(layout, pageNum)) {
+                int count = numRecords - done - batchRecords;
+                if (count > layout->slotsPerPage) {
+                    count = layout->slotsPerPage;
+                }
+                fillPage(layout, pages[numPages], pageNum, records + done + batchRecords, count,
+                         rids != NULL ? rids + done + batchRecords : NULL);
+                batchRecords += count;
+                lastPage = pageNum;
+                lastLive = count;
+            }
+            numPages++;
+        }
+        // pages new to the map count as full; only the last one may have room.
+        // Map pages inside the batch are written with these classes, so the
+        // map on disk is right even if the table is never closed
+        rc = growSpaceMap(&mgmtData->spaceMap, firstPage + numPages);
+        if (rc == RC_OK) {
+            rc = setSpaceClass(&mgmtData->spaceMap, lastPage, spaceClassOf(layout, lastLive));
+        }
+        if (rc != RC_OK) {
+            break;
+        }
+        for (int i = 0; i < numPages; i++) {
+            if (!isDataPage(layout, firstPage + i)) {
+                encodeSpaceMapPage(mgmtData, firstPage + i, pages[i], firstPage + numPages);
+            }
+        }
+        rc = writePagesDirect(&mgmtData->bufferPool, firstPage, numPages, pages);
+        if (rc == RC_OK) {
+            mgmtData->numPages = firstPage + numPages;
+            mgmtData->numTuples += batchRecords;
+            done += batchRecords;
+        } else {
+            setSpaceClass(&mgmtData->spaceMap, lastPage, RM_SPACE_FULL);
+        }
+    }
+    free(buffer);
+
+    RC headerRc = (done > 0) ? saveTableHeader(rel) : RC_OK;
+    return rc != RC_OK ? rc : headerRc;
+}
+
+// Deletes a record, leaving a tombstone in its slot
 RC deleteRecord(RM_TableData *rel, RID id) {
-    return RC_OK;
+    if (rel == NULL || rel->mgmtData == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    RM_TableMgmtData *mgmtData = (RM_TableMgmtData *)rel->mgmtData;
+    RC rc = checkRID(mgmtData, id);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    BM_PageHandle page;
+    rc = pinPage(&mgmtData->bufferPool, &page, id.page);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    if (!isSlotUsed(page.data, id.slot)) {
+        unpinPage(&mgmtData->bufferPool, &page);
+        return RC_RM_NO_SUCH_RECORD;
+    }
+    int numLive = liveRecords(page.data) - 1;
+    setSlotUsed(page.data, id.slot, false);
+    setLiveRecords(page.data, numLive);
+    markDirty(&mgmtData->bufferPool, &page);
+    mgmtData->numTuples--;
+    rc = unpinPage(&mgmtData->bufferPool, &page);
+    if (rc == RC_OK) {
+        rc = setSpaceClass(&mgmtData->spaceMap, id.page, spaceClassOf(&mgmtData->layout, numLive));
+    }
+    return rc;
 }
 
-// Updates a record
+// Overwrites the record stored under record->id
 RC updateRecord(RM_TableData *rel, Record *record) {
-    return RC_OK;
+    if (rel == NULL || rel->mgmtData == NULL || record == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    RM_TableMgmtData *mgmtData = (RM_TableMgmtData *)rel->mgmtData;
+    RC rc = checkRID(mgmtData, record->id);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    BM_PageHandle page;
+    rc = pinPage(&mgmtData->bufferPool, &page, record->id.page);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    if (!isSlotUsed(page.data, record->id.slot)) {
+        unpinPage(&mgmtData->bufferPool, &page);
+        return RC_RM_NO_SUCH_RECORD;
+    }
+    memcpy(slotData(&mgmtData->layout, page.data, record->id.slot), record->data, mgmtData->layout.recordSize);
+    markDirty(&mgmtData->bufferPool, &page);
+    return unpinPage(&mgmtData->bufferPool, &page);
 }
 
-// Retrieves a record
+// Retrieves a record with a single pin of its page
 RC getRecord(RM_TableData *rel, RID id, Record *record) {
+    if (rel == NULL || rel->mgmtData == NULL || record == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    RM_TableMgmtData *mgmtData = (RM_TableMgmtData *)rel->mgmtData;
+    RC rc = checkRID(mgmtData, id);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    BM_PageHandle page;
+    rc = pinPage(&mgmtData->bufferPool, &page, id.page);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    if (!isSlotUsed(page.data, id.slot)) {
+        unpinPage(&mgmtData->bufferPool, &page);
+        return RC_RM_NO_SUCH_RECORD;
+    }
+    memcpy(record->data, slotData(&mgmtData->layout, page.data, id.slot), mgmtData->layout.recordSize);
+    record->id = id;
+    return unpinPage(&mgmtData->bufferPool, &page);
+}
+
+static int attrOffset(Schema *schema, int attrNum);
+static int attrSize(Schema *schema, int attrNum);
+
+// Offsets of all attributes within a record, for evaluating conditions in place
+static int *attrOffsetsOf(Schema *schema) {
+    int *offsets = (int *)malloc(sizeof(int) * schema->numAttr);
+    if (offsets == NULL) {
+        return NULL;
+    }
+    for (int i = 0; i < schema->numAttr; i++) {
+        offsets[i] = attrOffset(schema, i);
+    }
+    return offsets;
+}
+
+// Sets up the scan state shared by table and snapshot scans
+static RC createScan(RM_ScanHandle *scan, Schema *schema, Expr *cond, RM_Snapshot *snap) {
+    RM_ScanMgmtData *scanData = (RM_ScanMgmtData *)calloc(1, sizeof(RM_ScanMgmtData));
+    if (scanData == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    scanData->attrOffsets = attrOffsetsOf(schema);
+    if (scanData->attrOffsets == NULL) {
+        free(scanData);
+        return RC_WRITE_FAILED;
+    }
+    scanData->recordSize = getRecordSize(schema);
+    scanData->currentPage = RM_HEADER_PAGE + 1;
+    scanData->currentSlot = 0;
+    scanData->condition = cond;
+    scanData->snap = snap;
+    scan->mgmtData = scanData;
     return RC_OK;
 }
 
 // Starts a scan
 RC startScan(RM_TableData *rel, RM_ScanHandle *scan, Expr *cond) {
-    scan->mgmtData = malloc(sizeof(RM_ScanMgmtData));
+    if (rel == NULL || rel->mgmtData == NULL || scan == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    scan->rel = rel;
+    return createScan(scan, rel->schema, cond, NULL);
+}
+
+// Starts a scan over a snapshot; next reads its records straight from the
+// mapping, without pins or locks
+RC startSnapshotScan(RM_Snapshot *snap, RM_ScanHandle *scan, Expr *cond) {
+    if (snap == NULL || snap->mgmtData == NULL || scan == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    scan->rel = NULL;
+    return createScan(scan, snap->schema, cond, snap);
+}
+
+// Compares two strings like strcmp; a length of -1 means NUL-terminated,
+// otherwise the string ends at its first NUL or after length bytes
+static int compareStrings(const char *left, int leftLength, const char *right, int rightLength) {
+    for (int i = 0; ; i++) {
+        unsigned char l = (leftLength < 0 || i < leftLength) ? (unsigned char)left[i] : 0;
+        unsigned char r = (rightLength < 0 || i < rightLength) ? (unsigned char)right[i] : 0;
+        if (l != r || l == 0) {
+            return (int)l - (int)r;
+        }
+    }
+}
+
+// Evaluates a condition directly on the bytes of a record, with the same
+// semantics as evalExpr but without allocating or copying
+static RC evalOnRecord(Expr *expr, Schema *schema, int *attrOffsets, char *data, RM_ScanValue *result) {
+    switch (expr->type) {
+        case EXPR_CONST: {
+            Value *cons = expr->expr.cons;
+            result->dt = cons->dt;
+            switch (cons->dt) {
+                case DT_INT: result->v.intV = cons->v.intV; break;
+                case DT_FLOAT: result->v.floatV = cons->v.floatV; break;
+                case DT_BOOL: result->v.boolV = cons->v.boolV; break;
+                case DT_STRING:
+                    result->string = cons->v.stringV;
+                    result->length = -1;
+                    break;
+            }
+            return RC_OK;
+        }
+        case EXPR_ATTRREF: {
+            int attrNum = expr->expr.attrRef;
+            if (attrNum < 0 || attrNum >= schema->numAttr) {
+                return RC_INVALID_ARGUMENT;
+            }
+            char *attrData = data + attrOffsets[attrNum];
+            result->dt = schema->dataTypes[attrNum];
+            switch (result->dt) {
+                case DT_INT: memcpy(&result->v.intV, attrData, sizeof(int)); break;
+                case DT_FLOAT: memcpy(&result->v.floatV, attrData, sizeof(float)); break;
+                case DT_BOOL: memcpy(&result->v.boolV, attrData, sizeof(bool)); break;
+                case DT_STRING:
+                    result->string = attrData;
+                    result->length = schema->typeLength[attrNum];
+                    break;
+            }
+            return RC_OK;
+        }
+        case EXPR_OP:
+            break;
+    }
+
+    Operator *op = expr->expr.op;
+    RM_ScanValue left, right;
+    RC rc = evalOnRecord(op->args[0], schema, attrOffsets, data, &left);
+    if (rc == RC_OK && op->type != OP_BOOL_NOT) {
+        rc = evalOnRecord(op->args[1], schema, attrOffsets, data, &right);
+    }
+    if (rc != RC_OK) {
+        return rc;
+    }
+    result->dt = DT_BOOL;
+    switch (op->type) {
+        case OP_BOOL_NOT:
+            if (left.dt != DT_BOOL) {
+                return RC_RM_BOOLEAN_EXPR_ARG_IS_NOT_BOOLEAN;
+            }
+            result->v.boolV = !left.v.boolV;
+            return RC_OK;
+        case OP_BOOL_AND:
+        case OP_BOOL_OR:
+            if (left.dt != DT_BOOL || right.dt != DT_BOOL) {
+                return RC_RM_BOOLEAN_EXPR_ARG_IS_NOT_BOOLEAN;
+            }
+            result->v.boolV = (op->type == OP_BOOL_AND) ? (left.v.boolV && right.v.boolV)
+                                                        : (left.v.boolV || right.v.boolV);
+            return RC_OK;
+        case OP_COMP_EQUAL:
+        case OP_COMP_SMALLER: {
+            if (left.dt != right.dt) {
+                return RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE;
+            }
+            int order = 0;
+            switch (left.dt) {
+                case DT_INT: order = (left.v.intV > right.v.intV) - (left.v.intV < right.v.intV); break;
+                case DT_FLOAT: order = (left.v.floatV > right.v.floatV) - (left.v.floatV < right.v.floatV); break;
+                case DT_BOOL: order = (left.v.boolV > right.v.boolV) - (left.v.boolV < right.v.boolV); break;
+                case DT_STRING: order = compareStrings(left.string, left.length, right.string, right.length); break;
+            }
+            result->v.boolV = (op->type == OP_COMP_EQUAL) ? (order == 0) : (order < 0);
+            return RC_OK;
+        }
+    }
+    return RC_RM_UNKOWN_DATATYPE;
+}
+
+// Evaluates a scan condition on a record in place; a scan without one matches everything
+static RC matchesCondition(Expr *cond, Schema *schema, int *attrOffsets, char *data, bool *matches) {
+    RM_ScanValue result;
+    if (cond == NULL) {
+        *matches = TRUE;
+        return RC_OK;
+    }
+    RC rc = evalOnRecord(cond, schema, attrOffsets, data, &result);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    if (result.dt != DT_BOOL) {
+        return RC_RM_EXPR_RESULT_IS_NOT_BOOLEAN;
+    }
+    *matches = result.v.boolV;
     return RC_OK;
 }
 
-// Retrieves the next record in a scan
-RC next(RM_ScanHandle *scan, Record *record) {
+// Drops the scan's hold on its current page
+static void releaseScanPage(RM_ScanHandle *scan) {
+    RM_ScanMgmtData *scanData = (RM_ScanMgmtData *)scan->mgmtData;
+    if (scanData->pageData != NULL && scanData->snap == NULL) {
+        RM_TableMgmtData *tableData = (RM_TableMgmtData *)scan->rel->mgmtData;
+        unpinPage(&tableData->bufferPool, &scanData->page);
+    }
+    scanData->pageData = NULL;
+}
+
+// Advances a scan to its next matching record and points data at it on the
+// current page, which stays pinned (or mapped) until the scan moves past it.
+// Each page is pinned once and its slots walked in place
+static RC nextMatch(RM_ScanHandle *scan, char **data, RID *id) {
+    RM_ScanMgmtData *scanData = (RM_ScanMgmtData *)scan->mgmtData;
+    RM_TableMgmtData *tableData = NULL;
+    RM_SnapshotMgmtData *snapData = NULL;
+    RM_PageLayout *layout;
+    PageNumber numPages;
+    Schema *schema;
+    if (scanData->snap != NULL) {
+        snapData = (RM_SnapshotMgmtData *)scanData->snap->mgmtData;
+        layout = &snapData->layout;
+        numPages = snapData->numPages;
+        schema = scanData->snap->schema;
+    } else {
+        tableData = (RM_TableMgmtData *)scan->rel->mgmtData;
+        layout = &tableData->layout;
+        numPages = tableData->numPages;
+        schema = scan->rel->schema;
+    }
+
+    while (scanData->currentPage < numPages) {
+        if (scanData->pageData == NULL) {
+            if (!isDataPage(layout, scanData->currentPage)) {
+                scanData->currentPage++;
+                continue;
+            }
+            RC rc;
+            if (snapData != NULL) {
+                rc = getBlockPointer(scanData->currentPage, &snapData->fileHandle, &scanData->pageData);
+            } else {
+                rc = pinPage(&tableData->bufferPool, &scanData->page, scanData->currentPage);
+                scanData->pageData = (rc == RC_OK) ? scanData->page.data : NULL;
+            }
+            if (rc != RC_OK) {
+                scanData->pageData = NULL;
+                return rc;
+            }
+        }
+
+        char *page = scanData->pageData;
+        const unsigned char *bits = (const unsigned char *)page + RM_PAGE_HEADER_SIZE;
+        while (liveRecords(page) > 0 && scanData->currentSlot < layout->slotsPerPage) {
+            int slot = scanData->currentSlot++;
+            if (!isSlotUsed(page, slot)) {
+                if (slot % 8 == 0 && bits[slot / 8] == 0) {
+                    scanData->currentSlot = slot + 8;
+                }
+                continue;
+            }
+            char *record = slotData(layout, page, slot);
+            bool matches;
+            RC rc = matchesCondition(scanData->condition, schema, scanData->attrOffsets, record, &matches);
+            if (rc != RC_OK) {
+                return rc;
+            }
+            if (matches) {
+                *data = record;
+                id->page = scanData->currentPage;
+                id->slot = slot;
+                return RC_OK;
+            }
+        }
+        releaseScanPage(scan);
+        scanData->currentPage++;
+        scanData->currentSlot = 0;
+    }
     return RC_RM_NO_MORE_TUPLES;
 }
 
-// Closes a scan
+// Retrieves the next record in a scan that satisfies its condition; only
+// matching records are copied, into the caller's record
+RC next(RM_ScanHandle *scan, Record *record) {
+    if (scan == NULL || scan->mgmtData == NULL || record == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    char *data;
+    RC rc = nextMatch(scan, &data, &record->id);
+    if (rc == RC_OK) {
+        memcpy(record->data, data, ((RM_ScanMgmtData *)scan->mgmtData)->recordSize);
+    }
+    return rc;
+}
+
+// Tells whether records of two schemas have the same attributes at the same offsets
+static bool sameRecordLayout(Schema *left, Schema *right) {
+    if (left->numAttr != right->numAttr) {
+        return FALSE;
+    }
+    for (int i = 0; i < left->numAttr; i++) {
+        if (left->dataTypes[i] != right->dataTypes[i] || attrSize(left, i) != attrSize(right, i)) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+// Fills a batch with up to its capacity of matching records, splitting each
+// into the column arrays as it is found. The selection vector starts out
+// listing every tuple of the batch
+RC nextBatch(RM_ScanHandle *scan, RM_ColumnBatch *batch) {
+    if (scan == NULL || scan->mgmtData == NULL || batch == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    RM_ScanMgmtData *scanData = (RM_ScanMgmtData *)scan->mgmtData;
+    Schema *scanSchema = (scanData->snap != NULL) ? scanData->snap->schema : scan->rel->schema;
+    // the columns are filled through the scan's attribute offsets
+    if (batch->schema != scanSchema && !sameRecordLayout(batch->schema, scanSchema)) {
+        TRACE(TRACE_ERROR, TRACE_CAT_RECORD, TE_ERR_INVALID_ARGUMENT, batch->schema->numAttr, __LINE__);
+        return RC_INVALID_ARGUMENT;
+    }
+    int numAttr = scanSchema->numAttr;
+    RC rc = RC_OK;
+    batch->numTuples = 0;
+    batch->numSelected = 0;
+    while (batch->numTuples < batch->capacity) {
+        char *data;
+        int row = batch->numTuples;
+        rc = nextMatch(scan, &data, &batch->rids[row]);
+        if (rc != RC_OK) {
+            break;
+        }
+        for (int i = 0; i < numAttr; i++) {
+            int width = batch->columnWidths[i];
+            char *source = data + scanData->attrOffsets[i];
+            if (width == sizeof(int)) {
+                // int and float columns: a fixed-size copy the compiler turns into one move
+                memcpy((int *)batch->columns[i] + row, source, sizeof(int));
+            } else {
+                memcpy((char *)batch->columns[i] + (size_t)row * width, source, width);
+            }
+        }
+        batch->selection[row] = row;
+        batch->numTuples++;
+    }
+    batch->numSelected = batch->numTuples;
+    if (rc == RC_RM_NO_MORE_TUPLES && batch->numTuples > 0) {
+        return RC_OK;
+    }
+    return rc;
+}
+
+// Closes a scan, unpinning the page it stopped on
 RC closeScan(RM_ScanHandle *scan) {
-    free(scan->mgmtData);
+    if (scan == NULL || scan->mgmtData == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    RM_ScanMgmtData *scanData = (RM_ScanMgmtData *)scan->mgmtData;
+    releaseScanPage(scan);
+    free(scanData->attrOffsets);
+    free(scanData);
+    scan->mgmtData = NULL;
+    return RC_OK;
+}
+
+// Allocates a batch of capacity tuples with a column array per attribute of schema
+RC createColumnBatch(RM_ColumnBatch **batch, Schema *schema, int capacity) {
+    if (batch == NULL || schema == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (capacity <= 0) {
+        TRACE(TRACE_ERROR, TRACE_CAT_RECORD, TE_ERR_INVALID_ARGUMENT, capacity, __LINE__);
+        return RC_INVALID_ARGUMENT;
+    }
+    RM_ColumnBatch *result = (RM_ColumnBatch *)calloc(1, sizeof(RM_ColumnBatch));
+    if (result == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    result->schema = schema;
+    result->capacity = capacity;
+    result->columns = (void **)calloc(schema->numAttr, sizeof(void *));
+    result->columnWidths = (int *)malloc(sizeof(int) * schema->numAttr);
+    result->selection = (int *)malloc(sizeof(int) * capacity);
+    result->rids = (RID *)malloc(sizeof(RID) * capacity);
+    bool allocated = result->columns != NULL && result->columnWidths != NULL &&
+                     result->selection != NULL && result->rids != NULL;
+    for (int i = 0; allocated && i < schema->numAttr; i++) {
+        result->columnWidths[i] = attrSize(schema, i);
+        result->columns[i] = malloc((size_t)capacity * result->columnWidths[i]);
+        allocated = result->columns[i] != NULL;
+    }
+    if (!allocated) {
+        freeColumnBatch(result);
+        return RC_WRITE_FAILED;
+    }
+    *batch = result;
     return RC_OK;
 }
 
-// Creates a schema
+// Frees a batch and its columns; the schema stays with the caller
+RC freeColumnBatch(RM_ColumnBatch *batch) {
+    if (batch == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (batch->columns != NULL) {
+        for (int i = 0; i < batch->schema->numAttr; i++) {
+            free(batch->columns[i]);
+        }
+    }
+    free(batch->columns);
+    free(batch->columnWidths);
+    free(batch->selection);
+    free(batch->rids);
+    free(batch);
+    return RC_OK;
+}
+
+// Keeps the first failure of a parallel scan; the others are dropped
+static void failParallelScan(RM_ParallelScan *scan, RC rc) {
+    int expected = RC_OK;
+    atomic_compare_exchange_strong(&scan->rc, &expected, rc);
+}
+
+// Evaluates the condition on every live record of a page and hands the
+// matches to the callback
+static RC scanMorselPage(RM_ScanWorker *worker, char *page, PageNumber pageNum, Record *record) {
+    RM_ParallelScan *scan = worker->scan;
+    RM_PageLayout *layout = scan->layout;
+    const unsigned char *bits = (const unsigned char *)page + RM_PAGE_HEADER_SIZE;
+    if (liveRecords(page) == 0) {
+        return RC_OK;
+    }
+    for (int slot = 0; slot < layout->slotsPerPage; slot++) {
+        if (!isSlotUsed(page, slot)) {
+            if (slot % 8 == 0 && bits[slot / 8] == 0) {
+                slot += 7;
+            }
+            continue;
+        }
+        char *data = slotData(layout, page, slot);
+        bool matches;
+        RC rc = matchesCondition(scan->condition, scan->rel->schema, scan->attrOffsets, data, &matches);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        if (matches) {
+            memcpy(record->data, data, layout->recordSize);
+            record->id.page = pageNum;
+            record->id.slot = slot;
+            rc = scan->callback(worker->worker, record, scan->context);
+            if (rc != RC_OK) {
+                return rc;
+            }
+        }
+    }
+    return RC_OK;
+}
+
+// Body of a parallel scan worker: claims morsels until none are left, reading
+// each with one readBlocks call through the worker's own read-only handle
+static void *runScanWorker(void *arg) {
+    RM_ScanWorker *worker = (RM_ScanWorker *)arg;
+    RM_ParallelScan *scan = worker->scan;
+    RM_TableMgmtData *tableData = (RM_TableMgmtData *)scan->rel->mgmtData;
+    SM_FileHandle fh;
+    SM_PageHandle pages[RM_MORSEL_PAGES];
+    Record *record = NULL;
+    char *buffer = (char *)malloc((size_t)tableData->pageSize * RM_MORSEL_PAGES);
+    RC rc = (buffer == NULL) ? RC_WRITE_FAILED : createRecord(&record, scan->rel->schema);
+    if (rc != RC_OK) {
+        free(buffer);
+        failParallelScan(scan, rc);
+        return NULL;
+    }
+    rc = openPageFileWithFlags(scan->rel->name, &fh, SM_OPEN_READONLY);
+    if (rc != RC_OK) {
+        freeRecord(record);
+        free(buffer);
+        failParallelScan(scan, rc);
+        return NULL;
+    }
+    for (int i = 0; i < RM_MORSEL_PAGES; i++) {
+        pages[i] = buffer + (size_t)i * tableData->pageSize;
+    }
+
+    PageNumber numPages = scan->numPages < fh.totalNumPages ? scan->numPages : fh.totalNumPages;
+    while (rc == RC_OK && atomic_load(&scan->rc) == RC_OK) {
+        PageNumber first = RM_HEADER_PAGE + 1 + (PageNumber)atomic_fetch_add(&scan->nextMorsel, 1) * RM_MORSEL_PAGES;
+        if (first >= numPages) {
+            break;
+        }
+        int count = (numPages - first < RM_MORSEL_PAGES) ? (int)(numPages - first) : RM_MORSEL_PAGES;
+        rc = readBlocks(first, count, &fh, pages);
+        for (int i = 0; rc == RC_OK && i < count; i++) {
+            if (isDataPage(scan->layout, first + i)) {
+                rc = scanMorselPage(worker, pages[i], first + i, record);
+            }
+        }
+    }
+    if (rc != RC_OK) {
+        failParallelScan(scan, rc);
+    }
+    closePageFile(&fh);
+    freeRecord(record);
+    free(buffer);
+    return NULL;
+}
+
+// Scans the table with numWorkers threads. The pool is checkpointed first, so
+// the workers can read the file directly; the calling thread runs worker 0,
+// and if fewer threads can be started the rest of the morsels are shared by
+// those that were
+RC parallelScan(RM_TableData *rel, Expr *cond, int numWorkers, RM_ScanCallback callback, void *context) {
+    if (rel == NULL || rel->mgmtData == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (numWorkers <= 0 || callback == NULL) {
+        TRACE(TRACE_ERROR, TRACE_CAT_RECORD, TE_ERR_INVALID_ARGUMENT, numWorkers, __LINE__);
+        return RC_INVALID_ARGUMENT;
+    }
+    RM_TableMgmtData *tableData = (RM_TableMgmtData *)rel->mgmtData;
+    RC rc = checkpointBufferPool(&tableData->bufferPool);
+    if (rc != RC_OK) {
+        return rc;
+    }
+
+    RM_ParallelScan scan;
+    scan.rel = rel;
+    scan.condition = cond;
+    scan.layout = &tableData->layout;
+    scan.numPages = tableData->numPages;
+    scan.callback = callback;
+    scan.context = context;
+    atomic_init(&scan.nextMorsel, 0);
+    atomic_init(&scan.rc, RC_OK);
+    scan.attrOffsets = attrOffsetsOf(rel->schema);
+    RM_ScanWorker *workers = (RM_ScanWorker *)malloc(sizeof(RM_ScanWorker) * numWorkers);
+    if (scan.attrOffsets == NULL || workers == NULL) {
+        free(scan.attrOffsets);
+        free(workers);
+        return RC_WRITE_FAILED;
+    }
+
+    int started = 1;
+    for (int i = 0; i < numWorkers; i++) {
+        workers[i].scan = &scan;
+        workers[i].worker = i;
+    }
+    while (started < numWorkers &&
+           pthread_create(&workers[started].thread, NULL, runScanWorker, &workers[started]) == 0) {
+        started++;
+    }
+    runScanWorker(&workers[0]);
+    for (int i = 1; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    free(scan.attrOffsets);
+    free(workers);
+    return atomic_load(&scan.rc);
+}
+
+// Copies the table into snapshotName; the buffer pool writes its dirty pages
+// first, and the table stays usable during the copy
+RC freezeTable(RM_TableData *rel, char *snapshotName) {
+    if (rel == NULL || rel->mgmtData == NULL || snapshotName == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    RM_TableMgmtData *mgmtData = (RM_TableMgmtData *)rel->mgmtData;
+    RC rc = saveSpaceMap(mgmtData);
+    if (rc == RC_OK) {
+        rc = saveTableHeader(rel);
+    }
+    if (rc != RC_OK) {
+        return rc;
+    }
+    return backupBufferPool(&mgmtData->bufferPool, snapshotName);
+}
+
+// Maps a snapshot read-only; fails for files that cannot be mapped (mem:)
+RC openSnapshot(RM_Snapshot *snap, char *snapshotName) {
+    if (snap == NULL || snapshotName == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    RM_SnapshotMgmtData *snapData = (RM_SnapshotMgmtData *)malloc(sizeof(RM_SnapshotMgmtData));
+    if (snapData == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    RC rc = openPageFileWithFlags(snapshotName, &snapData->fileHandle, SM_OPEN_READONLY | SM_OPEN_MMAP);
+    if (rc != RC_OK) {
+        free(snapData);
+        return rc;
+    }
+
+    char *header;
+    Schema *schema = NULL;
+    int numTuples;
+    rc = getBlockPointer(RM_HEADER_PAGE, &snapData->fileHandle, &header);
+    if (rc == RC_OK) {
+        rc = readTableHeader(header, snapData->fileHandle.pageSize, &schema, &numTuples, &snapData->numPages);
+    }
+    if (rc == RC_OK) {
+        rc = computeLayout(schema, snapData->fileHandle.pageSize, &snapData->layout);
+        if (rc != RC_OK) {
+            freeSchema(schema);
+        }
+    }
+    if (rc != RC_OK) {
+        closePageFile(&snapData->fileHandle);
+        free(snapData);
+        return rc;
+    }
+    if (snapData->numPages > snapData->fileHandle.totalNumPages) {
+        snapData->numPages = snapData->fileHandle.totalNumPages;
+    }
+    snap->name = snapshotName;
+    snap->schema = schema;
+    snap->numTuples = numTuples;
+    snap->pageSize = snapData->fileHandle.pageSize;
+    snap->numPages = snapData->fileHandle.totalNumPages;
+    snap->mgmtData = snapData;
+    return RC_OK;
+}
+
+// Points page at a page of the mapping; nothing is copied or pinned
+RC getSnapshotPage(RM_Snapshot *snap, PageNumber pageNum, char **page) {
+    if (snap == NULL || snap->mgmtData == NULL || page == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    RM_SnapshotMgmtData *snapData = (RM_SnapshotMgmtData *)snap->mgmtData;
+    return getBlockPointer(pageNum, &snapData->fileHandle, page);
+}
+
+// Unmaps a snapshot; page pointers obtained from it become invalid
+RC closeSnapshot(RM_Snapshot *snap) {
+    if (snap == NULL || snap->mgmtData == NULL) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    RM_SnapshotMgmtData *snapData = (RM_SnapshotMgmtData *)snap->mgmtData;
+    RC rc = closePageFile(&snapData->fileHandle);
+    freeSchema(snap->schema);
+    free(snapData);
+    snap->schema = NULL;
+    snap->mgmtData = NULL;
+    return rc;
+}
+
+// Creates a schema; it takes ownership of the arrays and names passed in
 Schema *createSchema(int numAttr, char **attrNames, DataType *dataTypes, int *typeLength, int keySize, int *keys) {
     Schema *schema = (Schema *)malloc(sizeof(Schema));
     schema->numAttr = numAttr;
@@ -120,16 +1476,35 @@ Schema *createSchema(int numAttr, char **attrNames, DataType *dataTypes, int *ty
     return schema;
 }
 
-// Frees a schema
+// Frees a schema with its names and arrays
 RC freeSchema(Schema *schema) {
+    if (schema == NULL) {
+        return RC_OK;
+    }
+    for (int i = 0; schema->attrNames != NULL && i < schema->numAttr; i++) {
+        free(schema->attrNames[i]);
+    }
+    free(schema->attrNames);
+    free(schema->dataTypes);
+    free(schema->typeLength);
+    free(schema->keyAttrs);
     free(schema);
     return RC_OK;
 }
 
-// Creates a record
+// Creates a record with all attributes zeroed and no RID yet
 RC createRecord(Record **record, Schema *schema) {
     *record = (Record *)malloc(sizeof(Record));
-    (*record)->data = (char *)malloc(getRecordSize(schema));
+    if (*record == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    (*record)->data = (char *)calloc(1, getRecordSize(schema));
+    if ((*record)->data == NULL) {
+        free(*record);
+        return RC_WRITE_FAILED;
+    }
+    (*record)->id.page = -1;
+    (*record)->id.slot = -1;
     return RC_OK;
 }
 
@@ -140,13 +1515,74 @@ RC freeRecord(Record *record) {
     return RC_OK;
 }
 
-// Gets an attribute
+// Returns the size in bytes of an attribute
+static int attrSize(Schema *schema, int attrNum) {
+    switch (schema->dataTypes[attrNum]) {
+        case DT_INT: return sizeof(int);
+        case DT_FLOAT: return sizeof(float);
+        case DT_BOOL: return sizeof(bool);
+        case DT_STRING: return schema->typeLength[attrNum];
+    }
+    return 0;
+}
+
+// Returns the offset of an attribute within a record
+static int attrOffset(Schema *schema, int attrNum) {
+    int offset = 0;
+    for (int i = 0; i < attrNum; i++) {
+        offset += attrSize(schema, i);
+    }
+    return offset;
+}
+
+// Gets an attribute; strings are returned NUL-terminated
 RC getAttr(Record *record, Schema *schema, int attrNum, Value **value) {
+    if (record == NULL || schema == NULL || value == NULL || attrNum < 0 || attrNum >= schema->numAttr) {
+        TRACE(TRACE_ERROR, TRACE_CAT_RECORD, TE_ERR_INVALID_ARGUMENT, attrNum, __LINE__);
+        return RC_INVALID_ARGUMENT;
+    }
+    char *attrData = record->data + attrOffset(schema, attrNum);
+    Value *result = (Value *)malloc(sizeof(Value));
+    if (result == NULL) {
+        return RC_WRITE_FAILED;
+    }
+    result->dt = schema->dataTypes[attrNum];
+    switch (result->dt) {
+        case DT_INT: memcpy(&result->v.intV, attrData, sizeof(int)); break;
+        case DT_FLOAT: memcpy(&result->v.floatV, attrData, sizeof(float)); break;
+        case DT_BOOL: memcpy(&result->v.boolV, attrData, sizeof(bool)); break;
+        case DT_STRING: {
+            int length = schema->typeLength[attrNum];
+            result->v.stringV = (char *)malloc(length + 1);
+            if (result->v.stringV == NULL) {
+                free(result);
+                return RC_WRITE_FAILED;
+            }
+            memcpy(result->v.stringV, attrData, length);
+            result->v.stringV[length] = '\0';
+            break;
+        }
+    }
+    *value = result;
     return RC_OK;
 }
 
-// Sets an attribute
+// Sets an attribute; strings are cut or zero-padded to the attribute's length
 RC setAttr(Record *record, Schema *schema, int attrNum, Value *value) {
+    if (record == NULL || schema == NULL || value == NULL || attrNum < 0 || attrNum >= schema->numAttr) {
+        TRACE(TRACE_ERROR, TRACE_CAT_RECORD, TE_ERR_INVALID_ARGUMENT, attrNum, __LINE__);
+        return RC_INVALID_ARGUMENT;
+    }
+    if (value->dt != schema->dataTypes[attrNum]) {
+        return RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE;
+    }
+    char *attrData = record->data + attrOffset(schema, attrNum);
+    switch (value->dt) {
+        case DT_INT: memcpy(attrData, &value->v.intV, sizeof(int)); break;
+        case DT_FLOAT: memcpy(attrData, &value->v.floatV, sizeof(float)); break;
+        case DT_BOOL: memcpy(attrData, &value->v.boolV, sizeof(bool)); break;
+        case DT_STRING: strncpy(attrData, value->v.stringV, schema->typeLength[attrNum]); break;
+    }
     return RC_OK;
 }
 
@@ -12,10 +12,39 @@ typedef struct RM_ScanHandle
 	void *mgmtData;
 } RM_ScanHandle;
 
+// Scan results stored column by column (nextBatch). Column i is an array of
+// capacity values of attribute i: int, float or bool, or for strings
+// typeLength bytes per tuple, without a terminator when the string fills
+// them. nextBatch lists every tuple it returns in the selection vector;
+// later filters can narrow it without moving the column data
+typedef struct RM_ColumnBatch
+{
+	Schema *schema;
+	int capacity;		// tuples every column can hold
+	int numTuples;		// tuples filled by the last nextBatch
+	void **columns;		// one array per attribute
+	int *columnWidths;	// bytes per value of every column
+	int *selection;		// indexes of the selected tuples
+	int numSelected;
+	RID *rids;		// RID of every tuple
+} RM_ColumnBatch;
+
+// Read-only snapshot of a table, read straight from a mapping of its file
+typedef struct RM_Snapshot
+{
+	char *name;
+	Schema *schema;
+	int numTuples;
+	int pageSize;
+	PageNumber numPages;
+	void *mgmtData;
+} RM_Snapshot;
+
 // table and manager
 extern RC initRecordManager (void *mgmtData);
 extern RC shutdownRecordManager ();
 extern RC createTable (char *name, Schema *schema);
+extern RC createTableWithPageSize (char *name, Schema *schema, int pageSize);
 extern RC openTable (RM_TableData *rel, char *name);
 extern RC closeTable (RM_TableData *rel);
 extern RC deleteTable (char *name);
@@ -23,6 +52,7 @@ extern int getNumTuples (RM_TableData *rel);
 
 // handling records in a table
 extern RC insertRecord (RM_TableData *rel, Record *record);
+extern RC insertRecords (RM_TableData *rel, Record **records, int numRecords, RID *rids);
 extern RC deleteRecord (RM_TableData *rel, RID id);
 extern RC updateRecord (RM_TableData *rel, Record *record);
 extern RC getRecord (RM_TableData *rel, RID id, Record *record);
@@ -32,6 +62,36 @@ extern RC startScan (RM_TableData *rel, RM_ScanHandle *scan, Expr *cond);
 extern RC next (RM_ScanHandle *scan, Record *record);
 extern RC closeScan (RM_ScanHandle *scan);
 
+// batch scans: nextBatch fills a batch with the next matching records of a
+// scan, returning RC_RM_NO_MORE_TUPLES only when it found none; next and
+// nextBatch can be mixed on one scan. The batch must be created for the
+// scanned schema, or one with the same attribute types and sizes; others
+// are rejected with RC_INVALID_ARGUMENT
+extern RC createColumnBatch (RM_ColumnBatch **batch, Schema *schema, int capacity);
+extern RC nextBatch (RM_ScanHandle *scan, RM_ColumnBatch *batch);
+extern RC freeColumnBatch (RM_ColumnBatch *batch);
+
+// parallel scans: the table's pages are split into morsels of consecutive
+// pages that numWorkers threads claim one at a time. Each worker evaluates
+// cond on its own pages and hands every match to callback, on its own thread
+// and with its worker number (0 to numWorkers - 1), so callers can keep
+// per-worker results without locking. The record is reused after the
+// callback returns; a result other than RC_OK stops the scan and is returned
+// by parallelScan. The table must not be changed until parallelScan returns
+typedef RC (*RM_ScanCallback) (int worker, Record *record, void *context);
+extern RC parallelScan (RM_TableData *rel, Expr *cond, int numWorkers, RM_ScanCallback callback, void *context);
+
+// snapshots: freezeTable copies a table, with its pending changes, into a
+// new page file; snapshot pages are served from a read-only mapping of that
+// file, without buffer pool pins, copies or locks, and stay valid until
+// closeSnapshot. Snapshot scans are read with next and closed with
+// closeScan. Snapshots are removed with deleteTable
+extern RC freezeTable (RM_TableData *rel, char *snapshotName);
+extern RC openSnapshot (RM_Snapshot *snap, char *snapshotName);
+extern RC getSnapshotPage (RM_Snapshot *snap, PageNumber pageNum, char **page);
+extern RC startSnapshotScan (RM_Snapshot *snap, RM_ScanHandle *scan, Expr *cond);
+extern RC closeSnapshot (RM_Snapshot *snap);
+
 // dealing with schemas
 extern int getRecordSize (Schema *schema);
 extern Schema *createSchema (int numAttr, char **attrNames, DataType *dataTypes, int *typeLength, int keySize, int *keys);
@@ -155,7 +155,7 @@ serializeRecord(Record *record, Schema *schema)
 	MAKE_VARSTRING(result);
 	int i;
 
-	APPEND(result, "[%i-%i] (", record->id.page, record->id.slot);
+	APPEND(result, "[%lld-%i] (", (long long) record->id.page, record->id.slot);
 
 	for(i = 0; i < schema->numAttr; i++)
 	{
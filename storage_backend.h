@@ -0,0 +1,90 @@
+#ifndef STORAGE_BACKEND_H
+#define STORAGE_BACKEND_H
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/************************************************************
+ *                  storage backend interface               *
+ ************************************************************/
+
+/* The storage manager keeps its page files in a backend chosen by the file
+ * name: names starting with a registered backend's prefix ("mem:" for the
+ * in-memory backend) go to that backend, all others to the POSIX one.
+ * Operations behave like the system calls they are named after and return -1
+ * with errno set on failure. */
+
+struct SM_Backend;
+
+/* an open file; backends embed it as the first member of their own state */
+typedef struct SM_BackendFile {
+	const struct SM_Backend *backend;
+} SM_BackendFile;
+
+typedef struct SM_Backend {
+	const char *prefix;	/* file names this backend serves ("" for any) */
+	SM_BackendFile *(*open) (const char *path, int openFlags, mode_t mode);
+	int (*close) (SM_BackendFile *file);
+	int (*unlink) (const char *path);
+	int (*exists) (const char *path);
+	ssize_t (*pread) (SM_BackendFile *file, void *buffer, size_t length, off_t offset);
+	ssize_t (*pwrite) (SM_BackendFile *file, const void *buffer, size_t length, off_t offset);
+	ssize_t (*preadv) (SM_BackendFile *file, const struct iovec *iov, int iovcnt, off_t offset);
+	ssize_t (*pwritev) (SM_BackendFile *file, const struct iovec *iov, int iovcnt, off_t offset);
+	/* logical size and bytes actually reserved (st_size, st_blocks * 512) */
+	int (*size) (SM_BackendFile *file, off_t *size, off_t *allocated);
+	int (*truncate) (SM_BackendFile *file, off_t size);
+	/* reserves space without changing the size; EOPNOTSUPP if it cannot */
+	int (*allocate) (SM_BackendFile *file, off_t offset, off_t length);
+	int (*sync) (SM_BackendFile *file);
+	/* posix_fadvise advice; backends without a page cache ignore it */
+	int (*advise) (SM_BackendFile *file, off_t offset, off_t length, int advice);
+	/* descriptor that can be mapped with mmap, or -1 */
+	int (*descriptor) (SM_BackendFile *file);
+} SM_Backend;
+
+extern const SM_Backend posixBackend;
+extern const SM_Backend memoryBackend;
+extern const SM_Backend slowBackend;
+
+/* The "slow:" backend forwards "slow:<name>" to the backend serving <name>
+ * and delays every transfer and sync to imitate a remote disk. Transfers
+ * share one link of the configured bandwidth, so concurrent I/O queues. */
+typedef enum SM_LatencyDistribution {
+	SM_LATENCY_FIXED = 0,	/* always the mean */
+	SM_LATENCY_UNIFORM = 1,	/* mean +- jitter */
+	SM_LATENCY_NORMAL = 2	/* mean with jitter as standard deviation */
+} SM_LatencyDistribution;
+
+typedef struct SM_SlowBackendConfig {
+	SM_LatencyDistribution distribution;
+	long readLatencyMicros;		/* mean delay of a read */
+	long writeLatencyMicros;	/* mean delay of a write */
+	long syncLatencyMicros;		/* mean delay of a sync */
+	long jitterMicros;
+	long bandwidthBytesPerSec;	/* 0 for no limit */
+	double slowFraction;		/* share of I/Os that also take slowLatencyMicros */
+	long slowLatencyMicros;
+	unsigned int seed;		/* same seed, same sequence of delays */
+} SM_SlowBackendConfig;
+
+typedef struct SM_SlowBackendStats {
+	long reads;
+	long writes;
+	long syncs;
+	long slowIOs;			/* I/Os that got the extra slow delay */
+	long long delayMicros;		/* total delay injected */
+} SM_SlowBackendStats;
+
+/* replaces the configuration of all "slow:" files and clears the stats */
+extern void setSlowBackendConfig(const SM_SlowBackendConfig *config);
+extern void getSlowBackendStats(SM_SlowBackendStats *stats);
+
+/* makes a backend available under its prefix; returns 0, or -1 when the
+ * table of backends is full */
+extern int registerStorageBackend(const SM_Backend *backend);
+
+/* the backend that serves a file name */
+extern const SM_Backend *storageBackendFor(const char *path);
+
+#endif
@@ -0,0 +1,354 @@
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+
+#include "storage_backend.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+
+// In-memory page files ("mem:<name>"): every file is an array of fixed-size
+// chunks that lives until it is unlinked and its last handle is closed. A
+// chunk that was never written is NULL and reads as zeros, so sparse files
+// cost nothing. No system calls are made, which keeps scratch tables off the
+// disk and benchmarks free of device noise
+#define MEM_PREFIX "mem:"
+#define MEM_CHUNK_SIZE (64 * 1024)
+
+typedef struct MemFile {
+    char *name;
+    char **chunks;          // MEM_CHUNK_SIZE bytes each, NULL until written
+    size_t numChunks;       // entries in chunks
+    off_t size;             // logical size in bytes
+    int openCount;          // handles currently open on the file
+    int unlinked;           // removed from the registry, freed on last close
+    pthread_mutex_t lock;
+    struct MemFile *next;
+} MemFile;
+
+typedef struct MemHandle {
+    SM_BackendFile base;
+    MemFile *file;
+} MemHandle;
+
+// Named files, found again by later opens
+static MemFile *memFiles = NULL;
+static pthread_mutex_t memFilesLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Finds a file by name; the registry lock must be held
+static MemFile *findMemFile(const char *path) {
+    for (MemFile *file = memFiles; file != NULL; file = file->next) {
+        if (strcmp(file->name, path) == 0) {
+            return file;
+        }
+    }
+    return NULL;
+}
+
+static void freeMemFile(MemFile *file) {
+    for (size_t i = 0; i < file->numChunks; i++) {
+        free(file->chunks[i]);
+    }
+    free(file->chunks);
+    free(file->name);
+    pthread_mutex_destroy(&file->lock);
+    free(file);
+}
+
+// Drops the chunks wholly past size and zeroes the tail of the last one, so
+// growing the file again reads zeros; the file lock must be held
+static void shrinkMemFile(MemFile *file, off_t size) {
+    size_t keep = (size_t)((size + MEM_CHUNK_SIZE - 1) / MEM_CHUNK_SIZE);
+    for (size_t i = keep; i < file->numChunks; i++) {
+        free(file->chunks[i]);
+        file->chunks[i] = NULL;
+    }
+    if (size % MEM_CHUNK_SIZE != 0 && keep > 0 && keep <= file->numChunks && file->chunks[keep - 1]) {
+        size_t used = size % MEM_CHUNK_SIZE;
+        memset(file->chunks[keep - 1] + used, 0, MEM_CHUNK_SIZE - used);
+    }
+    file->size = size;
+}
+
+// Makes the chunk array cover end bytes; the file lock must be held
+static int growMemFile(MemFile *file, off_t end) {
+    size_t needed = (size_t)((end + MEM_CHUNK_SIZE - 1) / MEM_CHUNK_SIZE);
+    if (needed <= file->numChunks) {
+        return 0;
+    }
+    size_t capacity = file->numChunks ? file->numChunks : 16;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+    char **chunks = (char **)realloc(file->chunks, capacity * sizeof(char *));
+    if (!chunks) {
+        errno = ENOMEM;
+        return -1;
+    }
+    memset(chunks + file->numChunks, 0, (capacity - file->numChunks) * sizeof(char *));
+    file->chunks = chunks;
+    file->numChunks = capacity;
+    return 0;
+}
+
+// Copies between a buffer and the file; the file lock must be held
+static ssize_t memTransfer(MemFile *file, char *buffer, size_t length, off_t offset, int isWrite) {
+    if (offset < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (isWrite) {
+        if (growMemFile(file, offset + (off_t)length) != 0) {
+            return -1;
+        }
+    } else if (offset >= file->size) {
+        return 0;
+    } else if ((off_t)length > file->size - offset) {
+        length = (size_t)(file->size - offset);
+    }
+
+    size_t done = 0;
+    while (done < length) {
+        off_t position = offset + (off_t)done;
+        size_t chunk = (size_t)(position / MEM_CHUNK_SIZE);
+        size_t within = (size_t)(position % MEM_CHUNK_SIZE);
+        size_t piece = MEM_CHUNK_SIZE - within;
+        if (piece > length - done) {
+            piece = length - done;
+        }
+        if (isWrite) {
+            if (file->chunks[chunk] == NULL) {
+                file->chunks[chunk] = (char *)calloc(1, MEM_CHUNK_SIZE);
+                if (file->chunks[chunk] == NULL) {
+                    errno = ENOMEM;
+                    break;
+                }
+            }
+            memcpy(file->chunks[chunk] + within, buffer + done, piece);
+        } else if (file->chunks[chunk] == NULL) {
+            memset(buffer + done, 0, piece);
+        } else {
+            memcpy(buffer + done, file->chunks[chunk] + within, piece);
+        }
+        done += piece;
+    }
+    if (isWrite && offset + (off_t)done > file->size) {
+        file->size = offset + (off_t)done;
+    }
+    return (done == 0 && length > 0) ? -1 : (ssize_t)done;
+}
+
+static MemFile *memFileOf(SM_BackendFile *file) {
+    return ((MemHandle *)file)->file;
+}
+
+static SM_BackendFile *memOpen(const char *path, int openFlags, mode_t mode) {
+    (void)mode;
+    MemHandle *handle = (MemHandle *)malloc(sizeof(MemHandle));
+    if (!handle) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    pthread_mutex_lock(&memFilesLock);
+    MemFile *file = findMemFile(path);
+    if (file == NULL) {
+        if (!(openFlags & O_CREAT)) {
+            pthread_mutex_unlock(&memFilesLock);
+            free(handle);
+            errno = ENOENT;
+            return NULL;
+        }
+        file = (MemFile *)calloc(1, sizeof(MemFile));
+        if (file) {
+            file->name = strdup(path);
+        }
+        if (!file || !file->name) {
+            pthread_mutex_unlock(&memFilesLock);
+            if (file) {
+                free(file);
+            }
+            free(handle);
+            errno = ENOMEM;
+            return NULL;
+        }
+        pthread_mutex_init(&file->lock, NULL);
+        file->next = memFiles;
+        memFiles = file;
+    } else if (openFlags & O_TRUNC) {
+        pthread_mutex_lock(&file->lock);
+        shrinkMemFile(file, 0);
+        pthread_mutex_unlock(&file->lock);
+    }
+    file->openCount++;
+    pthread_mutex_unlock(&memFilesLock);
+
+    handle->base.backend = &memoryBackend;
+    handle->file = file;
+    return &handle->base;
+}
+
+static int memClose(SM_BackendFile *handle) {
+    MemFile *file = memFileOf(handle);
+    pthread_mutex_lock(&memFilesLock);
+    int release = (--file->openCount == 0 && file->unlinked);
+    pthread_mutex_unlock(&memFilesLock);
+    if (release) {
+        freeMemFile(file);
+    }
+    free(handle);
+    return 0;
+}
+
+static int memUnlink(const char *path) {
+    pthread_mutex_lock(&memFilesLock);
+    MemFile **link = &memFiles;
+    while (*link != NULL && strcmp((*link)->name, path) != 0) {
+        link = &(*link)->next;
+    }
+    MemFile *file = *link;
+    if (file == NULL) {
+        pthread_mutex_unlock(&memFilesLock);
+        errno = ENOENT;
+        return -1;
+    }
+    *link = file->next;
+    file->unlinked = 1;
+    int release = (file->openCount == 0);
+    pthread_mutex_unlock(&memFilesLock);
+    if (release) {
+        freeMemFile(file);
+    }
+    return 0;
+}
+
+static int memExists(const char *path) {
+    pthread_mutex_lock(&memFilesLock);
+    int exists = findMemFile(path) != NULL;
+    pthread_mutex_unlock(&memFilesLock);
+    return exists;
+}
+
+static ssize_t memPread(SM_BackendFile *handle, void *buffer, size_t length, off_t offset) {
+    MemFile *file = memFileOf(handle);
+    pthread_mutex_lock(&file->lock);
+    ssize_t result = memTransfer(file, (char *)buffer, length, offset, 0);
+    pthread_mutex_unlock(&file->lock);
+    return result;
+}
+
+static ssize_t memPwrite(SM_BackendFile *handle, const void *buffer, size_t length, off_t offset) {
+    MemFile *file = memFileOf(handle);
+    pthread_mutex_lock(&file->lock);
+    ssize_t result = memTransfer(file, (char *)buffer, length, offset, 1);
+    pthread_mutex_unlock(&file->lock);
+    return result;
+}
+
+// Vectored transfers hold the lock across all pieces, like preadv/pwritev
+static ssize_t memTransferv(SM_BackendFile *handle, const struct iovec *iov, int iovcnt, off_t offset,
+                            int isWrite) {
+    MemFile *file = memFileOf(handle);
+    ssize_t total = 0;
+    pthread_mutex_lock(&file->lock);
+    for (int i = 0; i < iovcnt; i++) {
+        ssize_t moved = memTransfer(file, (char *)iov[i].iov_base, iov[i].iov_len, offset + total, isWrite);
+        if (moved < 0) {
+            if (total == 0) {
+                total = -1;
+            }
+            break;
+        }
+        total += moved;
+        if ((size_t)moved < iov[i].iov_len) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&file->lock);
+    return total;
+}
+
+static ssize_t memPreadv(SM_BackendFile *handle, const struct iovec *iov, int iovcnt, off_t offset) {
+    return memTransferv(handle, iov, iovcnt, offset, 0);
+}
+
+static ssize_t memPwritev(SM_BackendFile *handle, const struct iovec *iov, int iovcnt, off_t offset) {
+    return memTransferv(handle, iov, iovcnt, offset, 1);
+}
+
+static int memSize(SM_BackendFile *handle, off_t *size, off_t *allocated) {
+    MemFile *file = memFileOf(handle);
+    pthread_mutex_lock(&file->lock);
+    *size = file->size;
+    *allocated = 0;
+    for (size_t i = 0; i < file->numChunks; i++) {
+        if (file->chunks[i] != NULL) {
+            *allocated += MEM_CHUNK_SIZE;
+        }
+    }
+    pthread_mutex_unlock(&file->lock);
+    return 0;
+}
+
+static int memTruncate(SM_BackendFile *handle, off_t size) {
+    MemFile *file = memFileOf(handle);
+    if (size < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    pthread_mutex_lock(&file->lock);
+    int result = 0;
+    if (size < file->size) {
+        shrinkMemFile(file, size);
+    } else if ((result = growMemFile(file, size)) == 0) {
+        file->size = size;
+    }
+    pthread_mutex_unlock(&file->lock);
+    return result;
+}
+
+// Chunks are allocated on first write; reserving them ahead buys nothing
+static int memAllocate(SM_BackendFile *handle, off_t offset, off_t length) {
+    (void)handle;
+    (void)offset;
+    (void)length;
+    errno = EOPNOTSUPP;
+    return -1;
+}
+
+static int memSync(SM_BackendFile *handle) {
+    (void)handle;
+    return 0;
+}
+
+static int memAdvise(SM_BackendFile *handle, off_t offset, off_t length, int advice) {
+    (void)handle;
+    (void)offset;
+    (void)length;
+    (void)advice;
+    return 0;
+}
+
+static int memDescriptor(SM_BackendFile *handle) {
+    (void)handle;
+    return -1;
+}
+
+const SM_Backend memoryBackend = {
+    MEM_PREFIX,
+    memOpen,
+    memClose,
+    memUnlink,
+    memExists,
+    memPread,
+    memPwrite,
+    memPreadv,
+    memPwritev,
+    memSize,
+    memTruncate,
+    memAllocate,
+    memSync,
+    memAdvise,
+    memDescriptor,
+};
@@ -1,219 +1,2594 @@
-#include "storage_mgr.h"
-#include "dberror.h"
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <fcntl.h>
-#include <sys/stat.h>
-#include <unistd.h>
-#include <stdint.h>
-#define _POSIX_C_SOURCE 200809L
-
-#define FILE_PERMISSIONS S_IRUSR | S_IWUSR
-
-// Initializes the storage system
-void initStorageManager(void) {
-    printf("Storage Manager initialized successfully.\n");
-    printf("Ready to manage page files and handle operations.\n");
-}
-
-// Helper function to check if a file path is valid
-static RC validateFilePath(const char *filePath) {
-    if (filePath == NULL) {
-        printf("Error: Invalid file path.\n");
-        return RC_FILE_NOT_FOUND;
-    }
-    return RC_OK;
-}
-
-// Helper function to check if a file exists
-static int fileExists(const char *filePath) {
-    return access(filePath, F_OK) == 0;
-}
-
-// Helper function to delete a file from storage
-static RC deleteFile(const char *filePath) {
-    if (unlink(filePath) == 0) {
-        return RC_OK;
-    } else {
-        perror("Error deleting file");
-        return RC_FILE_NOT_FOUND;
-    }
-}
-
-// Logs file operations for debugging
-static void logFileOperation(const char *operation, const char *filePath) {
-    printf("LOG: %s operation performed on file: %s\n", operation, filePath);
-}
-
-// Deletes a file from storage with additional helper functions
-RC destroyPageFile(char *filePath) {
-    // Validate file path
-    if (validateFilePath(filePath) != RC_OK) {
-        return RC_FILE_NOT_FOUND;
-    }
-    
-    // Log operation
-    logFileOperation("DELETE", filePath);
-    
-    // Check if file exists before deletion
-    if (!fileExists(filePath)) {
-        printf("Error: File does not exist.\n");
-        return RC_FILE_NOT_FOUND;
-    }
-    
-    // Attempt to delete the file
-    return deleteFile(filePath);
-}
-
-// Creates a new page file and initializes it with an empty page
-RC createPageFile(char *filePath) {
-    if (validateFilePath(filePath) != RC_OK) {
-        return RC_FILE_NOT_FOUND;
-    }
-    logFileOperation("CREATE", filePath);
-
-    int fd = open(filePath, O_RDWR | O_CREAT | O_TRUNC, FILE_PERMISSIONS);
-    if (fd == -1) {
-        perror("Error creating file");
-        return RC_FILE_NOT_FOUND;
-    }
-
-    SM_PageHandle emptyBuffer = (SM_PageHandle)malloc(PAGE_SIZE);
-    if (!emptyBuffer) {
-        close(fd);
-        printf("Error: Memory allocation failed.\n");
-        return RC_WRITE_FAILED;
-    }
-
-    memset(emptyBuffer, '\0', PAGE_SIZE);
-    ssize_t bytesWritten = write(fd, emptyBuffer, PAGE_SIZE);
-    free(emptyBuffer);
-    close(fd);
-
-    return (bytesWritten == PAGE_SIZE) ? RC_OK : RC_WRITE_FAILED;
-}
-
-// Opens an existing file and sets up the file handle
-RC openPageFile(char *filePath, SM_FileHandle *fileHandle) {
-    if (validateFilePath(filePath) != RC_OK || fileHandle == NULL) {
-        return RC_FILE_NOT_FOUND;
-    }
-    logFileOperation("OPEN", filePath);
-
-    int fd = open(filePath, O_RDWR);
-    if (fd == -1) {
-        perror("Error opening file");
-        return RC_FILE_NOT_FOUND;
-    }
-
-    struct stat fileStats;
-    if (fstat(fd, &fileStats) != 0) {
-        close(fd);
-        printf("Error: Unable to retrieve file information.\n");
-        return RC_FILE_NOT_FOUND;
-    }
-
-    fileHandle->totalNumPages = fileStats.st_size / PAGE_SIZE;
-    fileHandle->curPagePos = 0;
-    fileHandle->fileName = strdup(filePath);
-    fileHandle->mgmtInfo = (void *)(intptr_t)fd;
-    return RC_OK;
-}
-
-// Closes an open file and releases resources
-RC closePageFile(SM_FileHandle *fileHandle) {
-    if (!fileHandle || !fileHandle->mgmtInfo) {
-        printf("Error: File handle is not initialized.\n");
-        return RC_FILE_HANDLE_NOT_INIT;
-    }
-    logFileOperation("CLOSE", fileHandle->fileName);
-
-    close((int)(intptr_t)fileHandle->mgmtInfo);
-    free(fileHandle->fileName);
-    fileHandle->mgmtInfo = NULL;
-    return RC_OK;
-}
-
-// Reads a specific page into memory
-RC readBlock(int pageIndex, SM_FileHandle *fileHandle, SM_PageHandle buffer) {
-    if (!fileHandle || !buffer || pageIndex < 0 || pageIndex >= fileHandle->totalNumPages) {
-        printf("Error: Invalid parameters for reading block.\n");
-        return RC_READ_NON_EXISTING_PAGE;
-    }
-    logFileOperation("READ", fileHandle->fileName);
-
-    int fd = (int)(intptr_t)fileHandle->mgmtInfo;
-    off_t seekPos = lseek(fd, pageIndex * PAGE_SIZE, SEEK_SET);
-    if (seekPos == -1) {
-        perror("Error seeking file");
-        return RC_READ_NON_EXISTING_PAGE;
-    }
-
-    ssize_t bytesRead = read(fd, buffer, PAGE_SIZE);
-    return (bytesRead == PAGE_SIZE) ? RC_OK : RC_READ_NON_EXISTING_PAGE;
-}
-
-// Reads the first block of a file
-RC readFirstBlock(SM_FileHandle *fileHandle, SM_PageHandle buffer) {
-    return readBlock(0, fileHandle, buffer);
-}
-
-// Writes a page to a specific block
-RC writeBlock(int pageIndex, SM_FileHandle *fileHandle, SM_PageHandle buffer) {
-    if (!fileHandle || !buffer || pageIndex < 0 || pageIndex >= fileHandle->totalNumPages) {
-        printf("Error: Invalid parameters for writing block.\n");
-        return RC_WRITE_FAILED;
-    }
-    logFileOperation("WRITE", fileHandle->fileName);
-
-    int fd = (int)(intptr_t)fileHandle->mgmtInfo;
-    if (lseek(fd, pageIndex * PAGE_SIZE, SEEK_SET) == -1) {
-        perror("Error seeking file");
-        return RC_WRITE_FAILED;
-    }
-    ssize_t bytesWritten = write(fd, buffer, PAGE_SIZE);
-
-    return (bytesWritten == PAGE_SIZE) ? RC_OK : RC_WRITE_FAILED;
-}
-
-// Writes to the first block of a file
-RC writeFirstBlock(SM_FileHandle *fileHandle, SM_PageHandle buffer) {
-    return writeBlock(0, fileHandle, buffer);
-}
-
-// Writes to the current block of a file
-RC writeCurrentBlock(SM_FileHandle *fileHandle, SM_PageHandle buffer) {
-    return writeBlock(fileHandle->curPagePos, fileHandle, buffer);
-}
-
-// Ensures a file contains at least the specified number of pages
-RC ensureCapacity(int requiredPages, SM_FileHandle *fileHandle) {
-    if (!fileHandle) {
-        printf("Error: Invalid file handle.\n");
-        return RC_FILE_HANDLE_NOT_INIT;
-    }
-
-    int additionalPagesNeeded = requiredPages - fileHandle->totalNumPages;
-    while (additionalPagesNeeded > 0) {
-        SM_PageHandle emptyPage = (SM_PageHandle)malloc(PAGE_SIZE);
-        if (!emptyPage) {
-            printf("Error: Memory allocation failed while ensuring capacity.\n");
-            return RC_WRITE_FAILED;
-        }
-        memset(emptyPage, '\0', PAGE_SIZE);
-        int fd = (int)(intptr_t)fileHandle->mgmtInfo;
-        lseek(fd, 0, SEEK_END);
-
-        ssize_t bytesWritten = write(fd, emptyPage, PAGE_SIZE);
-        free(emptyPage);
-
-        if (bytesWritten != PAGE_SIZE) {
-            printf("Error: Could not append new page.\n");
-            return RC_WRITE_FAILED;
-        }
-        fileHandle->totalNumPages++;
-        additionalPagesNeeded--;
-    }
-    return RC_OK;
-}
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+
+#include "storage_mgr.h"
+#include "dberror.h"
+#include "trace.h"
+#include "checksum.h"
+#include "compress.h"
+#include "storage_backend.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/sendfile.h>
+
+#define FILE_PERMISSIONS S_IRUSR | S_IWUSR
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+// On-disk header kept in the first page of every page file; files written
+// before the header existed have no magic and are opened header-less
+#define SM_HEADER_MAGIC "DBPGFILE"
+#define SM_HEADER_VERSION 1
+
+typedef struct SM_FileHeader {
+    char magic[8];          // SM_HEADER_MAGIC
+    uint32_t version;       // SM_HEADER_VERSION
+    uint32_t formatFlags;   // SM_FILE_* flags chosen at creation
+    uint64_t numPages;      // logical pages (SM_FILE_COMPRESSED and SM_FILE_STRIPED only)
+    uint64_t mapOffset;     // where the page map was last stored
+    uint32_t mapValid;      // 0: the stored map was overwritten (older versions only)
+    uint32_t freeMapPages;  // pages covered by the free-page bitmap (0 for older files)
+    uint32_t stripeCount;   // stripe files listed in logical page 0 (SM_FILE_STRIPED only)
+    uint32_t stripeExtentPages; // consecutive pages kept together on one stripe
+    uint32_t pageSize;      // bytes per page (0 for files from before page sizes varied)
+} SM_FileHeader;
+
+// The header page is as large as a data page, but only its first
+// SM_MIN_PAGE_SIZE bytes are used. After the fields above they hold a bitmap
+// with one bit per data page, set while the page is allocated; pages past its
+// coverage are always allocated
+#define SM_FREE_MAP_OFFSET 64
+#define SM_FREE_MAP_BYTES (SM_MIN_PAGE_SIZE - SM_FREE_MAP_OFFSET)
+#define SM_FREE_MAP_PAGES (SM_FREE_MAP_BYTES * 8)
+
+// Compressed files store each page in a slot of whole sectors after the
+// header; the page map, kept in memory and saved at close, locates them.
+// Slots the saved map points to are never overwritten: a page rewritten
+// since the save gets a new slot, and the old one (and the old map) is only
+// reused once the next map is durable, so a crash leaves the saved state
+#define SM_SECTOR_SIZE 512
+
+typedef struct SM_PageMapEntry {
+    uint64_t offset;    // byte offset of the slot (0: never written, reads as zeros)
+    uint32_t length;    // stored length, the page size when kept uncompressed
+    uint32_t capacity;  // bytes reserved for the slot
+} SM_PageMapEntry;
+
+typedef struct SM_FreeSlot {
+    uint64_t offset;
+    uint64_t length;
+} SM_FreeSlot;
+
+// Byte ranges of a compressed file, sorted by offset with neighbours merged
+typedef struct SM_SlotList {
+    SM_FreeSlot *slots;
+    int count;
+    int capacity;
+} SM_SlotList;
+
+// Per-handle bookkeeping stored behind SM_FileHandle->mgmtInfo
+typedef struct SM_FileMgmtInfo {
+    SM_BackendFile *file; // the open page file in its backend
+    struct SM_CachedFile *cached; // file cache entry holding it
+    int flags;          // SM_OPEN_* flags the file was opened with
+    SM_FileHeader header; // copy of the file header (zeroed for old files)
+    int headerPages;    // pages in front of logical page 0 (0 for old files)
+    int pageSize;       // bytes per page
+    char *map;          // base of the shared mapping (SM_OPEN_MMAP only)
+    size_t mapSize;     // number of bytes currently mapped
+    PageNumber allocatedPages; // pages with disk space reserved; sparse ranges do not count
+    PageNumber extentEnd; // end of the reserved extents or of the last range left sparse
+    int nextExtentPages; // size of the next preallocation extent
+    SM_PageMapEntry *pageMap; // slot of every page (SM_FILE_COMPRESSED only)
+    PageNumber pageMapCapacity; // entries allocated in pageMap
+    off_t appendOffset;       // where the next new slot goes when no free one fits
+    SM_SlotList freeSlots;    // space no saved map refers to, reused for new slots
+    SM_SlotList retiredSlots; // slots replaced since the map was saved; free once a new one is
+    unsigned char *freshSlots; // per page: slot taken since the map was saved
+    int pageMapDirty;         // slots changed since the map was saved
+    char *codecBuffer;        // compressed image of one page
+    unsigned char freeMap[SM_FREE_MAP_BYTES]; // copy of the header page bitmap
+    int freeMapDirty;         // bitmap changed since the header was written
+    PageNumber nextFitPage;   // where allocatePage resumes its search
+    SM_FileHandle *stripes;   // open stripe files (SM_FILE_STRIPED only)
+    SM_DurabilityMode durability; // when writes are forced to the device
+    int maxSyncWaitMicros;    // how long a group commit waits for others to join
+    pthread_mutex_t handleLock; // recursive; guards the page count, free-page bitmap,
+                                // page map, position and read-ahead counters
+    pthread_mutex_t syncLock; // guards the group commit state below
+    pthread_cond_t syncDone;  // signalled when a group commit finishes
+    long syncRequested;       // tickets handed to syncPageFile callers
+    long syncCompleted;       // highest ticket known to be durable
+    int syncInProgress;       // a leader is running fdatasync
+    RC syncError;             // sticky: once a sync failed, durability is unknown
+    atomic_long syncCount;    // fdatasync calls issued on this handle
+    PageNumber nextSequentialPage; // page that would continue the current run
+    int sequentialRun;        // pages read in order so far
+    int randomRun;            // reads in a row that did not continue a run
+    int adviseRandom;         // FADV_RANDOM is in effect
+    PageNumber readAheadStart; // pages [readAheadStart, readAheadEnd) were advised
+    PageNumber readAheadEnd;
+    SM_ReadAheadStats readAhead; // counters reported by getReadAheadStats
+} SM_FileMgmtInfo;
+
+// A run of SM_SEQUENTIAL_TRIGGER pages read in order starts read-ahead of
+// about SM_READAHEAD_BYTES; SM_RANDOM_TRIGGER unrelated reads in a row turn
+// off the kernel's own read-ahead
+#define SM_SEQUENTIAL_TRIGGER 4
+#define SM_RANDOM_TRIGGER 8
+#define SM_READAHEAD_BYTES (256 * 1024)
+
+// Geometric extent growth: 64 KB first, doubling up to 64 MB per extent
+static SM_ExtentPolicy extentPolicy = { 16, 16384, 2 };
+
+// Backends selected by file name prefix; names matching none of them are
+// POSIX files. Registration is meant for program start-up and is not locked
+#define SM_MAX_BACKENDS 8
+static const SM_Backend *backends[SM_MAX_BACKENDS] = { &memoryBackend, &slowBackend };
+static int numBackends = 2;
+
+// Makes a backend available under its prefix
+int registerStorageBackend(const SM_Backend *backend) {
+    if (backend == NULL || backend->prefix == NULL || backend->prefix[0] == '\0' ||
+        numBackends == SM_MAX_BACKENDS) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, numBackends, __LINE__);
+        return -1;
+    }
+    for (int i = 0; i < numBackends; i++) {
+        if (backends[i] == backend) {
+            return 0;
+        }
+    }
+    backends[numBackends++] = backend;
+    return 0;
+}
+
+// Returns the backend that serves a file name
+const SM_Backend *storageBackendFor(const char *path) {
+    for (int i = 0; i < numBackends; i++) {
+        if (strncmp(path, backends[i]->prefix, strlen(backends[i]->prefix)) == 0) {
+            return backends[i];
+        }
+    }
+    return &posixBackend;
+}
+
+// Open files are shared through a cache keyed by path and open mode.
+// closePageFile only drops a reference; unreferenced files stay open on an
+// LRU list until the number of open files passes the limit, so reopening a
+// hot file needs no open(2)
+#define SM_FILE_CACHE_BUCKETS 256
+
+// A running backupPageFile: writes to the file mark the blocks they touch so
+// that the copy can fetch them again
+#define SM_BACKUP_BLOCK_SIZE SM_MIN_PAGE_SIZE
+
+typedef struct SM_Backup {
+    char *path;
+    pthread_mutex_t lock;       // guards the fields below
+    uint8_t *dirty;             // one bit per SM_BACKUP_BLOCK_SIZE bytes of the file
+    size_t numBlocks;           // blocks the bitmap covers
+    long numDirty;              // bits set
+    struct SM_Backup *next;
+} SM_Backup;
+
+typedef struct SM_CachedFile {
+    char *path;
+    int openMode;               // O_* flags the file was opened with
+    SM_BackendFile *file;
+    int refCount;               // handles using the file
+    int detached;               // no longer reachable by path (file destroyed)
+    pthread_rwlock_t writeLock; // shared by writers, exclusive while a backup finishes
+    SM_Backup *backup;          // running backup of the file (read under writeLock)
+    struct SM_CachedFile *hashNext;
+    struct SM_CachedFile *lruPrev; // idle list, newest first, while refCount is 0
+    struct SM_CachedFile *lruNext;
+} SM_CachedFile;
+
+static pthread_mutex_t fileCacheLock = PTHREAD_MUTEX_INITIALIZER;
+static SM_CachedFile *fileCache[SM_FILE_CACHE_BUCKETS];
+static SM_CachedFile *idleNewest = NULL;
+static SM_CachedFile *idleOldest = NULL;
+static int fileCacheLimit = SM_DEFAULT_FILE_CACHE_LIMIT;
+static SM_FileCacheStats fileCacheStats;
+static SM_Backup *activeBackups = NULL;
+
+// FNV-1a hash of a path
+static unsigned int pathBucket(const char *path) {
+    uint32_t hash = 2166136261u;
+    for (; *path; path++) {
+        hash = (hash ^ (unsigned char)*path) * 16777619u;
+    }
+    return hash % SM_FILE_CACHE_BUCKETS;
+}
+
+// The following helpers expect fileCacheLock to be held
+static void unlinkIdle(SM_CachedFile *entry) {
+    if (entry->lruPrev) {
+        entry->lruPrev->lruNext = entry->lruNext;
+    } else {
+        idleNewest = entry->lruNext;
+    }
+    if (entry->lruNext) {
+        entry->lruNext->lruPrev = entry->lruPrev;
+    } else {
+        idleOldest = entry->lruPrev;
+    }
+    entry->lruPrev = entry->lruNext = NULL;
+}
+
+static void unlinkHashed(SM_CachedFile *entry) {
+    SM_CachedFile **link = &fileCache[pathBucket(entry->path)];
+    while (*link != entry) {
+        link = &(*link)->hashNext;
+    }
+    *link = entry->hashNext;
+    entry->detached = 1;
+}
+
+static void closeCachedFile(SM_CachedFile *entry) {
+    entry->file->backend->close(entry->file);
+    pthread_rwlock_destroy(&entry->writeLock);
+    fileCacheStats.openFiles--;
+    free(entry->path);
+    free(entry);
+}
+
+// Closes idle files, oldest first, until the cache is within its limit
+static void trimFileCache(void) {
+    while (idleOldest != NULL && fileCacheStats.openFiles > fileCacheLimit) {
+        SM_CachedFile *entry = idleOldest;
+        unlinkIdle(entry);
+        unlinkHashed(entry);
+        fileCacheStats.evictions++;
+        closeCachedFile(entry);
+    }
+}
+
+// Returns the open file for a path, opening it on a miss; NULL with errno set
+static SM_CachedFile *acquireFile(const char *path, int openMode) {
+    pthread_mutex_lock(&fileCacheLock);
+    unsigned int bucket = pathBucket(path);
+    for (SM_CachedFile *entry = fileCache[bucket]; entry != NULL; entry = entry->hashNext) {
+        if (entry->openMode == openMode && strcmp(entry->path, path) == 0) {
+            if (entry->refCount++ == 0) {
+                unlinkIdle(entry);
+            }
+            fileCacheStats.hits++;
+            pthread_mutex_unlock(&fileCacheLock);
+            return entry;
+        }
+    }
+    fileCacheStats.misses++;
+    pthread_mutex_unlock(&fileCacheLock);
+
+    // opened outside the lock; a racing open of the same path just adds a second entry
+    SM_CachedFile *entry = (SM_CachedFile *)calloc(1, sizeof(SM_CachedFile));
+    if (entry) {
+        entry->path = strdup(path);
+    }
+    if (!entry || !entry->path) {
+        free(entry);
+        errno = ENOMEM;
+        return NULL;
+    }
+    entry->file = storageBackendFor(path)->open(path, openMode, 0);
+    if (entry->file == NULL) {
+        int savedErrno = errno;
+        free(entry->path);
+        free(entry);
+        errno = savedErrno;
+        return NULL;
+    }
+    entry->openMode = openMode;
+    entry->refCount = 1;
+    pthread_rwlock_init(&entry->writeLock, NULL);
+
+    pthread_mutex_lock(&fileCacheLock);
+    // files opened while a backup runs are tracked from their first write
+    for (SM_Backup *backup = activeBackups; backup != NULL; backup = backup->next) {
+        if (strcmp(backup->path, path) == 0) {
+            entry->backup = backup;
+        }
+    }
+    entry->hashNext = fileCache[bucket];
+    fileCache[bucket] = entry;
+    fileCacheStats.openFiles++;
+    trimFileCache();
+    pthread_mutex_unlock(&fileCacheLock);
+    return entry;
+}
+
+// Drops a handle's reference; the file stays open for reuse while it fits
+static void releaseFile(SM_CachedFile *entry) {
+    pthread_mutex_lock(&fileCacheLock);
+    if (--entry->refCount == 0) {
+        if (entry->detached) {
+            closeCachedFile(entry);
+        } else {
+            entry->lruNext = idleNewest;
+            if (idleNewest) {
+                idleNewest->lruPrev = entry;
+            } else {
+                idleOldest = entry;
+            }
+            idleNewest = entry;
+            trimFileCache();
+        }
+    }
+    pthread_mutex_unlock(&fileCacheLock);
+}
+
+// Makes every cached file of a path unreachable before the path is deleted;
+// idle ones are closed, ones in use close with their last handle
+static void forgetFile(const char *path) {
+    pthread_mutex_lock(&fileCacheLock);
+    SM_CachedFile *entry = fileCache[pathBucket(path)];
+    while (entry != NULL) {
+        SM_CachedFile *next = entry->hashNext;
+        if (strcmp(entry->path, path) == 0) {
+            unlinkHashed(entry);
+            if (entry->refCount == 0) {
+                unlinkIdle(entry);
+                closeCachedFile(entry);
+            }
+        }
+        entry = next;
+    }
+    pthread_mutex_unlock(&fileCacheLock);
+}
+
+// Sets how many files the cache may keep open (0 closes files with their last handle)
+RC setFileCacheLimit(int maxOpenFiles) {
+    if (maxOpenFiles < 0) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, maxOpenFiles, __LINE__);
+        return RC_INVALID_ARGUMENT;
+    }
+    pthread_mutex_lock(&fileCacheLock);
+    fileCacheLimit = maxOpenFiles;
+    trimFileCache();
+    pthread_mutex_unlock(&fileCacheLock);
+    return RC_OK;
+}
+
+// Returns the file cache counters
+void getFileCacheStats(SM_FileCacheStats *stats) {
+    pthread_mutex_lock(&fileCacheLock);
+    *stats = fileCacheStats;
+    pthread_mutex_unlock(&fileCacheLock);
+}
+
+// Sets the dirty bits of the blocks in [offset, end) (end -1: every block the
+// bitmap covers from offset on), growing the bitmap as needed
+static void markBackupRange(SM_Backup *backup, off_t offset, off_t end) {
+    pthread_mutex_lock(&backup->lock);
+    size_t first = offset / SM_BACKUP_BLOCK_SIZE;
+    size_t last = (end < 0) ? backup->numBlocks : (end + SM_BACKUP_BLOCK_SIZE - 1) / SM_BACKUP_BLOCK_SIZE;
+    if (last > backup->numBlocks) {
+        size_t numBlocks = backup->numBlocks ? backup->numBlocks : 64;
+        while (numBlocks < last) {
+            numBlocks *= 2;
+        }
+        uint8_t *dirty = (uint8_t *)realloc(backup->dirty, numBlocks / 8);
+        if (!dirty) {
+            TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_OUT_OF_MEMORY, 0, __LINE__);
+            last = backup->numBlocks;
+        } else {
+            memset(dirty + backup->numBlocks / 8, 0, (numBlocks - backup->numBlocks) / 8);
+            backup->dirty = dirty;
+            backup->numBlocks = numBlocks;
+        }
+    }
+    for (size_t block = first; block < last; block++) {
+        uint8_t bit = (uint8_t)(1 << (block % 8));
+        if (!(backup->dirty[block / 8] & bit)) {
+            backup->dirty[block / 8] |= bit;
+            backup->numDirty++;
+        }
+    }
+    pthread_mutex_unlock(&backup->lock);
+}
+
+// Writers hold the cached file's write lock shared from the write until the
+// range is marked for a running backup, so a backup finishing under the
+// exclusive lock sees every completed write
+static void beginWrite(SM_FileMgmtInfo *info) {
+    if (info->cached != NULL) {
+        pthread_rwlock_rdlock(&info->cached->writeLock);
+    }
+}
+
+static void endWrite(SM_FileMgmtInfo *info, off_t offset, off_t end) {
+    if (info->cached != NULL) {
+        if (info->cached->backup != NULL) {
+            markBackupRange(info->cached->backup, offset, end);
+        }
+        pthread_rwlock_unlock(&info->cached->writeLock);
+    }
+}
+
+// pwrite to the page file
+static ssize_t writeFileRange(SM_FileMgmtInfo *info, const void *buffer, size_t length, off_t offset) {
+    beginWrite(info);
+    ssize_t written = info->file->backend->pwrite(info->file, buffer, length, offset);
+    endWrite(info, offset, offset + (off_t)length);
+    return written;
+}
+
+// pwritev to the page file
+static ssize_t writeFileVector(SM_FileMgmtInfo *info, const struct iovec *iov, int iovcnt, off_t offset) {
+    size_t length = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        length += iov[i].iov_len;
+    }
+    beginWrite(info);
+    ssize_t written = info->file->backend->pwritev(info->file, iov, iovcnt, offset);
+    endWrite(info, offset, offset + (off_t)length);
+    return written;
+}
+
+// ftruncate of the page file; everything past the new end may change
+static int truncateFile(SM_FileMgmtInfo *info, off_t size) {
+    beginWrite(info);
+    int result = info->file->backend->truncate(info->file, size);
+    endWrite(info, size, -1);
+    return result;
+}
+
+// Stores a page through the shared mapping
+static void writeMappedPage(SM_FileMgmtInfo *info, off_t offset, const char *buffer) {
+    beginWrite(info);
+    memcpy(info->map + offset, buffer, info->pageSize);
+    endWrite(info, offset, offset + info->pageSize);
+}
+
+// Initializes the storage system
+void initStorageManager(void) {
+    TRACE(TRACE_INFO, TRACE_CAT_STORAGE, TE_SM_INIT, 0, 0);
+}
+
+// Helper function to check if a file path is valid
+static RC validateFilePath(const char *filePath) {
+    if (filePath == NULL) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, 0, __LINE__);
+        return RC_FILE_NOT_FOUND;
+    }
+    return RC_OK;
+}
+
+// Helper function to check if a file exists
+static int fileExists(const char *filePath) {
+    return storageBackendFor(filePath)->exists(filePath);
+}
+
+// Helper function to delete a file from storage
+static RC deleteFile(const char *filePath) {
+    forgetFile(filePath);
+    if (storageBackendFor(filePath)->unlink(filePath) == 0) {
+        return RC_OK;
+    } else {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+        return RC_FILE_NOT_FOUND;
+    }
+}
+
+// Returns the management info of an open handle
+static SM_FileMgmtInfo *getMgmtInfo(SM_FileHandle *fileHandle) {
+    return (SM_FileMgmtInfo *)fileHandle->mgmtInfo;
+}
+
+// Byte offset of a logical page inside the page file
+static off_t pageOffset(SM_FileMgmtInfo *info, PageNumber pageIndex) {
+    return (off_t)(pageIndex + info->headerPages) * info->pageSize;
+}
+
+// Stores the page checksum in the trailer of a page about to be written
+static void stampChecksum(SM_FileMgmtInfo *info, SM_PageHandle page) {
+    if (info->header.formatFlags & SM_FILE_CHECKSUM) {
+        uint32_t crc = crc32c(page, info->pageSize - PAGE_CHECKSUM_SIZE);
+        memcpy(page + info->pageSize - PAGE_CHECKSUM_SIZE, &crc, PAGE_CHECKSUM_SIZE);
+    }
+}
+
+// Compares the trailer of a page just read with its content
+static RC verifyChecksum(SM_FileMgmtInfo *info, PageNumber pageIndex, const char *page) {
+    if (!(info->header.formatFlags & SM_FILE_CHECKSUM)) {
+        return RC_OK;
+    }
+
+    uint32_t stored;
+    memcpy(&stored, page + info->pageSize - PAGE_CHECKSUM_SIZE, PAGE_CHECKSUM_SIZE);
+    if (stored == crc32c(page, info->pageSize - PAGE_CHECKSUM_SIZE)) {
+        return RC_OK;
+    }
+
+    // pages created by ensureCapacity were never written and are all zero
+    if (stored == 0) {
+        int i = 0;
+        while (i < info->pageSize && page[i] == 0) {
+            i++;
+        }
+        if (i == info->pageSize) {
+            return RC_OK;
+        }
+    }
+    TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_CHECKSUM, pageIndex, __LINE__);
+    return RC_CHECKSUM_MISMATCH;
+}
+
+// Reads the file header, or recognizes a header-less file
+static RC readFileHeader(SM_FileMgmtInfo *info, off_t fileSize) {
+    info->headerPages = 0;
+    info->pageSize = PAGE_SIZE;
+    memset(&info->header, 0, sizeof(info->header));
+    if (fileSize < SM_MIN_PAGE_SIZE) {
+        return RC_OK;
+    }
+
+    // an aligned buffer keeps this read legal on O_DIRECT descriptors
+    void *page = NULL;
+    if (posix_memalign(&page, SM_DIRECT_IO_ALIGNMENT, SM_MIN_PAGE_SIZE) != 0) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_OUT_OF_MEMORY, 0, __LINE__);
+        return RC_FILE_NOT_FOUND;
+    }
+    if (info->file->backend->pread(info->file, page, SM_MIN_PAGE_SIZE, 0) != SM_MIN_PAGE_SIZE) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+        free(page);
+        return RC_FILE_NOT_FOUND;
+    }
+
+    SM_FileHeader header;
+    memcpy(&header, page, sizeof(header));
+    if (memcmp(header.magic, SM_HEADER_MAGIC, sizeof(header.magic)) == 0) {
+        if (header.version != SM_HEADER_VERSION) {
+            TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_BAD_HEADER, header.version, __LINE__);
+            free(page);
+            return RC_BAD_FILE_HEADER;
+        }
+        if (header.pageSize != 0 && (header.pageSize < SM_MIN_PAGE_SIZE || header.pageSize > SM_MAX_PAGE_SIZE ||
+                                     (header.pageSize & (header.pageSize - 1)) != 0)) {
+            TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_BAD_HEADER, header.pageSize, __LINE__);
+            free(page);
+            return RC_BAD_FILE_HEADER;
+        }
+        info->headerPages = 1;
+        info->header = header;
+        if (header.pageSize != 0) {
+            info->pageSize = (int)header.pageSize;
+        }
+        memcpy(info->freeMap, (char *)page + SM_FREE_MAP_OFFSET, SM_FREE_MAP_BYTES);
+    }
+    free(page);
+    return RC_OK;
+}
+
+// Writes the in-memory header back to the first page of the file
+static RC writeFileHeader(SM_FileMgmtInfo *info) {
+    void *page = NULL;
+    if (posix_memalign(&page, SM_DIRECT_IO_ALIGNMENT, SM_MIN_PAGE_SIZE) != 0) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_OUT_OF_MEMORY, 0, __LINE__);
+        return RC_WRITE_FAILED;
+    }
+    memset(page, 0, SM_MIN_PAGE_SIZE);
+    memcpy(page, &info->header, sizeof(info->header));
+    memcpy((char *)page + SM_FREE_MAP_OFFSET, info->freeMap, SM_FREE_MAP_BYTES);
+    ssize_t bytesWritten = writeFileRange(info, page, SM_MIN_PAGE_SIZE, 0);
+    free(page);
+    if (bytesWritten != SM_MIN_PAGE_SIZE) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+        return RC_WRITE_FAILED;
+    }
+    info->freeMapDirty = 0;
+    return RC_OK;
+}
+
+// Tests the free-page bitmap; pages it does not cover count as allocated
+static int pageInUse(SM_FileMgmtInfo *info, PageNumber pageIndex) {
+    if (pageIndex >= (PageNumber)info->header.freeMapPages) {
+        return 1;
+    }
+    return (info->freeMap[pageIndex / 8] >> (pageIndex % 8)) & 1;
+}
+
+// Marks the pages in [first, last) allocated or free in the bitmap
+static void markPages(SM_FileMgmtInfo *info, PageNumber first, PageNumber last, int inUse) {
+    if (last > (PageNumber)info->header.freeMapPages) {
+        last = (PageNumber)info->header.freeMapPages;
+    }
+    for (PageNumber i = first; i < last; i++) {
+        if (inUse) {
+            info->freeMap[i / 8] |= (unsigned char)(1 << (i % 8));
+        } else {
+            info->freeMap[i / 8] &= (unsigned char)~(1 << (i % 8));
+        }
+        info->freeMapDirty = 1;
+    }
+}
+
+// Gives files written before the bitmap existed one that marks every page in use
+static void initFreeMap(SM_FileMgmtInfo *info, PageNumber totalNumPages) {
+    if (info->headerPages == 0 || info->header.freeMapPages != 0) {
+        return;
+    }
+    memset(info->freeMap, 0, SM_FREE_MAP_BYTES);
+    info->header.freeMapPages = SM_FREE_MAP_PAGES;
+    markPages(info, 0, totalNumPages, 1);
+}
+
+// Rounds a byte count up to whole sectors
+static off_t sectorRound(off_t bytes) {
+    return (bytes + SM_SECTOR_SIZE - 1) / SM_SECTOR_SIZE * SM_SECTOR_SIZE;
+}
+
+// fdatasync of the page file, counted in syncCount
+static int syncFileData(SM_FileMgmtInfo *info) {
+    atomic_fetch_add_explicit(&info->syncCount, 1, memory_order_relaxed);
+    return info->file->backend->sync(info->file);
+}
+
+// Adds [offset, offset + length) to a list, merging it with the ranges it touches
+static RC addSlot(SM_SlotList *list, uint64_t offset, uint64_t length) {
+    if (length == 0) {
+        return RC_OK;
+    }
+    int low = 0;
+    int high = list->count;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (list->slots[mid].offset < offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    SM_FreeSlot *next = &list->slots[low];
+    int joinsPrevious = low > 0 && next[-1].offset + next[-1].length == offset;
+    int joinsNext = low < list->count && offset + length == next->offset;
+    if (joinsPrevious && joinsNext) {
+        next[-1].length += length + next->length;
+        memmove(next, next + 1, sizeof(SM_FreeSlot) * (list->count - low - 1));
+        list->count--;
+        return RC_OK;
+    }
+    if (joinsPrevious) {
+        next[-1].length += length;
+        return RC_OK;
+    }
+    if (joinsNext) {
+        next->offset = offset;
+        next->length += length;
+        return RC_OK;
+    }
+
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 16;
+        SM_FreeSlot *slots = (SM_FreeSlot *)realloc(list->slots, sizeof(SM_FreeSlot) * capacity);
+        if (!slots) {
+            TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_OUT_OF_MEMORY, 0, __LINE__);
+            return RC_WRITE_FAILED;
+        }
+        list->slots = slots;
+        list->capacity = capacity;
+        next = &list->slots[low];
+    }
+    memmove(next + 1, next, sizeof(SM_FreeSlot) * (list->count - low));
+    next->offset = offset;
+    next->length = length;
+    list->count++;
+    return RC_OK;
+}
+
+// Finds room for length bytes: the first free range large enough, or else
+// the end of the slots
+static off_t takeSlot(SM_FileMgmtInfo *info, uint64_t length) {
+    SM_SlotList *list = &info->freeSlots;
+    for (int i = 0; i < list->count; i++) {
+        if (list->slots[i].length >= length) {
+            off_t offset = (off_t)list->slots[i].offset;
+            list->slots[i].offset += length;
+            list->slots[i].length -= length;
+            if (list->slots[i].length == 0) {
+                memmove(&list->slots[i], &list->slots[i + 1], sizeof(SM_FreeSlot) * (list->count - i - 1));
+                list->count--;
+            }
+            return offset;
+        }
+    }
+    off_t offset = info->appendOffset;
+    info->appendOffset += length;
+    return offset;
+}
+
+// Gives free space at the end of the slots back to the file system
+static void trimFreeTail(SM_FileMgmtInfo *info) {
+    SM_SlotList *list = &info->freeSlots;
+    if (list->count == 0) {
+        return;
+    }
+    SM_FreeSlot *last = &list->slots[list->count - 1];
+    if (last->offset + last->length != (uint64_t)info->appendOffset) {
+        return;
+    }
+    // the space simply stays on the list when the file cannot shrink
+    if (truncateFile(info, (off_t)last->offset) == 0) {
+        info->appendOffset = (off_t)last->offset;
+        list->count--;
+    }
+}
+
+// Makes room for numPages entries in the page map; new entries read as zero pages
+static RC growPageMap(SM_FileMgmtInfo *info, PageNumber numPages) {
+    if (numPages <= info->pageMapCapacity) {
+        return RC_OK;
+    }
+    PageNumber capacity = info->pageMapCapacity ? info->pageMapCapacity : 16;
+    while (capacity < numPages) {
+        capacity *= 2;
+    }
+    SM_PageMapEntry *pageMap = (SM_PageMapEntry *)realloc(info->pageMap, sizeof(SM_PageMapEntry) * capacity);
+    if (!pageMap) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_OUT_OF_MEMORY, 0, __LINE__);
+        return RC_WRITE_FAILED;
+    }
+    info->pageMap = pageMap;
+    unsigned char *freshSlots = (unsigned char *)realloc(info->freshSlots, capacity);
+    if (!freshSlots) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_OUT_OF_MEMORY, 0, __LINE__);
+        return RC_WRITE_FAILED;
+    }
+    info->freshSlots = freshSlots;
+    memset(pageMap + info->pageMapCapacity, 0, sizeof(SM_PageMapEntry) * (capacity - info->pageMapCapacity));
+    memset(freshSlots + info->pageMapCapacity, 0, capacity - info->pageMapCapacity);
+    info->pageMapCapacity = capacity;
+    return RC_OK;
+}
+
+static int compareSlots(const void *a, const void *b) {
+    uint64_t left = ((const SM_FreeSlot *)a)->offset;
+    uint64_t right = ((const SM_FreeSlot *)b)->offset;
+    return (left > right) - (left < right);
+}
+
+// Lists the space between the header and the end of the slots that neither
+// the loaded map nor any of its slots use
+static RC findFreeSlots(SM_FileMgmtInfo *info) {
+    PageNumber numPages = (PageNumber)info->header.numPages;
+    SM_FreeSlot *used = (SM_FreeSlot *)malloc(sizeof(SM_FreeSlot) * (numPages + 1));
+    if (!used) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_OUT_OF_MEMORY, 0, __LINE__);
+        return RC_FILE_NOT_FOUND;
+    }
+    int numUsed = 0;
+    for (PageNumber i = 0; i < numPages; i++) {
+        if (info->pageMap[i].offset != 0) {
+            used[numUsed].offset = info->pageMap[i].offset;
+            used[numUsed].length = info->pageMap[i].capacity;
+            numUsed++;
+        }
+    }
+    used[numUsed].offset = info->header.mapOffset;
+    used[numUsed].length = sectorRound(sizeof(SM_PageMapEntry) * numPages);
+    numUsed++;
+    qsort(used, numUsed, sizeof(SM_FreeSlot), compareSlots);
+
+    uint64_t end = (uint64_t)info->headerPages * info->pageSize;
+    RC rc = RC_OK;
+    for (int i = 0; i < numUsed && rc == RC_OK; i++) {
+        if (used[i].offset > end) {
+            rc = addSlot(&info->freeSlots, end, used[i].offset - end);
+        }
+        if (used[i].offset + used[i].length > end) {
+            end = used[i].offset + used[i].length;
+        }
+    }
+    free(used);
+    info->appendOffset = (off_t)end;
+    return rc;
+}
+
+// Loads the page map of a compressed file
+static RC loadPageMap(SM_FileMgmtInfo *info) {
+    PageNumber numPages = (PageNumber)info->header.numPages;
+    if (!info->header.mapValid) {
+        // an older version rewrote the map in place and went away before saving it
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_BAD_HEADER, 0, __LINE__);
+        return RC_BAD_FILE_HEADER;
+    }
+    info->codecBuffer = (char *)malloc(info->pageSize);
+    if (!info->codecBuffer || growPageMap(info, numPages) != RC_OK) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_OUT_OF_MEMORY, 0, __LINE__);
+        return RC_FILE_NOT_FOUND;
+    }
+    size_t mapBytes = sizeof(SM_PageMapEntry) * numPages;
+    if (info->file->backend->pread(info->file, info->pageMap, mapBytes, info->header.mapOffset) != (ssize_t)mapBytes) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+        return RC_BAD_FILE_HEADER;
+    }
+    return findFreeSlots(info);
+}
+
+// Stores the page map in free space and, once it is durable, points the
+// header at it; only then do the previous map and the slots replaced since
+// it was saved become free
+static RC savePageMap(SM_FileMgmtInfo *info, PageNumber numPages) {
+    if (!info->pageMapDirty && info->header.numPages == (uint64_t)numPages) {
+        return RC_OK;
+    }
+    size_t mapBytes = sizeof(SM_PageMapEntry) * numPages;
+    uint64_t mapLength = sectorRound(mapBytes);
+    off_t mapOffset = takeSlot(info, mapLength);
+    if (writeFileRange(info, info->pageMap, mapBytes, mapOffset) != (ssize_t)mapBytes || syncFileData(info) != 0) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+        addSlot(&info->freeSlots, mapOffset, mapLength);
+        return RC_WRITE_FAILED;
+    }
+
+    uint64_t oldOffset = info->header.mapOffset;
+    uint64_t oldLength = sectorRound(sizeof(SM_PageMapEntry) * info->header.numPages);
+    info->header.numPages = numPages;
+    info->header.mapOffset = mapOffset;
+    info->header.mapValid = 1;
+    RC rc = writeFileHeader(info);
+    if (rc == RC_OK && syncFileData(info) != 0) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+        rc = RC_WRITE_FAILED;
+    }
+    if (rc != RC_OK) {
+        // the header on the device may name either map, so neither is reused
+        return rc;
+    }
+
+    // a range that cannot be listed is only lost until the file is opened again
+    addSlot(&info->freeSlots, oldOffset, oldLength);
+    for (int i = 0; i < info->retiredSlots.count; i++) {
+        addSlot(&info->freeSlots, info->retiredSlots.slots[i].offset, info->retiredSlots.slots[i].length);
+    }
+    info->retiredSlots.count = 0;
+    memset(info->freshSlots, 0, info->pageMapCapacity);
+    info->pageMapDirty = 0;
+    trimFreeTail(info);
+    return RC_OK;
+}
+
+// Reads and decompresses one page of a compressed file
+static RC readCompressedPage(SM_FileMgmtInfo *info, PageNumber pageIndex, SM_PageHandle buffer) {
+    SM_PageMapEntry *entry = &info->pageMap[pageIndex];
+    if (entry->offset == 0) {
+        memset(buffer, 0, info->pageSize);
+        return RC_OK;
+    }
+
+    char *target = (entry->length == (uint32_t)info->pageSize) ? buffer : info->codecBuffer;
+    if (info->file->backend->pread(info->file, target, entry->length, entry->offset) != (ssize_t)entry->length) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+    if (entry->length != (uint32_t)info->pageSize &&
+        pageDecompress(info->codecBuffer, entry->length, buffer, info->pageSize) != 0) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_CHECKSUM, pageIndex, __LINE__);
+        return RC_CHECKSUM_MISMATCH;
+    }
+    return RC_OK;
+}
+
+// Compresses one page and stores it. A page keeps its slot only if the slot
+// was taken since the map was saved and the page still fits; otherwise it
+// moves to a new one, and the old slot is freed or, if the saved map points
+// to it, retired until the next save
+static RC writeCompressedPage(SM_FileMgmtInfo *info, PageNumber pageIndex, SM_PageHandle buffer) {
+    SM_PageMapEntry *entry = &info->pageMap[pageIndex];
+    int length = pageCompress(buffer, info->pageSize, info->codecBuffer, info->pageSize);
+    const char *image = info->codecBuffer;
+    if (length == 0) {
+        length = info->pageSize;
+        image = buffer;
+    }
+
+    off_t offset = (off_t)entry->offset;
+    uint32_t capacity = entry->capacity;
+    int moved = entry->offset == 0 || !info->freshSlots[pageIndex] || capacity < (uint32_t)length;
+    if (moved) {
+        capacity = (uint32_t)sectorRound(length);
+        offset = takeSlot(info, capacity);
+    }
+    if (writeFileRange(info, image, length, offset) != length) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+        if (moved) {
+            addSlot(&info->freeSlots, offset, capacity);
+        }
+        return RC_WRITE_FAILED;
+    }
+    if (moved && entry->offset != 0) {
+        addSlot(info->freshSlots[pageIndex] ? &info->freeSlots : &info->retiredSlots, entry->offset, entry->capacity);
+    }
+    entry->offset = (uint64_t)offset;
+    entry->capacity = capacity;
+    entry->length = (uint32_t)length;
+    info->freshSlots[pageIndex] = 1;
+    info->pageMapDirty = 1;
+    return RC_OK;
+}
+
+// Checks that a page buffer can be handed to the kernel for direct I/O
+static RC checkAlignment(SM_FileMgmtInfo *info, const void *buffer) {
+    if ((info->flags & SM_OPEN_DIRECT) && ((uintptr_t)buffer % SM_DIRECT_IO_ALIGNMENT) != 0) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_UNALIGNED_BUFFER, (intptr_t)buffer, __LINE__);
+        return RC_BUFFER_NOT_ALIGNED;
+    }
+    return RC_OK;
+}
+
+// Maps (or remaps) the first newSize bytes of the file into memory
+static RC resizeMapping(SM_FileMgmtInfo *info, size_t newSize) {
+    if (newSize == info->mapSize) {
+        return RC_OK;
+    }
+    if (info->map == NULL) {
+        int prot = (info->flags & SM_OPEN_READONLY) ? PROT_READ : PROT_READ | PROT_WRITE;
+        void *map = mmap(NULL, newSize, prot, MAP_SHARED, info->file->backend->descriptor(info->file), 0);
+        if (map == MAP_FAILED) {
+            TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+            return RC_FILE_NOT_FOUND;
+        }
+        info->map = (char *)map;
+    } else {
+        void *map = mremap(info->map, info->mapSize, newSize, MREMAP_MAYMOVE);
+        if (map == MAP_FAILED) {
+            TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+            return RC_WRITE_FAILED;
+        }
+        info->map = (char *)map;
+    }
+    info->mapSize = newSize;
+    return RC_OK;
+}
+
+// Passes an access-pattern hint for a byte range (0/0: the whole file) to the kernel
+static void adviseRange(SM_FileMgmtInfo *info, off_t offset, off_t length, int advice) {
+    if (info->map == NULL) {
+        info->file->backend->advise(info->file, offset, length, advice);
+        return;
+    }
+    if (length == 0 || offset + length > (off_t)info->mapSize) {
+        length = (off_t)info->mapSize - offset;
+    }
+    if (length > 0) {
+        int mapAdvice = (advice == POSIX_FADV_WILLNEED) ? MADV_WILLNEED
+                      : (advice == POSIX_FADV_RANDOM) ? MADV_RANDOM : MADV_NORMAL;
+        madvise(info->map + offset, length, mapAdvice);
+    }
+}
+
+// Follows the reads of a handle: sequential runs get the next window advised
+// ahead of the reader, long stretches of random reads switch read-ahead off
+static void trackReads(SM_FileMgmtInfo *info, PageNumber firstPage, int count, PageNumber totalNumPages) {
+    // compressed slots are not laid out in page order; O_DIRECT bypasses the cache
+    if (info->pageMap != NULL || (info->flags & SM_OPEN_DIRECT)) {
+        return;
+    }
+
+    if (firstPage == info->nextSequentialPage) {
+        info->sequentialRun += count;
+        info->randomRun = 0;
+        info->readAhead.sequentialReads++;
+    } else {
+        info->sequentialRun = count;
+        info->randomRun++;
+        info->readAhead.randomReads++;
+    }
+    info->nextSequentialPage = firstPage + count;
+
+    PageNumber hitStart = (firstPage > info->readAheadStart) ? firstPage : info->readAheadStart;
+    PageNumber hitEnd = (firstPage + count < info->readAheadEnd) ? firstPage + count : info->readAheadEnd;
+    if (hitEnd > hitStart) {
+        info->readAhead.readAheadHits += hitEnd - hitStart;
+    }
+
+    if (info->randomRun >= SM_RANDOM_TRIGGER && !info->adviseRandom) {
+        adviseRange(info, 0, 0, POSIX_FADV_RANDOM);
+        info->adviseRandom = 1;
+        return;
+    }
+    if (info->sequentialRun < SM_SEQUENTIAL_TRIGGER) {
+        return;
+    }
+    if (info->adviseRandom) {
+        adviseRange(info, 0, 0, POSIX_FADV_NORMAL);
+        info->adviseRandom = 0;
+    }
+
+    // keep at least half a window advised ahead of the reader
+    PageNumber window = SM_READAHEAD_BYTES / info->pageSize;
+    if (info->readAheadEnd - info->nextSequentialPage >= window / 2) {
+        return;
+    }
+    PageNumber start = (info->readAheadEnd > info->nextSequentialPage) ? info->readAheadEnd : info->nextSequentialPage;
+    PageNumber end = (start + window < totalNumPages) ? start + window : totalNumPages;
+    if (start >= end) {
+        return;
+    }
+    TRACE(TRACE_DEBUG, TRACE_CAT_STORAGE, TE_SM_READAHEAD, start, end - start);
+    adviseRange(info, pageOffset(info, start), (off_t)(end - start) * info->pageSize, POSIX_FADV_WILLNEED);
+    if (start != info->readAheadEnd) {
+        info->readAheadStart = start;
+    }
+    info->readAheadEnd = end;
+    info->readAhead.readAheadPages += end - start;
+}
+
+// Maps a logical page of a striped file to its stripe and the page within it;
+// whole extents go round-robin over the stripes
+static SM_FileHandle *stripeFor(SM_FileMgmtInfo *info, PageNumber pageIndex, PageNumber *localPage) {
+    PageNumber extentPages = info->header.stripeExtentPages;
+    PageNumber stripeCount = info->header.stripeCount;
+    PageNumber extent = pageIndex / extentPages;
+    *localPage = (extent / stripeCount) * extentPages + pageIndex % extentPages;
+    return &info->stripes[extent % stripeCount];
+}
+
+// Pages a stripe must hold for the striped file to have totalPages pages
+static PageNumber stripePagesNeeded(SM_FileMgmtInfo *info, int stripe, PageNumber totalPages) {
+    PageNumber extentPages = info->header.stripeExtentPages;
+    PageNumber stripeCount = info->header.stripeCount;
+    PageNumber fullExtents = totalPages / extentPages;
+    PageNumber pages = (fullExtents / stripeCount + (stripe < fullExtents % stripeCount ? 1 : 0)) * extentPages;
+    if (stripe == fullExtents % stripeCount) {
+        pages += totalPages % extentPages;
+    }
+    return pages;
+}
+
+// Splits a run of pages at extent boundaries and hands each piece to its stripe
+static RC transferStriped(SM_FileMgmtInfo *info, PageNumber firstPage, int count, SM_PageHandle *buffers,
+                          int isWrite) {
+    PageNumber extentPages = info->header.stripeExtentPages;
+    while (count > 0) {
+        PageNumber localPage;
+        SM_FileHandle *stripe = stripeFor(info, firstPage, &localPage);
+        int run = count;
+        if (extentPages - firstPage % extentPages < run) {
+            run = (int)(extentPages - firstPage % extentPages);
+        }
+        RC rc = isWrite ? writeBlocks(localPage, run, stripe, buffers) : readBlocks(localPage, run, stripe, buffers);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        firstPage += run;
+        buffers += run;
+        count -= run;
+    }
+    return RC_OK;
+}
+
+// Reads the NUL-separated stripe paths stored in logical page 0 of a striped file
+static RC readStripePaths(SM_FileMgmtInfo *info, char **pathPage, char **paths) {
+    void *page = NULL;
+    if (posix_memalign(&page, SM_DIRECT_IO_ALIGNMENT, info->pageSize) != 0) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_OUT_OF_MEMORY, 0, __LINE__);
+        return RC_FILE_NOT_FOUND;
+    }
+    if (info->file->backend->pread(info->file, page, info->pageSize, pageOffset(info, 0)) != info->pageSize) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+        free(page);
+        return RC_BAD_FILE_HEADER;
+    }
+    char *next = (char *)page;
+    char *end = next + info->pageSize;
+    for (uint32_t i = 0; i < info->header.stripeCount; i++) {
+        size_t length = strnlen(next, end - next);
+        if (length == 0 || next + length == end) {
+            TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_BAD_HEADER, i, __LINE__);
+            free(page);
+            return RC_BAD_FILE_HEADER;
+        }
+        paths[i] = next;
+        next += length + 1;
+    }
+    *pathPage = (char *)page;
+    return RC_OK;
+}
+
+// Opens every stripe of a striped file with the flags used for the file itself
+static RC openStripes(SM_FileMgmtInfo *info, int flags) {
+    char *paths[SM_MAX_STRIPES];
+    char *pathPage = NULL;
+    if (info->header.stripeCount < 1 || info->header.stripeCount > SM_MAX_STRIPES ||
+        info->header.stripeExtentPages < 1) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_BAD_HEADER, info->header.stripeCount, __LINE__);
+        return RC_BAD_FILE_HEADER;
+    }
+    RC rc = readStripePaths(info, &pathPage, paths);
+    if (rc != RC_OK) {
+        return rc;
+    }
+
+    info->stripes = (SM_FileHandle *)calloc(info->header.stripeCount, sizeof(SM_FileHandle));
+    if (!info->stripes) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_OUT_OF_MEMORY, 0, __LINE__);
+        free(pathPage);
+        return RC_FILE_NOT_FOUND;
+    }
+    for (uint32_t i = 0; i < info->header.stripeCount; i++) {
+        rc = openPageFileWithFlags(paths[i], &info->stripes[i], flags);
+        if (rc != RC_OK) {
+            while (i-- > 0) {
+                closePageFile(&info->stripes[i]);
+            }
+            free(info->stripes);
+            info->stripes = NULL;
+            break;
+        }
+    }
+    free(pathPage);
+    return rc;
+}
+
+// Writes back what only lives in memory: the page map of a compressed file,
+// the page count of a striped one and the free-page bitmap. Runs under the
+// handle lock, so writers and a group commit leader can share the handle
+static RC saveMetadata(SM_FileHandle *fileHandle) {
+    SM_FileMgmtInfo *info = getMgmtInfo(fileHandle);
+    RC rc = RC_OK;
+    pthread_mutex_lock(&info->handleLock);
+    if (info->stripes != NULL && info->header.numPages != (uint64_t)fileHandle->totalNumPages) {
+        info->header.numPages = fileHandle->totalNumPages;
+        info->freeMapDirty = 1;
+    }
+    if (info->pageMap != NULL) {
+        rc = savePageMap(info, fileHandle->totalNumPages);
+    } else if (info->freeMapDirty) {
+        rc = writeFileHeader(info);
+    }
+    pthread_mutex_unlock(&info->handleLock);
+    return rc;
+}
+
+// Saves the metadata and forces the file (and all its stripes) to the device
+static RC flushFile(SM_FileHandle *fileHandle) {
+    SM_FileMgmtInfo *info = getMgmtInfo(fileHandle);
+    RC rc = saveMetadata(fileHandle);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    if (info->stripes != NULL) {
+        for (uint32_t i = 0; i < info->header.stripeCount; i++) {
+            rc = flushFile(&info->stripes[i]);
+            if (rc != RC_OK) {
+                return rc;
+            }
+        }
+    }
+    // growth may move the mapping
+    pthread_mutex_lock(&info->handleLock);
+    int mapFailed = info->map != NULL && msync(info->map, info->mapSize, MS_SYNC) != 0;
+    pthread_mutex_unlock(&info->handleLock);
+    if (mapFailed) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+        return RC_WRITE_FAILED;
+    }
+    if (syncFileData(info) != 0) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+        return RC_WRITE_FAILED;
+    }
+    return RC_OK;
+}
+
+// Deletes a file from storage with additional helper functions
+RC destroyPageFile(char *filePath) {
+    // Validate file path
+    if (validateFilePath(filePath) != RC_OK) {
+        return RC_FILE_NOT_FOUND;
+    }
+    
+    // Log operation
+    TRACE(TRACE_DEBUG, TRACE_CAT_STORAGE, TE_SM_DELETE, traceHashName(filePath), 0);
+    
+    // Check if file exists before deletion
+    if (!fileExists(filePath)) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_NO_SUCH_FILE, traceHashName(filePath), __LINE__);
+        return RC_FILE_NOT_FOUND;
+    }
+    
+    // A striped file takes its stripes with it
+    SM_BackendFile *file = storageBackendFor(filePath)->open(filePath, O_RDONLY, 0);
+    off_t fileSize, reservedBytes;
+    SM_FileMgmtInfo *info = (SM_FileMgmtInfo *)calloc(1, sizeof(SM_FileMgmtInfo));
+    if (file != NULL && info && file->backend->size(file, &fileSize, &reservedBytes) == 0) {
+        info->file = file;
+        char *paths[SM_MAX_STRIPES];
+        char *pathPage = NULL;
+        if (readFileHeader(info, fileSize) == RC_OK && (info->header.formatFlags & SM_FILE_STRIPED) &&
+            info->header.stripeCount <= SM_MAX_STRIPES && readStripePaths(info, &pathPage, paths) == RC_OK) {
+            for (uint32_t i = 0; i < info->header.stripeCount; i++) {
+                deleteFile(paths[i]);
+            }
+            free(pathPage);
+        }
+    }
+    if (file != NULL) {
+        file->backend->close(file);
+    }
+    free(info);
+
+    // Attempt to delete the file
+    return deleteFile(filePath);
+}
+
+// Creates a new page file and initializes it with an empty page
+RC createPageFile(char *filePath) {
+    return createPageFileWithOptions(filePath, NULL);
+}
+
+// Returns the page size requested by the options, or -1 if it is not allowed
+static int requestedPageSize(SM_FileOptions *options) {
+    int pageSize = (options && options->pageSize) ? options->pageSize : PAGE_SIZE;
+    if (pageSize < SM_MIN_PAGE_SIZE || pageSize > SM_MAX_PAGE_SIZE || (pageSize & (pageSize - 1)) != 0) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, pageSize, __LINE__);
+        return -1;
+    }
+    return pageSize;
+}
+
+// Creates a new page file with the given format options (NULL for defaults)
+RC createPageFileWithOptions(char *filePath, SM_FileOptions *options) {
+    if (validateFilePath(filePath) != RC_OK) {
+        return RC_FILE_NOT_FOUND;
+    }
+    TRACE(TRACE_DEBUG, TRACE_CAT_STORAGE, TE_SM_CREATE, traceHashName(filePath), 0);
+    if (options && (options->flags & ~(SM_FILE_CHECKSUM | SM_FILE_COMPRESSED)) != 0) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, options->flags, __LINE__);
+        return RC_INVALID_ARGUMENT;
+    }
+    int pageSize = requestedPageSize(options);
+    if (pageSize < 0) {
+        return RC_INVALID_ARGUMENT;
+    }
+
+    SM_BackendFile *file = storageBackendFor(filePath)->open(filePath, O_RDWR | O_CREAT | O_TRUNC, FILE_PERMISSIONS);
+    if (file == NULL) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+        return RC_FILE_NOT_FOUND;
+    }
+
+    // header page followed by the first (empty) data page
+    SM_PageHandle emptyBuffer = (SM_PageHandle)calloc(2, pageSize);
+    if (!emptyBuffer) {
+        file->backend->close(file);
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_OUT_OF_MEMORY, 0, __LINE__);
+        return RC_WRITE_FAILED;
+    }
+
+    SM_FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SM_HEADER_MAGIC, sizeof(header.magic));
+    header.version = SM_HEADER_VERSION;
+    header.formatFlags = options ? options->flags : 0;
+    header.pageSize = pageSize;
+    if (header.formatFlags & SM_FILE_COMPRESSED) {
+        // page 0 starts as a never-written (all zero) map entry right after the header
+        header.numPages = 1;
+        header.mapOffset = pageSize;
+        header.mapValid = 1;
+    }
+    header.freeMapPages = SM_FREE_MAP_PAGES;
+    memcpy(emptyBuffer, &header, sizeof(header));
+    emptyBuffer[SM_FREE_MAP_OFFSET] = 1; // page 0 is in use
+
+    ssize_t bytesWritten = file->backend->pwrite(file, emptyBuffer, 2 * (size_t)pageSize, 0);
+    free(emptyBuffer);
+    file->backend->close(file);
+
+    return (bytesWritten == 2 * (ssize_t)pageSize) ? RC_OK : RC_WRITE_FAILED;
+}
+
+// Creates a striped file: a small file naming the stripes, each of which is
+// an ordinary page file created with the given options
+RC createStripedPageFile(char *filePath, char **stripePaths, int numStripes, int extentPages,
+                         SM_FileOptions *options) {
+    if (validateFilePath(filePath) != RC_OK || !stripePaths || numStripes < 1 || numStripes > SM_MAX_STRIPES ||
+        extentPages < 1 || (options && (options->flags & SM_FILE_STRIPED))) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, numStripes, __LINE__);
+        return RC_INVALID_ARGUMENT;
+    }
+    // the striped file reports the page size of its stripes
+    int pageSize = requestedPageSize(options);
+    if (pageSize < 0) {
+        return RC_INVALID_ARGUMENT;
+    }
+
+    // header page followed by the stripe paths
+    SM_PageHandle buffer = (SM_PageHandle)calloc(2, pageSize);
+    if (!buffer) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_OUT_OF_MEMORY, 0, __LINE__);
+        return RC_WRITE_FAILED;
+    }
+    char *next = buffer + pageSize;
+    for (int i = 0; i < numStripes; i++) {
+        size_t length = stripePaths[i] ? strlen(stripePaths[i]) : 0;
+        if (validateFilePath(stripePaths[i]) != RC_OK || length == 0 ||
+            next + length + 1 >= buffer + 2 * pageSize) {
+            TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, i, __LINE__);
+            free(buffer);
+            return RC_INVALID_ARGUMENT;
+        }
+        memcpy(next, stripePaths[i], length + 1);
+        next += length + 1;
+    }
+    for (int i = 0; i < numStripes; i++) {
+        RC rc = createPageFileWithOptions(stripePaths[i], options);
+        if (rc != RC_OK) {
+            free(buffer);
+            return rc;
+        }
+    }
+
+    SM_FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SM_HEADER_MAGIC, sizeof(header.magic));
+    header.version = SM_HEADER_VERSION;
+    header.formatFlags = SM_FILE_STRIPED;
+    header.numPages = 1;
+    header.freeMapPages = SM_FREE_MAP_PAGES;
+    header.stripeCount = numStripes;
+    header.stripeExtentPages = extentPages;
+    header.pageSize = pageSize;
+    memcpy(buffer, &header, sizeof(header));
+    buffer[SM_FREE_MAP_OFFSET] = 1; // page 0 is in use
+
+    SM_BackendFile *file = storageBackendFor(filePath)->open(filePath, O_RDWR | O_CREAT | O_TRUNC, FILE_PERMISSIONS);
+    if (file == NULL) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+        free(buffer);
+        return RC_FILE_NOT_FOUND;
+    }
+    ssize_t bytesWritten = file->backend->pwrite(file, buffer, 2 * (size_t)pageSize, 0);
+    free(buffer);
+    file->backend->close(file);
+    return (bytesWritten == 2 * (ssize_t)pageSize) ? RC_OK : RC_WRITE_FAILED;
+}
+
+// Opens an existing file and sets up the file handle
+RC openPageFile(char *filePath, SM_FileHandle *fileHandle) {
+    return openPageFileWithFlags(filePath, fileHandle, SM_OPEN_DEFAULT);
+}
+
+// Opens an existing file with the given SM_OPEN_* flags
+RC openPageFileWithFlags(char *filePath, SM_FileHandle *fileHandle, int flags) {
+    if (validateFilePath(filePath) != RC_OK || fileHandle == NULL) {
+        return RC_FILE_NOT_FOUND;
+    }
+    TRACE(TRACE_DEBUG, TRACE_CAT_STORAGE, TE_SM_OPEN, traceHashName(filePath), 0);
+
+    if ((flags & SM_OPEN_DIRECT) && (flags & SM_OPEN_MMAP)) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, flags, __LINE__);
+        return RC_INVALID_ARGUMENT;
+    }
+
+    int openMode = (flags & SM_OPEN_READONLY) ? O_RDONLY : O_RDWR;
+    if (flags & SM_OPEN_DIRECT) {
+        openMode |= O_DIRECT;
+    }
+    SM_CachedFile *cached = acquireFile(filePath, openMode);
+    if (cached == NULL) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+        return RC_FILE_NOT_FOUND;
+    }
+    SM_BackendFile *file = cached->file;
+
+    // only backends with a descriptor can be mapped
+    if ((flags & SM_OPEN_MMAP) && file->backend->descriptor(file) == -1) {
+        releaseFile(cached);
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, flags, __LINE__);
+        return RC_INVALID_ARGUMENT;
+    }
+
+    off_t fileSize, reservedBytes;
+    if (file->backend->size(file, &fileSize, &reservedBytes) != 0) {
+        releaseFile(cached);
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+        return RC_FILE_NOT_FOUND;
+    }
+
+    SM_FileMgmtInfo *info = (SM_FileMgmtInfo *)calloc(1, sizeof(SM_FileMgmtInfo));
+    if (!info) {
+        releaseFile(cached);
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_OUT_OF_MEMORY, 0, __LINE__);
+        return RC_FILE_NOT_FOUND;
+    }
+    info->file = file;
+    info->cached = cached;
+    info->flags = flags;
+    pthread_mutexattr_t lockAttr;
+    pthread_mutexattr_init(&lockAttr);
+    pthread_mutexattr_settype(&lockAttr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&info->handleLock, &lockAttr);
+    pthread_mutexattr_destroy(&lockAttr);
+    pthread_mutex_init(&info->syncLock, NULL);
+    pthread_cond_init(&info->syncDone, NULL);
+
+    RC rc = readFileHeader(info, fileSize);
+    if (rc != RC_OK) {
+        releaseFile(cached);
+        free(info);
+        return rc;
+    }
+
+    if (info->header.formatFlags & SM_FILE_STRIPED) {
+        rc = openStripes(info, flags);
+        if (rc != RC_OK) {
+            releaseFile(cached);
+            free(info);
+            return rc;
+        }
+        fileHandle->totalNumPages = (PageNumber)info->header.numPages;
+        fileHandle->curPagePos = 0;
+        fileHandle->pageSize = info->pageSize;
+        fileHandle->fileName = strdup(filePath);
+        fileHandle->mgmtInfo = info;
+        info->allocatedPages = fileHandle->totalNumPages;
+        return RC_OK;
+    }
+
+    // compressed pages have no fixed position to map or to transfer directly
+    if ((info->header.formatFlags & SM_FILE_COMPRESSED) && (flags & (SM_OPEN_MMAP | SM_OPEN_DIRECT))) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, flags, __LINE__);
+        releaseFile(cached);
+        free(info);
+        return RC_INVALID_ARGUMENT;
+    }
+    if (info->header.formatFlags & SM_FILE_COMPRESSED) {
+        rc = loadPageMap(info);
+        if (rc != RC_OK) {
+            releaseFile(cached);
+            free(info->pageMap);
+            free(info->freshSlots);
+            free(info->freeSlots.slots);
+            free(info->codecBuffer);
+            free(info);
+            return rc;
+        }
+        fileHandle->totalNumPages = (PageNumber)info->header.numPages;
+        initFreeMap(info, fileHandle->totalNumPages);
+        fileHandle->curPagePos = 0;
+        fileHandle->pageSize = info->pageSize;
+        fileHandle->fileName = strdup(filePath);
+        fileHandle->mgmtInfo = info;
+        info->allocatedPages = fileHandle->totalNumPages;
+        return RC_OK;
+    }
+
+    // blocks preallocated past the end of file by an earlier handle are reused
+    PageNumber totalNumPages = fileSize / info->pageSize - info->headerPages;
+    PageNumber reservedPages = (PageNumber)reservedBytes / info->pageSize - info->headerPages;
+    info->allocatedPages = (reservedPages > totalNumPages) ? reservedPages : totalNumPages;
+    info->extentEnd = info->allocatedPages;
+    info->nextExtentPages = extentPolicy.initialExtentPages;
+    if ((flags & SM_OPEN_MMAP) && pageOffset(info, totalNumPages) > 0) {
+        rc = resizeMapping(info, (size_t)pageOffset(info, totalNumPages));
+        if (rc != RC_OK) {
+            releaseFile(cached);
+            free(info);
+            return rc;
+        }
+    }
+
+    initFreeMap(info, totalNumPages);
+    fileHandle->totalNumPages = totalNumPages;
+    fileHandle->curPagePos = 0;
+    fileHandle->pageSize = info->pageSize;
+    fileHandle->fileName = strdup(filePath);
+    fileHandle->mgmtInfo = info;
+    return RC_OK;
+}
+
+// Closes an open file and releases resources
+RC closePageFile(SM_FileHandle *fileHandle) {
+    if (!fileHandle || !fileHandle->mgmtInfo) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, 0, __LINE__);
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    TRACE(TRACE_DEBUG, TRACE_CAT_STORAGE, TE_SM_CLOSE, traceHashName(fileHandle->fileName), 0);
+
+    SM_FileMgmtInfo *info = getMgmtInfo(fileHandle);
+    RC rc = RC_OK;
+    if (!(info->flags & SM_OPEN_READONLY)) {
+        rc = (info->durability == SM_DURABILITY_NONE) ? saveMetadata(fileHandle) : flushFile(fileHandle);
+    }
+    if (info->stripes != NULL) {
+        for (uint32_t i = 0; i < info->header.stripeCount; i++) {
+            RC stripeRc = closePageFile(&info->stripes[i]);
+            if (rc == RC_OK) {
+                rc = stripeRc;
+            }
+        }
+        free(info->stripes);
+    }
+    if (info->map != NULL) {
+        munmap(info->map, info->mapSize);
+    }
+    if (info->adviseRandom && info->map == NULL) {
+        // the next handle on the cached file starts with normal read-ahead
+        adviseRange(info, 0, 0, POSIX_FADV_NORMAL);
+    }
+    releaseFile(info->cached);
+    pthread_mutex_destroy(&info->handleLock);
+    pthread_mutex_destroy(&info->syncLock);
+    pthread_cond_destroy(&info->syncDone);
+    free(info->pageMap);
+    free(info->freshSlots);
+    free(info->freeSlots.slots);
+    free(info->retiredSlots.slots);
+    free(info->codecBuffer);
+    free(info);
+    free(fileHandle->fileName);
+    fileHandle->mgmtInfo = NULL;
+    return rc;
+}
+
+// Moves the handle position after a transfer
+static void setBlockPos(SM_FileHandle *fileHandle, PageNumber pageNum) {
+    SM_FileMgmtInfo *info = getMgmtInfo(fileHandle);
+    pthread_mutex_lock(&info->handleLock);
+    fileHandle->curPagePos = pageNum;
+    pthread_mutex_unlock(&info->handleLock);
+}
+
+// Reads a specific page into memory
+RC readBlock(PageNumber pageIndex, SM_FileHandle *fileHandle, SM_PageHandle buffer) {
+    if (!fileHandle || !buffer || pageIndex < 0 || pageIndex >= fileHandle->totalNumPages) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, pageIndex, __LINE__);
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+    TRACE(TRACE_DEBUG, TRACE_CAT_STORAGE, TE_SM_READ, traceHashName(fileHandle->fileName), pageIndex);
+
+    SM_FileMgmtInfo *info = getMgmtInfo(fileHandle);
+    RC rc = checkAlignment(info, buffer);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    if (info->stripes != NULL) {
+        PageNumber localPage;
+        SM_FileHandle *stripe = stripeFor(info, pageIndex, &localPage);
+        rc = readBlock(localPage, stripe, buffer);
+        if (rc == RC_OK) {
+            setBlockPos(fileHandle, pageIndex);
+        }
+        return rc;
+    }
+    pthread_mutex_lock(&info->handleLock);
+    trackReads(info, pageIndex, 1, fileHandle->totalNumPages);
+    pthread_mutex_unlock(&info->handleLock);
+    if (info->pageMap != NULL) {
+        // the page map and codec buffer change with every compressed write
+        pthread_mutex_lock(&info->handleLock);
+        rc = readCompressedPage(info, pageIndex, buffer);
+        pthread_mutex_unlock(&info->handleLock);
+        if (rc != RC_OK) {
+            return rc;
+        }
+    } else if (info->map != NULL) {
+        memcpy(buffer, info->map + pageOffset(info, pageIndex), info->pageSize);
+    } else {
+        ssize_t bytesRead = info->file->backend->pread(info->file, buffer, info->pageSize, pageOffset(info, pageIndex));
+        if (bytesRead != info->pageSize) {
+            return RC_READ_NON_EXISTING_PAGE;
+        }
+    }
+    rc = verifyChecksum(info, pageIndex, buffer);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    setBlockPos(fileHandle, pageIndex);
+    return RC_OK;
+}
+
+// Returns a pointer to a page inside the mapping without copying it
+RC getBlockPointer(PageNumber pageIndex, SM_FileHandle *fileHandle, SM_PageHandle *page) {
+    if (!fileHandle || !fileHandle->mgmtInfo || !page) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, 0, __LINE__);
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (pageIndex < 0 || pageIndex >= fileHandle->totalNumPages) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, pageIndex, __LINE__);
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+
+    SM_FileMgmtInfo *info = getMgmtInfo(fileHandle);
+    if (info->stripes != NULL) {
+        PageNumber localPage;
+        SM_FileHandle *stripe = stripeFor(info, pageIndex, &localPage);
+        return getBlockPointer(localPage, stripe, page);
+    }
+    if (info->map == NULL) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_NOT_MAPPED, pageIndex, __LINE__);
+        return RC_FILE_NOT_MAPPED;
+    }
+    RC rc = verifyChecksum(info, pageIndex, info->map + pageOffset(info, pageIndex));
+    if (rc != RC_OK) {
+        return rc;
+    }
+    *page = info->map + pageOffset(info, pageIndex);
+    return RC_OK;
+}
+
+// Returns the current page position of the handle
+PageNumber getBlockPos(SM_FileHandle *fileHandle) {
+    if (!fileHandle || !fileHandle->mgmtInfo) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, 0, __LINE__);
+        return -1;
+    }
+    return fileHandle->curPagePos;
+}
+
+// Reads the first block of a file
+RC readFirstBlock(SM_FileHandle *fileHandle, SM_PageHandle buffer) {
+    return readBlock(0, fileHandle, buffer);
+}
+
+// Reads the block before the current position
+RC readPreviousBlock(SM_FileHandle *fileHandle, SM_PageHandle buffer) {
+    if (!fileHandle) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    return readBlock(fileHandle->curPagePos - 1, fileHandle, buffer);
+}
+
+// Reads the block at the current position
+RC readCurrentBlock(SM_FileHandle *fileHandle, SM_PageHandle buffer) {
+    if (!fileHandle) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    return readBlock(fileHandle->curPagePos, fileHandle, buffer);
+}
+
+// Reads the block after the current position
+RC readNextBlock(SM_FileHandle *fileHandle, SM_PageHandle buffer) {
+    if (!fileHandle) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    return readBlock(fileHandle->curPagePos + 1, fileHandle, buffer);
+}
+
+// Reads the last block of a file
+RC readLastBlock(SM_FileHandle *fileHandle, SM_PageHandle buffer) {
+    if (!fileHandle) {
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    return readBlock(fileHandle->totalNumPages - 1, fileHandle, buffer);
+}
+
+// Builds an iovec list for count pages, merging buffers that are adjacent in memory
+static int buildIoVectors(SM_PageHandle *buffers, int count, int pageSize, struct iovec *iov) {
+    int numVectors = 0;
+    for (int i = 0; i < count; i++) {
+        if (numVectors > 0 &&
+            (char *)iov[numVectors - 1].iov_base + iov[numVectors - 1].iov_len == buffers[i]) {
+            iov[numVectors - 1].iov_len += pageSize;
+        } else {
+            iov[numVectors].iov_base = buffers[i];
+            iov[numVectors].iov_len = pageSize;
+            numVectors++;
+        }
+    }
+    return numVectors;
+}
+
+// Moves count pages starting at firstPage with as few preadv/pwritev calls as possible
+static RC transferBlocks(SM_FileMgmtInfo *info, PageNumber firstPage, int count,
+                         SM_PageHandle *buffers, int isWrite) {
+    struct iovec iov[IOV_MAX];
+    int done = 0;
+
+    while (done < count) {
+        int batch = (count - done < IOV_MAX) ? count - done : IOV_MAX;
+        int numVectors = buildIoVectors(buffers + done, batch, info->pageSize, iov);
+        struct iovec *cur = iov;
+        off_t offset = pageOffset(info, firstPage + done);
+        size_t remaining = (size_t)batch * info->pageSize;
+
+        // retry short transfers from wherever the previous call stopped
+        while (remaining > 0) {
+            ssize_t moved = isWrite ? writeFileVector(info, cur, numVectors, offset)
+                                    : info->file->backend->preadv(info->file, cur, numVectors, offset);
+            if (moved <= 0) {
+                TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+                return isWrite ? RC_WRITE_FAILED : RC_READ_NON_EXISTING_PAGE;
+            }
+            remaining -= moved;
+            offset += moved;
+            while (numVectors > 0 && (size_t)moved >= cur->iov_len) {
+                moved -= cur->iov_len;
+                cur++;
+                numVectors--;
+            }
+            if (numVectors > 0) {
+                cur->iov_base = (char *)cur->iov_base + moved;
+                cur->iov_len -= moved;
+            }
+        }
+        done += batch;
+    }
+    return RC_OK;
+}
+
+// Reads count consecutive pages starting at firstPage into buffers[0..count-1]
+RC readBlocks(PageNumber firstPage, int count, SM_FileHandle *fileHandle, SM_PageHandle *buffers) {
+    if (!fileHandle || !fileHandle->mgmtInfo || !buffers || count <= 0 || firstPage < 0 ||
+        firstPage > fileHandle->totalNumPages - count) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, firstPage, __LINE__);
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+    TRACE(TRACE_DEBUG, TRACE_CAT_STORAGE, TE_SM_READ, traceHashName(fileHandle->fileName), firstPage);
+
+    SM_FileMgmtInfo *info = getMgmtInfo(fileHandle);
+    for (int i = 0; i < count; i++) {
+        RC rc = checkAlignment(info, buffers[i]);
+        if (rc != RC_OK) {
+            return rc;
+        }
+    }
+    if (info->stripes != NULL) {
+        RC rc = transferStriped(info, firstPage, count, buffers, 0);
+        if (rc == RC_OK) {
+            setBlockPos(fileHandle, firstPage + count - 1);
+        }
+        return rc;
+    }
+    pthread_mutex_lock(&info->handleLock);
+    trackReads(info, firstPage, count, fileHandle->totalNumPages);
+    pthread_mutex_unlock(&info->handleLock);
+    if (info->pageMap != NULL) {
+        pthread_mutex_lock(&info->handleLock);
+        for (int i = 0; i < count; i++) {
+            RC rc = readCompressedPage(info, firstPage + i, buffers[i]);
+            if (rc != RC_OK) {
+                pthread_mutex_unlock(&info->handleLock);
+                return rc;
+            }
+        }
+        pthread_mutex_unlock(&info->handleLock);
+    } else if (info->map != NULL) {
+        for (int i = 0; i < count; i++) {
+            memcpy(buffers[i], info->map + pageOffset(info, firstPage + i), info->pageSize);
+        }
+    } else {
+        RC rc = transferBlocks(info, firstPage, count, buffers, 0);
+        if (rc != RC_OK) {
+            return rc;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        RC rc = verifyChecksum(info, firstPage + i, buffers[i]);
+        if (rc != RC_OK) {
+            return rc;
+        }
+    }
+    setBlockPos(fileHandle, firstPage + count - 1);
+    return RC_OK;
+}
+
+// Writes a page to a specific block
+static RC writePage(PageNumber pageIndex, SM_FileHandle *fileHandle, SM_PageHandle buffer) {
+    if (!fileHandle || !buffer || pageIndex < 0 || pageIndex >= fileHandle->totalNumPages) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, pageIndex, __LINE__);
+        return RC_WRITE_FAILED;
+    }
+    TRACE(TRACE_DEBUG, TRACE_CAT_STORAGE, TE_SM_WRITE, traceHashName(fileHandle->fileName), pageIndex);
+
+    SM_FileMgmtInfo *info = getMgmtInfo(fileHandle);
+    if (info->flags & SM_OPEN_READONLY) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_READ_ONLY, 0, __LINE__);
+        return RC_WRITE_FAILED;
+    }
+    RC rc = checkAlignment(info, buffer);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    if (info->stripes != NULL) {
+        PageNumber localPage;
+        SM_FileHandle *stripe = stripeFor(info, pageIndex, &localPage);
+        rc = writeBlock(localPage, stripe, buffer);
+        if (rc == RC_OK) {
+            setBlockPos(fileHandle, pageIndex);
+        }
+        return rc;
+    }
+    stampChecksum(info, buffer);
+    if (info->pageMap != NULL) {
+        pthread_mutex_lock(&info->handleLock);
+        rc = writeCompressedPage(info, pageIndex, buffer);
+        pthread_mutex_unlock(&info->handleLock);
+        if (rc == RC_OK) {
+            setBlockPos(fileHandle, pageIndex);
+        }
+        return rc;
+    }
+    if (info->map != NULL) {
+        writeMappedPage(info, pageOffset(info, pageIndex), buffer);
+        setBlockPos(fileHandle, pageIndex);
+        return RC_OK;
+    }
+
+    ssize_t bytesWritten = writeFileRange(info, buffer, info->pageSize, pageOffset(info, pageIndex));
+    if (bytesWritten != info->pageSize) {
+        return RC_WRITE_FAILED;
+    }
+    setBlockPos(fileHandle, pageIndex);
+    return RC_OK;
+}
+
+// Writes buffers[0..count-1] to count consecutive pages starting at firstPage
+static RC writePages(PageNumber firstPage, int count, SM_FileHandle *fileHandle, SM_PageHandle *buffers) {
+    if (!fileHandle || !fileHandle->mgmtInfo || !buffers || count <= 0 || firstPage < 0 ||
+        firstPage > fileHandle->totalNumPages - count) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, firstPage, __LINE__);
+        return RC_WRITE_FAILED;
+    }
+    TRACE(TRACE_DEBUG, TRACE_CAT_STORAGE, TE_SM_WRITE, traceHashName(fileHandle->fileName), firstPage);
+
+    SM_FileMgmtInfo *info = getMgmtInfo(fileHandle);
+    if (info->flags & SM_OPEN_READONLY) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_READ_ONLY, 0, __LINE__);
+        return RC_WRITE_FAILED;
+    }
+    if (info->stripes != NULL) {
+        RC rc = transferStriped(info, firstPage, count, buffers, 1);
+        if (rc == RC_OK) {
+            setBlockPos(fileHandle, firstPage + count - 1);
+        }
+        return rc;
+    }
+    for (int i = 0; i < count; i++) {
+        RC rc = checkAlignment(info, buffers[i]);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        stampChecksum(info, buffers[i]);
+    }
+    if (info->pageMap != NULL) {
+        pthread_mutex_lock(&info->handleLock);
+        for (int i = 0; i < count; i++) {
+            RC rc = writeCompressedPage(info, firstPage + i, buffers[i]);
+            if (rc != RC_OK) {
+                pthread_mutex_unlock(&info->handleLock);
+                return rc;
+            }
+        }
+        pthread_mutex_unlock(&info->handleLock);
+    } else if (info->map != NULL) {
+        for (int i = 0; i < count; i++) {
+            writeMappedPage(info, pageOffset(info, firstPage + i), buffers[i]);
+        }
+    } else {
+        RC rc = transferBlocks(info, firstPage, count, buffers, 1);
+        if (rc != RC_OK) {
+            return rc;
+        }
+    }
+    setBlockPos(fileHandle, firstPage + count - 1);
+    return RC_OK;
+}
+
+// Writes a page to a specific block, forcing it out in SM_DURABILITY_PER_WRITE mode
+RC writeBlock(PageNumber pageIndex, SM_FileHandle *fileHandle, SM_PageHandle buffer) {
+    RC rc = writePage(pageIndex, fileHandle, buffer);
+    if (rc == RC_OK && getMgmtInfo(fileHandle)->durability == SM_DURABILITY_PER_WRITE) {
+        rc = flushFile(fileHandle);
+    }
+    return rc;
+}
+
+// Writes count consecutive pages, forcing them out in SM_DURABILITY_PER_WRITE mode
+RC writeBlocks(PageNumber firstPage, int count, SM_FileHandle *fileHandle, SM_PageHandle *buffers) {
+    RC rc = writePages(firstPage, count, fileHandle, buffers);
+    if (rc == RC_OK && getMgmtInfo(fileHandle)->durability == SM_DURABILITY_PER_WRITE) {
+        rc = flushFile(fileHandle);
+    }
+    return rc;
+}
+
+// Selects when writes on this handle are forced to the device
+RC setDurabilityMode(SM_FileHandle *fileHandle, SM_DurabilityMode mode, int maxWaitMicros) {
+    if (!fileHandle || !fileHandle->mgmtInfo) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, 0, __LINE__);
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (mode < SM_DURABILITY_NONE || mode > SM_DURABILITY_GROUP_COMMIT || maxWaitMicros < 0 ||
+        maxWaitMicros > 1000000) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, mode, __LINE__);
+        return RC_INVALID_ARGUMENT;
+    }
+    SM_FileMgmtInfo *info = getMgmtInfo(fileHandle);
+    pthread_mutex_lock(&info->syncLock);
+    info->durability = mode;
+    info->maxSyncWaitMicros = maxWaitMicros;
+    pthread_mutex_unlock(&info->syncLock);
+    return RC_OK;
+}
+
+// Makes every write that returned before the call durable. In group commit
+// mode one caller becomes the leader, waits up to maxWaitMicros for others to
+// join and then issues a single fdatasync on behalf of all of them. syncLock
+// only orders the syncing threads; the leader saves the metadata under the
+// handle lock, so other threads keep writing meanwhile
+RC syncPageFile(SM_FileHandle *fileHandle) {
+    if (!fileHandle || !fileHandle->mgmtInfo) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, 0, __LINE__);
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_FileMgmtInfo *info = getMgmtInfo(fileHandle);
+    if (info->durability == SM_DURABILITY_NONE || (info->flags & SM_OPEN_READONLY)) {
+        return RC_OK;
+    }
+    if (info->durability == SM_DURABILITY_PER_WRITE) {
+        return flushFile(fileHandle);
+    }
+
+    pthread_mutex_lock(&info->syncLock);
+    long ticket = ++info->syncRequested;
+    while (info->syncCompleted < ticket && info->syncError == RC_OK) {
+        if (info->syncInProgress) {
+            pthread_cond_wait(&info->syncDone, &info->syncLock);
+            continue;
+        }
+
+        info->syncInProgress = 1;
+        if (info->maxSyncWaitMicros > 0) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += (long)info->maxSyncWaitMicros * 1000;
+            deadline.tv_sec += deadline.tv_nsec / 1000000000;
+            deadline.tv_nsec %= 1000000000;
+            // nobody signals while a leader exists, so this just waits out the window
+            while (pthread_cond_timedwait(&info->syncDone, &info->syncLock, &deadline) != ETIMEDOUT) {
+            }
+        }
+        long target = info->syncRequested;
+        pthread_mutex_unlock(&info->syncLock);
+        RC rc = flushFile(fileHandle);
+        pthread_mutex_lock(&info->syncLock);
+
+        if (rc == RC_OK) {
+            info->syncCompleted = target;
+        } else {
+            info->syncError = rc;
+        }
+        info->syncInProgress = 0;
+        pthread_cond_broadcast(&info->syncDone);
+    }
+    RC rc = (info->syncCompleted >= ticket) ? RC_OK : info->syncError;
+    pthread_mutex_unlock(&info->syncLock);
+    return rc;
+}
+
+// Reports how reads on this handle were classified and how read-ahead fared;
+// a striped file adds up the counters of its stripes
+RC getReadAheadStats(SM_FileHandle *fileHandle, SM_ReadAheadStats *stats) {
+    if (!fileHandle || !fileHandle->mgmtInfo || !stats) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, 0, __LINE__);
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_FileMgmtInfo *info = getMgmtInfo(fileHandle);
+    pthread_mutex_lock(&info->handleLock);
+    *stats = info->readAhead;
+    pthread_mutex_unlock(&info->handleLock);
+    if (info->stripes != NULL) {
+        for (uint32_t i = 0; i < info->header.stripeCount; i++) {
+            SM_ReadAheadStats stripeStats;
+            getReadAheadStats(&info->stripes[i], &stripeStats);
+            stats->sequentialReads += stripeStats.sequentialReads;
+            stats->randomReads += stripeStats.randomReads;
+            stats->readAheadPages += stripeStats.readAheadPages;
+            stats->readAheadHits += stripeStats.readAheadHits;
+        }
+    }
+    return RC_OK;
+}
+
+// Returns the number of fdatasync calls issued on this handle
+long getSyncCount(SM_FileHandle *fileHandle) {
+    if (!fileHandle || !fileHandle->mgmtInfo) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, 0, __LINE__);
+        return -1;
+    }
+    return atomic_load_explicit(&getMgmtInfo(fileHandle)->syncCount, memory_order_relaxed);
+}
+
+// Writes to the first block of a file
+RC writeFirstBlock(SM_FileHandle *fileHandle, SM_PageHandle buffer) {
+    return writeBlock(0, fileHandle, buffer);
+}
+
+// Writes to the current block of a file
+RC writeCurrentBlock(SM_FileHandle *fileHandle, SM_PageHandle buffer) {
+    return writeBlock(fileHandle->curPagePos, fileHandle, buffer);
+}
+
+// Reserves disk blocks up to at least requiredPages without changing the file size
+static RC preallocateExtent(SM_FileMgmtInfo *info, PageNumber requiredPages) {
+    if (requiredPages <= info->extentEnd) {
+        return RC_OK;
+    }
+
+    // a jump past more than one maximal extent is left sparse; extents resume
+    // after it, and the pages in it are not counted as allocated
+    if (requiredPages - info->extentEnd > extentPolicy.maxExtentPages) {
+        info->extentEnd = requiredPages;
+        return RC_OK;
+    }
+
+    // the next extent is the larger of the policy's extent and what is missing
+    PageNumber extentPages = info->nextExtentPages;
+    if (extentPages < requiredPages - info->extentEnd) {
+        extentPages = requiredPages - info->extentEnd;
+    }
+    if (info->file->backend->allocate(info->file, pageOffset(info, info->extentEnd),
+                                      (off_t)extentPages * info->pageSize) != 0) {
+        if (errno != EOPNOTSUPP && errno != ENOSYS) {
+            TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+            return RC_WRITE_FAILED;
+        }
+        // the file system cannot preallocate; ftruncate alone still grows the file
+        extentPages = requiredPages - info->extentEnd;
+    }
+    info->extentEnd += extentPages;
+    info->allocatedPages += extentPages;
+
+    long long nextExtent = (long long)info->nextExtentPages * extentPolicy.growthFactor;
+    info->nextExtentPages = (nextExtent > extentPolicy.maxExtentPages)
+                                ? extentPolicy.maxExtentPages : (int)nextExtent;
+    return RC_OK;
+}
+
+// Grows the file to requiredPages; the handle lock must be held
+static RC ensureCapacityLocked(PageNumber requiredPages, SM_FileHandle *fileHandle) {
+    if (requiredPages <= fileHandle->totalNumPages) {
+        return RC_OK;
+    }
+
+    SM_FileMgmtInfo *info = getMgmtInfo(fileHandle);
+    if (info->flags & SM_OPEN_READONLY) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_READ_ONLY, 0, __LINE__);
+        return RC_WRITE_FAILED;
+    }
+
+    TRACE(TRACE_DEBUG, TRACE_CAT_STORAGE, TE_SM_EXTEND, traceHashName(fileHandle->fileName), requiredPages);
+
+    // striped files grow each stripe by its share of the new pages
+    if (info->stripes != NULL) {
+        for (uint32_t i = 0; i < info->header.stripeCount; i++) {
+            RC rc = ensureCapacity(stripePagesNeeded(info, i, requiredPages), &info->stripes[i]);
+            if (rc != RC_OK) {
+                return rc;
+            }
+        }
+        markPages(info, fileHandle->totalNumPages, requiredPages, 1);
+        fileHandle->totalNumPages = requiredPages;
+        info->allocatedPages = requiredPages;
+        return RC_OK;
+    }
+
+    // compressed files only grow their page map; slots appear on first write
+    if (info->pageMap != NULL) {
+        RC rc = growPageMap(info, requiredPages);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        markPages(info, fileHandle->totalNumPages, requiredPages, 1);
+        fileHandle->totalNumPages = requiredPages;
+        info->allocatedPages = requiredPages;
+        return RC_OK;
+    }
+
+    // Reserve a whole extent, then move the logical end of file; the kernel
+    // returns zeros for the new pages without us writing them
+    RC rc = preallocateExtent(info, requiredPages);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    if (truncateFile(info, pageOffset(info, requiredPages)) != 0) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+        return RC_WRITE_FAILED;
+    }
+
+    // Mapped files also grow their mapping
+    if (info->flags & SM_OPEN_MMAP) {
+        rc = resizeMapping(info, (size_t)pageOffset(info, requiredPages));
+        if (rc != RC_OK) {
+            return rc;
+        }
+    }
+    markPages(info, fileHandle->totalNumPages, requiredPages, 1);
+    fileHandle->totalNumPages = requiredPages;
+    return RC_OK;
+}
+
+// Ensures a file contains at least the specified number of pages
+RC ensureCapacity(PageNumber requiredPages, SM_FileHandle *fileHandle) {
+    if (!fileHandle || !fileHandle->mgmtInfo) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, 0, __LINE__);
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_FileMgmtInfo *info = getMgmtInfo(fileHandle);
+    pthread_mutex_lock(&info->handleLock);
+    RC rc = ensureCapacityLocked(requiredPages, fileHandle);
+    pthread_mutex_unlock(&info->handleLock);
+    return rc;
+}
+
+// Appends one zero-filled page to the end of the file
+RC appendEmptyBlock(SM_FileHandle *fileHandle) {
+    if (!fileHandle || !fileHandle->mgmtInfo) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, 0, __LINE__);
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_FileMgmtInfo *info = getMgmtInfo(fileHandle);
+    pthread_mutex_lock(&info->handleLock);
+    RC rc = ensureCapacityLocked(fileHandle->totalNumPages + 1, fileHandle);
+    pthread_mutex_unlock(&info->handleLock);
+    return rc;
+}
+
+// Finds or appends a free page for allocatePage; the handle lock must be held
+static RC allocatePageLocked(SM_FileHandle *fileHandle, PageNumber *pageNum) {
+    SM_FileMgmtInfo *info = getMgmtInfo(fileHandle);
+    if (info->flags & SM_OPEN_READONLY) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_READ_ONLY, 0, __LINE__);
+        return RC_WRITE_FAILED;
+    }
+
+    PageNumber limit = fileHandle->totalNumPages;
+    if (limit > (PageNumber)info->header.freeMapPages) {
+        limit = (PageNumber)info->header.freeMapPages;
+    }
+    for (PageNumber n = 0; n < limit; n++) {
+        PageNumber candidate = (info->nextFitPage + n) % limit;
+        if (pageInUse(info, candidate)) {
+            continue;
+        }
+
+        // a reused page reads as zeros, just like an appended one
+        void *zeroPage = NULL;
+        if (posix_memalign(&zeroPage, SM_DIRECT_IO_ALIGNMENT, fileHandle->pageSize) != 0) {
+            TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_OUT_OF_MEMORY, 0, __LINE__);
+            return RC_WRITE_FAILED;
+        }
+        memset(zeroPage, 0, fileHandle->pageSize);
+        RC rc = writeBlock(candidate, fileHandle, (SM_PageHandle)zeroPage);
+        free(zeroPage);
+        if (rc != RC_OK) {
+            return rc;
+        }
+        markPages(info, candidate, candidate + 1, 1);
+        info->nextFitPage = candidate + 1;
+        *pageNum = candidate;
+        return RC_OK;
+    }
+
+    RC rc = ensureCapacityLocked(fileHandle->totalNumPages + 1, fileHandle);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    *pageNum = fileHandle->totalNumPages - 1;
+    info->nextFitPage = fileHandle->totalNumPages;
+    return RC_OK;
+}
+
+// Hands out a free page, searching onward from the last allocation so that
+// consecutive calls return neighbouring pages; grows the file when none is free
+RC allocatePage(SM_FileHandle *fileHandle, PageNumber *pageNum) {
+    if (!fileHandle || !fileHandle->mgmtInfo || !pageNum) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, 0, __LINE__);
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_FileMgmtInfo *info = getMgmtInfo(fileHandle);
+    pthread_mutex_lock(&info->handleLock);
+    RC rc = allocatePageLocked(fileHandle, pageNum);
+    pthread_mutex_unlock(&info->handleLock);
+    return rc;
+}
+
+// Returns a page to the free-page bitmap so allocatePage can reuse it
+RC freePage(PageNumber pageNum, SM_FileHandle *fileHandle) {
+    if (!fileHandle || !fileHandle->mgmtInfo) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, 0, __LINE__);
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_FileMgmtInfo *info = getMgmtInfo(fileHandle);
+    if (info->flags & SM_OPEN_READONLY) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_READ_ONLY, 0, __LINE__);
+        return RC_WRITE_FAILED;
+    }
+    // pages outside the bitmap (and every page of a header-less file) cannot be freed
+    pthread_mutex_lock(&info->handleLock);
+    if (pageNum < 0 || pageNum >= fileHandle->totalNumPages || pageNum >= (PageNumber)info->header.freeMapPages ||
+        !pageInUse(info, pageNum)) {
+        pthread_mutex_unlock(&info->handleLock);
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, pageNum, __LINE__);
+        return RC_INVALID_ARGUMENT;
+    }
+    markPages(info, pageNum, pageNum + 1, 0);
+    pthread_mutex_unlock(&info->handleLock);
+    return RC_OK;
+}
+
+// Returns 1 if the page is allocated, 0 if it is free or does not exist
+int isPageAllocated(PageNumber pageNum, SM_FileHandle *fileHandle) {
+    if (!fileHandle || !fileHandle->mgmtInfo || pageNum < 0 || pageNum >= fileHandle->totalNumPages) {
+        return 0;
+    }
+    return pageInUse(getMgmtInfo(fileHandle), pageNum);
+}
+
+// Takes up appended pages for refreshPageFile; the handle lock must be held
+static RC refreshPageFileLocked(SM_FileHandle *fileHandle) {
+    SM_FileMgmtInfo *info = getMgmtInfo(fileHandle);
+    // compressed and striped files keep their page count in the handle
+    if (info->pageMap != NULL || info->stripes != NULL) {
+        return RC_OK;
+    }
+    off_t fileSize, reservedBytes;
+    if (info->file->backend->size(info->file, &fileSize, &reservedBytes) != 0) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+        return RC_FILE_NOT_FOUND;
+    }
+    PageNumber totalNumPages = fileSize / info->pageSize - info->headerPages;
+    if (totalNumPages <= fileHandle->totalNumPages) {
+        return RC_OK;
+    }
+    if (info->flags & SM_OPEN_MMAP) {
+        RC rc = resizeMapping(info, (size_t)pageOffset(info, totalNumPages));
+        if (rc != RC_OK) {
+            return rc;
+        }
+    }
+    markPages(info, fileHandle->totalNumPages, totalNumPages, 1);
+    fileHandle->totalNumPages = totalNumPages;
+    // the other handle's extents and writes show up in the blocks in use
+    PageNumber reservedPages = (PageNumber)(reservedBytes / info->pageSize) - info->headerPages;
+    if (info->allocatedPages < reservedPages) {
+        info->allocatedPages = reservedPages;
+    }
+    if (info->extentEnd < totalNumPages) {
+        info->extentEnd = totalNumPages;
+    }
+    return RC_OK;
+}
+
+// Takes up pages another handle (possibly in another process) appended to a
+// plain page file since this handle last looked; they count as in use
+RC refreshPageFile(SM_FileHandle *fileHandle) {
+    if (!fileHandle || !fileHandle->mgmtInfo) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, 0, __LINE__);
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    SM_FileMgmtInfo *info = getMgmtInfo(fileHandle);
+    pthread_mutex_lock(&info->handleLock);
+    RC rc = refreshPageFileLocked(fileHandle);
+    pthread_mutex_unlock(&info->handleLock);
+    return rc;
+}
+
+// Returns the format flags recorded in the file header
+int getPageFileFormat(SM_FileHandle *fileHandle) {
+    if (!fileHandle || !fileHandle->mgmtInfo) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, 0, __LINE__);
+        return -1;
+    }
+    return (int)getMgmtInfo(fileHandle)->header.formatFlags;
+}
+
+// Returns the number of pages the file has disk space reserved for
+PageNumber getAllocatedPages(SM_FileHandle *fileHandle) {
+    if (!fileHandle || !fileHandle->mgmtInfo) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, 0, __LINE__);
+        return -1;
+    }
+    return getMgmtInfo(fileHandle)->allocatedPages;
+}
+
+// Replaces the extent growth policy used by ensureCapacity for files opened afterwards
+RC setExtentPolicy(SM_ExtentPolicy *policy) {
+    if (!policy || policy->initialExtentPages < 1 || policy->maxExtentPages < policy->initialExtentPages ||
+        policy->growthFactor < 1) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, 0, __LINE__);
+        return RC_INVALID_ARGUMENT;
+    }
+    extentPolicy = *policy;
+    return RC_OK;
+}
+
+// Returns the extent growth policy currently in effect
+void getExtentPolicy(SM_ExtentPolicy *policy) {
+    *policy = extentPolicy;
+}
+
+// Passes that recopy what was written meanwhile before writers are paused,
+// and the number of dirty blocks small enough to recopy while they are
+#define SM_BACKUP_MAX_PASSES 8
+#define SM_BACKUP_FINAL_BLOCKS 256
+#define SM_BACKUP_BUFFER_SIZE (1024 * 1024)
+
+// Copies a byte range between two files, in the kernel where both have a
+// descriptor (copy_file_range, else sendfile) and through a buffer otherwise;
+// stops early if the source ends first
+static RC copyFileRange(SM_BackendFile *source, SM_BackendFile *target, off_t offset, off_t length) {
+    int sourceFd = source->backend->descriptor(source);
+    int targetFd = target->backend->descriptor(target);
+    if (sourceFd != -1 && targetFd != -1) {
+        loff_t in = offset, out = offset;
+        while (length > 0) {
+            ssize_t copied = copy_file_range(sourceFd, &in, targetFd, &out, (size_t)length, 0);
+            if (copied == 0) {
+                return RC_OK;
+            }
+            if (copied < 0 && errno != EINTR) {
+                break;
+            }
+            if (copied > 0) {
+                length -= copied;
+            }
+        }
+        // across file systems or on older kernels sendfile still avoids the copy to user space
+        if (length > 0 && lseek(targetFd, in, SEEK_SET) == in) {
+            off_t position = in;
+            while (length > 0) {
+                ssize_t copied = sendfile(targetFd, sourceFd, &position, (size_t)length);
+                if (copied == 0) {
+                    return RC_OK;
+                }
+                if (copied < 0 && errno != EINTR) {
+                    break;
+                }
+                if (copied > 0) {
+                    length -= copied;
+                }
+            }
+            in = position;
+        }
+        offset = in;
+    }
+    if (length == 0) {
+        return RC_OK;
+    }
+
+    char *buffer = (char *)malloc(SM_BACKUP_BUFFER_SIZE);
+    if (!buffer) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_OUT_OF_MEMORY, 0, __LINE__);
+        return RC_WRITE_FAILED;
+    }
+    RC rc = RC_OK;
+    while (length > 0) {
+        size_t chunk = (length < SM_BACKUP_BUFFER_SIZE) ? (size_t)length : SM_BACKUP_BUFFER_SIZE;
+        ssize_t bytesRead = source->backend->pread(source, buffer, chunk, offset);
+        if (bytesRead <= 0) {
+            if (bytesRead < 0) {
+                TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+                rc = RC_READ_NON_EXISTING_PAGE;
+            }
+            break;
+        }
+        if (target->backend->pwrite(target, buffer, bytesRead, offset) != bytesRead) {
+            TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+            rc = RC_WRITE_FAILED;
+            break;
+        }
+        offset += bytesRead;
+        length -= bytesRead;
+    }
+    free(buffer);
+    return rc;
+}
+
+// Takes the blocks written since the previous call and copies them again,
+// in runs of adjacent blocks; sourceSize bounds what is still there to copy
+static RC recopyDirtyBlocks(SM_Backup *backup, SM_BackendFile *source, SM_BackendFile *target,
+                            off_t sourceSize, long *recopied) {
+    pthread_mutex_lock(&backup->lock);
+    size_t numBlocks = backup->numBlocks;
+    uint8_t *dirty = backup->dirty;
+    backup->dirty = (uint8_t *)calloc(numBlocks / 8 + 1, 1);
+    if (!backup->dirty) {
+        backup->dirty = dirty;
+        pthread_mutex_unlock(&backup->lock);
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_OUT_OF_MEMORY, 0, __LINE__);
+        return RC_WRITE_FAILED;
+    }
+    *recopied += backup->numDirty;
+    backup->numDirty = 0;
+    pthread_mutex_unlock(&backup->lock);
+
+    RC rc = RC_OK;
+    size_t block = 0;
+    while (block < numBlocks && rc == RC_OK) {
+        if (!(dirty[block / 8] & (1 << (block % 8)))) {
+            block++;
+            continue;
+        }
+        size_t run = 1;
+        while (block + run < numBlocks && (dirty[(block + run) / 8] & (1 << ((block + run) % 8)))) {
+            run++;
+        }
+        off_t offset = (off_t)block * SM_BACKUP_BLOCK_SIZE;
+        off_t end = (off_t)(block + run) * SM_BACKUP_BLOCK_SIZE;
+        if (end > sourceSize) {
+            end = sourceSize;
+        }
+        if (offset < end) {
+            rc = copyFileRange(source, target, offset, end - offset);
+        }
+        block += run;
+    }
+    free(dirty);
+    return rc;
+}
+
+// Attaches a backup to every open file of its path; the file cache lock
+// must be held
+static void attachBackup(const char *path, SM_Backup *backup) {
+    SM_CachedFile *entry;
+    for (entry = fileCache[pathBucket(path)]; entry != NULL; entry = entry->hashNext) {
+        if (strcmp(entry->path, path) == 0) {
+            pthread_rwlock_wrlock(&entry->writeLock);
+            entry->backup = backup;
+            pthread_rwlock_unlock(&entry->writeLock);
+        }
+    }
+}
+
+// Takes (lock 1) or gives back (lock 0) the write locks of every open file
+// of a path; the file cache lock must be held
+static void pauseWriters(const char *path, int lock) {
+    SM_CachedFile *entry;
+    for (entry = fileCache[pathBucket(path)]; entry != NULL; entry = entry->hashNext) {
+        if (strcmp(entry->path, path) == 0) {
+            if (lock) {
+                pthread_rwlock_wrlock(&entry->writeLock);
+            } else {
+                pthread_rwlock_unlock(&entry->writeLock);
+            }
+        }
+    }
+}
+
+// Saves what closePageFile would (the free-page bitmap, the page map of a
+// compressed file) while the handle stays open
+RC savePageFileMetadata(SM_FileHandle *fileHandle) {
+    if (!fileHandle || !fileHandle->mgmtInfo) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, 0, __LINE__);
+        return RC_FILE_HANDLE_NOT_INIT;
+    }
+    if (getMgmtInfo(fileHandle)->flags & SM_OPEN_READONLY) {
+        return RC_OK;
+    }
+    return saveMetadata(fileHandle);
+}
+
+// Copies a page file that may be in use to targetPath. The file is copied
+// whole, then the blocks written meanwhile are copied again until few are
+// left; those are copied with writers paused, so the copy shows the file as
+// it was at that moment. Metadata that open handles keep in memory (the
+// free-page bitmap, the page map of compressed files) is as last saved;
+// backupBufferPool saves it first. Striped files are not supported
+RC backupPageFile(char *sourcePath, char *targetPath) {
+    if (validateFilePath(sourcePath) != RC_OK || validateFilePath(targetPath) != RC_OK ||
+        strcmp(sourcePath, targetPath) == 0) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, 0, __LINE__);
+        return RC_INVALID_ARGUMENT;
+    }
+    SM_FileHandle source;
+    RC rc = openPageFileWithFlags(sourcePath, &source, SM_OPEN_READONLY);
+    if (rc != RC_OK) {
+        return rc;
+    }
+    SM_FileMgmtInfo *info = getMgmtInfo(&source);
+    if (info->stripes != NULL) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_INVALID_ARGUMENT, info->header.stripeCount, __LINE__);
+        closePageFile(&source);
+        return RC_INVALID_ARGUMENT;
+    }
+    SM_BackendFile *target = storageBackendFor(targetPath)->open(targetPath, O_RDWR | O_CREAT | O_TRUNC,
+                                                                  FILE_PERMISSIONS);
+    if (target == NULL) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+        closePageFile(&source);
+        return RC_FILE_NOT_FOUND;
+    }
+
+    SM_Backup *backup = (SM_Backup *)calloc(1, sizeof(SM_Backup));
+    if (!backup || !(backup->path = strdup(sourcePath))) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_OUT_OF_MEMORY, 0, __LINE__);
+        free(backup);
+        target->backend->close(target);
+        closePageFile(&source);
+        return RC_WRITE_FAILED;
+    }
+    pthread_mutex_init(&backup->lock, NULL);
+    pthread_mutex_lock(&fileCacheLock);
+    backup->next = activeBackups;
+    activeBackups = backup;
+    attachBackup(sourcePath, backup);
+    pthread_mutex_unlock(&fileCacheLock);
+
+    // first pass: the whole file, tracking covers it from here on
+    off_t sourceSize, reservedBytes;
+    long recopied = 0;
+    int pass = 0;
+    if (info->file->backend->size(info->file, &sourceSize, &reservedBytes) != 0) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+        rc = RC_FILE_NOT_FOUND;
+    } else {
+        markBackupRange(backup, 0, sourceSize);
+        rc = recopyDirtyBlocks(backup, info->file, target, sourceSize, &recopied);
+    }
+    recopied = 0;
+
+    // copy what was written meanwhile until little is left
+    while (rc == RC_OK && pass < SM_BACKUP_MAX_PASSES) {
+        pthread_mutex_lock(&backup->lock);
+        long numDirty = backup->numDirty;
+        pthread_mutex_unlock(&backup->lock);
+        if (numDirty <= SM_BACKUP_FINAL_BLOCKS ||
+            info->file->backend->size(info->file, &sourceSize, &reservedBytes) != 0) {
+            break;
+        }
+        rc = recopyDirtyBlocks(backup, info->file, target, sourceSize, &recopied);
+        pass++;
+    }
+
+    // the rest with writers paused, then the copy takes the file's size
+    pthread_mutex_lock(&fileCacheLock);
+    pauseWriters(sourcePath, 1);
+    if (rc == RC_OK) {
+        if (info->file->backend->size(info->file, &sourceSize, &reservedBytes) != 0) {
+            TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+            rc = RC_FILE_NOT_FOUND;
+        } else {
+            rc = recopyDirtyBlocks(backup, info->file, target, sourceSize, &recopied);
+        }
+    }
+    if (rc == RC_OK && target->backend->truncate(target, sourceSize) != 0) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+        rc = RC_WRITE_FAILED;
+    }
+    SM_CachedFile *entry;
+    for (entry = fileCache[pathBucket(sourcePath)]; entry != NULL; entry = entry->hashNext) {
+        if (strcmp(entry->path, sourcePath) == 0) {
+            entry->backup = NULL;
+        }
+    }
+    pauseWriters(sourcePath, 0);
+    SM_Backup **link = &activeBackups;
+    while (*link != backup) {
+        link = &(*link)->next;
+    }
+    *link = backup->next;
+    pthread_mutex_unlock(&fileCacheLock);
+    TRACE(TRACE_DEBUG, TRACE_CAT_STORAGE, TE_SM_BACKUP, traceHashName(sourcePath), recopied);
+
+    if (rc == RC_OK && target->backend->sync(target) != 0) {
+        TRACE(TRACE_ERROR, TRACE_CAT_STORAGE, TE_ERR_SYSCALL, errno, __LINE__);
+        rc = RC_WRITE_FAILED;
+    }
+    target->backend->close(target);
+    pthread_mutex_destroy(&backup->lock);
+    free(backup->dirty);
+    free(backup->path);
+    free(backup);
+    RC closeRc = closePageFile(&source);
+    return (rc == RC_OK) ? closeRc : rc;
+}
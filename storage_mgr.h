@@ -2,42 +2,177 @@
 #define STORAGE_MGR_H
 
 #include "dberror.h"
+#include "dt.h"
 
 /************************************************************
  *                    handle data structures                *
  ************************************************************/
 typedef struct SM_FileHandle {
 	char *fileName;
-	int totalNumPages;
-	int curPagePos;
+	PageNumber totalNumPages;
+	PageNumber curPagePos;
+	int pageSize;	/* bytes per page, fixed when the file was created */
 	void *mgmtInfo;
 } SM_FileHandle;
 
 typedef char* SM_PageHandle;
 
+/* file growth: every preallocated extent is growthFactor times the previous
+ * one, starting at initialExtentPages and capped at maxExtentPages */
+typedef struct SM_ExtentPolicy {
+	int initialExtentPages;
+	int maxExtentPages;
+	int growthFactor;
+} SM_ExtentPolicy;
+
+/* format options for createPageFileWithOptions, recorded in the file header */
+#define SM_FILE_CHECKSUM 0x1	/* CRC32C per page, stamped on write and verified on read */
+#define SM_FILE_COMPRESSED 0x2	/* pages stored compressed in variable-size slots; the
+				 * page map is saved by closePageFile and syncs, and a
+				 * crash reopens the file as of the last save */
+#define SM_FILE_STRIPED 0x4	/* set by createStripedPageFile; not a valid option */
+
+/* striped files spread their pages over up to SM_MAX_STRIPES ordinary page
+ * files in extents of a fixed number of pages */
+#define SM_MAX_STRIPES 64
+
+/* on SM_FILE_CHECKSUM files the last PAGE_CHECKSUM_SIZE bytes of every page
+ * are owned by the storage manager; writeBlock overwrites them in the caller's
+ * buffer */
+#define PAGE_CHECKSUM_SIZE 4
+
+/* page sizes a file can be created with (powers of two); files without a
+ * recorded size use PAGE_SIZE */
+#define SM_MIN_PAGE_SIZE 4096
+#define SM_MAX_PAGE_SIZE 65536
+
+typedef struct SM_FileOptions {
+	int flags;	/* SM_FILE_* */
+	int pageSize;	/* 0 for PAGE_SIZE */
+} SM_FileOptions;
+
+/* flags for openPageFileWithFlags */
+#define SM_OPEN_DEFAULT 0x0
+#define SM_OPEN_READONLY 0x1	/* reject writes and growth */
+#define SM_OPEN_MMAP 0x2	/* serve pages from a shared mapping of the file */
+#define SM_OPEN_DIRECT 0x4	/* bypass the kernel page cache (O_DIRECT) */
+
+/* file names starting with "mem:" are kept by the in-memory backend: no
+ * system calls, no file on disk, contents kept until destroyPageFile; they
+ * cannot be opened with SM_OPEN_MMAP (see storage_backend.h) */
+#define SM_MEMORY_PREFIX "mem:"
+
+/* "slow:<name>" opens <name> through a backend that injects latency, for
+ * measuring behaviour on slow disks (setSlowBackendConfig) */
+#define SM_SLOW_PREFIX "slow:"
+
+/* read pattern of a handle (getReadAheadStats); sequential runs are read
+ * ahead with posix_fadvise(WILLNEED), random access sets FADV_RANDOM */
+typedef struct SM_ReadAheadStats {
+	long sequentialReads;	/* reads that continued the previous one */
+	long randomReads;	/* reads that did not */
+	long readAheadPages;	/* pages advised to the kernel ahead of the reader */
+	long readAheadHits;	/* advised pages that were read afterwards */
+} SM_ReadAheadStats;
+
+/* SM_OPEN_DIRECT handles only accept page buffers aligned to this boundary */
+#define SM_DIRECT_IO_ALIGNMENT 4096
+
+/* when writes on a handle reach stable storage (setDurabilityMode) */
+typedef enum SM_DurabilityMode {
+	SM_DURABILITY_NONE = 0,		/* left to the kernel; syncPageFile does nothing */
+	SM_DURABILITY_PER_WRITE = 1,	/* every writeBlock/writeBlocks returns after fdatasync */
+	SM_DURABILITY_GROUP_COMMIT = 2	/* concurrent syncPageFile calls share one fdatasync */
+} SM_DurabilityMode;
+
+/* open files are shared by handles on the same path and open mode, and kept
+ * open after their last closePageFile until more than the cache limit
+ * (setFileCacheLimit) are open; files in use are never closed */
+#define SM_DEFAULT_FILE_CACHE_LIMIT 64
+
+typedef struct SM_FileCacheStats {
+	long hits;		/* opens served by an already open file */
+	long misses;		/* opens that had to open the file */
+	long evictions;		/* idle files closed to stay within the limit */
+	int openFiles;		/* files currently held open */
+} SM_FileCacheStats;
+
 /************************************************************
  *                    interface                             *
  ************************************************************/
 /* manipulating page files */
 extern void initStorageManager (void);
 extern RC createPageFile (char *fileName);
+extern RC createPageFileWithOptions (char *fileName, SM_FileOptions *options);
+extern RC createStripedPageFile (char *fileName, char **stripeFileNames, int numStripes, int extentPages,
+		SM_FileOptions *options);
 extern RC openPageFile (char *fileName, SM_FileHandle *fHandle);
+extern RC openPageFileWithFlags (char *fileName, SM_FileHandle *fHandle, int flags);
 extern RC closePageFile (SM_FileHandle *fHandle);
 extern RC destroyPageFile (char *fileName);
 
 /* reading blocks from disc */
-extern RC readBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
-extern int getBlockPos (SM_FileHandle *fHandle);
+extern RC readBlock (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
+extern PageNumber getBlockPos (SM_FileHandle *fHandle);
 extern RC readFirstBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readPreviousBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readNextBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readLastBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 
+/* vectored access to count consecutive pages; buffers that are adjacent in
+ * memory (e.g. slices of one contiguous allocation) are merged into a single
+ * I/O vector */
+extern RC readBlocks (PageNumber firstPage, int count, SM_FileHandle *fHandle, SM_PageHandle *memPages);
+extern RC writeBlocks (PageNumber firstPage, int count, SM_FileHandle *fHandle, SM_PageHandle *memPages);
+
+/* zero-copy access for SM_OPEN_MMAP handles; the pointer stays valid until
+ * the file grows or is closed */
+extern RC getBlockPointer (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle *page);
+
 /* writing blocks to a page file */
-extern RC writeBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
+extern RC writeBlock (PageNumber pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
+extern RC writeFirstBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC writeCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC appendEmptyBlock (SM_FileHandle *fHandle);
-extern RC ensureCapacity (int numberOfPages, SM_FileHandle *fHandle);
+extern RC ensureCapacity (PageNumber numberOfPages, SM_FileHandle *fHandle);
+/* picks up pages other handles appended to a plain page file */
+extern RC refreshPageFile (SM_FileHandle *fHandle);
+/* SM_FILE_* flags the file was created with, or -1 for an invalid handle */
+extern int getPageFileFormat (SM_FileHandle *fHandle);
+
+/* page reuse: files keep a free-page bitmap in their header page, saved by
+ * closePageFile; allocatePage prefers the next free page after the previous
+ * allocation and appends when none is left */
+extern RC allocatePage (SM_FileHandle *fHandle, PageNumber *pageNum);
+extern RC freePage (PageNumber pageNum, SM_FileHandle *fHandle);
+extern int isPageAllocated (PageNumber pageNum, SM_FileHandle *fHandle);
+
+/* durability: closePageFile also syncs unless the mode is SM_DURABILITY_NONE.
+ * Group commit batches the fdatasync calls of threads syncing one handle;
+ * other threads may read, write, grow and allocate on the handle meanwhile */
+extern RC setDurabilityMode (SM_FileHandle *fHandle, SM_DurabilityMode mode, int maxWaitMicros);
+extern RC syncPageFile (SM_FileHandle *fHandle);
+extern long getSyncCount (SM_FileHandle *fHandle);
+
+extern RC getReadAheadStats (SM_FileHandle *fHandle, SM_ReadAheadStats *stats);
+
+extern RC setFileCacheLimit (int maxOpenFiles);
+extern void getFileCacheStats (SM_FileCacheStats *stats);
+
+/* online backup: copies a page file that stays in use, in the kernel
+ * (copy_file_range or sendfile) where possible, copying blocks written during
+ * the copy again; the result is the file as of the end of the backup, with
+ * the metadata open handles last saved (savePageFileMetadata) */
+extern RC backupPageFile (char *fileName, char *backupFileName);
+extern RC savePageFileMetadata (SM_FileHandle *fHandle);
+
+/* preallocation: totalNumPages is the logical size, getAllocatedPages the
+ * number of pages with disk space already reserved; growing by more than
+ * maxExtentPages at once reserves nothing and leaves the new range sparse,
+ * so getAllocatedPages can then be below totalNumPages */
+extern PageNumber getAllocatedPages (SM_FileHandle *fHandle);
+extern RC setExtentPolicy (SM_ExtentPolicy *policy);
+extern void getExtentPolicy (SM_ExtentPolicy *policy);
 
 #endif
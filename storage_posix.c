@@ -0,0 +1,116 @@
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+
+#include "storage_backend.h"
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+
+// Page files kept in the file system, one descriptor per open file
+typedef struct PosixFile {
+    SM_BackendFile base;
+    int fd;
+} PosixFile;
+
+static int posixDescriptor(SM_BackendFile *file) {
+    return ((PosixFile *)file)->fd;
+}
+
+static SM_BackendFile *posixOpen(const char *path, int openFlags, mode_t mode) {
+    PosixFile *file = (PosixFile *)malloc(sizeof(PosixFile));
+    if (!file) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    file->fd = open(path, openFlags, mode);
+    if (file->fd == -1) {
+        int savedErrno = errno;
+        free(file);
+        errno = savedErrno;
+        return NULL;
+    }
+    file->base.backend = &posixBackend;
+    return &file->base;
+}
+
+static int posixClose(SM_BackendFile *file) {
+    int result = close(posixDescriptor(file));
+    free(file);
+    return result;
+}
+
+static int posixUnlink(const char *path) {
+    return unlink(path);
+}
+
+static int posixExists(const char *path) {
+    return access(path, F_OK) == 0;
+}
+
+static ssize_t posixPread(SM_BackendFile *file, void *buffer, size_t length, off_t offset) {
+    return pread(posixDescriptor(file), buffer, length, offset);
+}
+
+static ssize_t posixPwrite(SM_BackendFile *file, const void *buffer, size_t length, off_t offset) {
+    return pwrite(posixDescriptor(file), buffer, length, offset);
+}
+
+static ssize_t posixPreadv(SM_BackendFile *file, const struct iovec *iov, int iovcnt, off_t offset) {
+    return preadv(posixDescriptor(file), iov, iovcnt, offset);
+}
+
+static ssize_t posixPwritev(SM_BackendFile *file, const struct iovec *iov, int iovcnt, off_t offset) {
+    return pwritev(posixDescriptor(file), iov, iovcnt, offset);
+}
+
+static int posixSize(SM_BackendFile *file, off_t *size, off_t *allocated) {
+    struct stat fileStats;
+    if (fstat(posixDescriptor(file), &fileStats) != 0) {
+        return -1;
+    }
+    *size = fileStats.st_size;
+    *allocated = (off_t)fileStats.st_blocks * 512;
+    return 0;
+}
+
+static int posixTruncate(SM_BackendFile *file, off_t size) {
+    return ftruncate(posixDescriptor(file), size);
+}
+
+static int posixAllocate(SM_BackendFile *file, off_t offset, off_t length) {
+    return fallocate(posixDescriptor(file), FALLOC_FL_KEEP_SIZE, offset, length);
+}
+
+static int posixSync(SM_BackendFile *file) {
+    return fdatasync(posixDescriptor(file));
+}
+
+static int posixAdvise(SM_BackendFile *file, off_t offset, off_t length, int advice) {
+    // posix_fadvise reports errors as its result rather than through errno
+    int result = posix_fadvise(posixDescriptor(file), offset, length, advice);
+    if (result != 0) {
+        errno = result;
+        return -1;
+    }
+    return 0;
+}
+
+const SM_Backend posixBackend = {
+    "",
+    posixOpen,
+    posixClose,
+    posixUnlink,
+    posixExists,
+    posixPread,
+    posixPwrite,
+    posixPreadv,
+    posixPwritev,
+    posixSize,
+    posixTruncate,
+    posixAllocate,
+    posixSync,
+    posixAdvise,
+    posixDescriptor,
+};
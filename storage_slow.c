@@ -0,0 +1,240 @@
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+
+#include "storage_backend.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+// Latency-injecting wrapper ("slow:<name>"): the real work is done by the
+// backend serving <name>, then the caller waits until the simulated device
+// would have finished. Transfers first queue for a link of the configured
+// bandwidth, then take their latency, so total time is the larger of the
+// real and the simulated one
+#define SLOW_PREFIX "slow:"
+
+typedef struct SlowFile {
+    SM_BackendFile base;
+    SM_BackendFile *inner;
+} SlowFile;
+
+typedef enum SlowOp { SLOW_READ, SLOW_WRITE, SLOW_SYNC } SlowOp;
+
+// Shared by every slow file, guarded by slowLock
+static pthread_mutex_t slowLock = PTHREAD_MUTEX_INITIALIZER;
+static SM_SlowBackendConfig slowConfig;
+static SM_SlowBackendStats slowStats;
+static uint64_t randomState = 1;
+static int64_t linkFreeAt;   // microseconds on CLOCK_MONOTONIC when the link is idle
+
+static int64_t nowMicros(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+// xorshift64*, reproducible from the configured seed; slowLock must be held
+static double nextRandom(void) {
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return (double)((randomState * 0x2545F4914F6CDD1DULL) >> 11) / (double)(1ULL << 53);
+}
+
+// Draws one latency around mean; slowLock must be held
+static int64_t drawLatency(long mean) {
+    double latency = mean;
+    if (slowConfig.distribution == SM_LATENCY_UNIFORM) {
+        latency += (2 * nextRandom() - 1) * slowConfig.jitterMicros;
+    } else if (slowConfig.distribution == SM_LATENCY_NORMAL) {
+        // the sum of twelve uniforms is close to normal without needing libm
+        double sum = 0;
+        for (int i = 0; i < 12; i++) {
+            sum += nextRandom();
+        }
+        latency += (sum - 6) * slowConfig.jitterMicros;
+    }
+    return latency > 0 ? (int64_t)latency : 0;
+}
+
+// Books an operation of length bytes and returns when it completes
+static int64_t scheduleOp(SlowOp op, size_t length) {
+    pthread_mutex_lock(&slowLock);
+    int64_t now = nowMicros();
+    int64_t done = now;
+    if (op != SLOW_SYNC && slowConfig.bandwidthBytesPerSec > 0) {
+        int64_t start = (linkFreeAt > now) ? linkFreeAt : now;
+        linkFreeAt = start + (int64_t)((double)length * 1000000 / slowConfig.bandwidthBytesPerSec);
+        done = linkFreeAt;
+    }
+    if (op == SLOW_READ) {
+        done += drawLatency(slowConfig.readLatencyMicros);
+        slowStats.reads++;
+    } else if (op == SLOW_WRITE) {
+        done += drawLatency(slowConfig.writeLatencyMicros);
+        slowStats.writes++;
+    } else {
+        done += drawLatency(slowConfig.syncLatencyMicros);
+        slowStats.syncs++;
+    }
+    if (slowConfig.slowFraction > 0 && nextRandom() < slowConfig.slowFraction) {
+        done += slowConfig.slowLatencyMicros;
+        slowStats.slowIOs++;
+    }
+    slowStats.delayMicros += done - now;
+    pthread_mutex_unlock(&slowLock);
+    return done;
+}
+
+static void waitUntil(int64_t deadline) {
+    struct timespec until = { deadline / 1000000, (deadline % 1000000) * 1000 };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) == EINTR) {
+    }
+}
+
+// Replaces the configuration of all slow files and clears the statistics
+void setSlowBackendConfig(const SM_SlowBackendConfig *config) {
+    pthread_mutex_lock(&slowLock);
+    if (config != NULL) {
+        slowConfig = *config;
+    } else {
+        memset(&slowConfig, 0, sizeof(slowConfig));
+    }
+    memset(&slowStats, 0, sizeof(slowStats));
+    randomState = slowConfig.seed ? slowConfig.seed : 1;
+    linkFreeAt = 0;
+    pthread_mutex_unlock(&slowLock);
+}
+
+// Returns the operations and delay injected since the last configuration
+void getSlowBackendStats(SM_SlowBackendStats *stats) {
+    pthread_mutex_lock(&slowLock);
+    *stats = slowStats;
+    pthread_mutex_unlock(&slowLock);
+}
+
+static SM_BackendFile *innerOf(SM_BackendFile *file) {
+    return ((SlowFile *)file)->inner;
+}
+
+static const char *innerPath(const char *path) {
+    return path + strlen(SLOW_PREFIX);
+}
+
+static SM_BackendFile *slowOpen(const char *path, int openFlags, mode_t mode) {
+    SlowFile *file = (SlowFile *)malloc(sizeof(SlowFile));
+    if (!file) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    file->inner = storageBackendFor(innerPath(path))->open(innerPath(path), openFlags, mode);
+    if (file->inner == NULL) {
+        int savedErrno = errno;
+        free(file);
+        errno = savedErrno;
+        return NULL;
+    }
+    file->base.backend = &slowBackend;
+    return &file->base;
+}
+
+static int slowClose(SM_BackendFile *file) {
+    SM_BackendFile *inner = innerOf(file);
+    free(file);
+    return inner->backend->close(inner);
+}
+
+static int slowUnlink(const char *path) {
+    return storageBackendFor(innerPath(path))->unlink(innerPath(path));
+}
+
+static int slowExists(const char *path) {
+    return storageBackendFor(innerPath(path))->exists(innerPath(path));
+}
+
+static ssize_t slowPread(SM_BackendFile *file, void *buffer, size_t length, off_t offset) {
+    int64_t deadline = scheduleOp(SLOW_READ, length);
+    ssize_t result = innerOf(file)->backend->pread(innerOf(file), buffer, length, offset);
+    waitUntil(deadline);
+    return result;
+}
+
+static ssize_t slowPwrite(SM_BackendFile *file, const void *buffer, size_t length, off_t offset) {
+    int64_t deadline = scheduleOp(SLOW_WRITE, length);
+    ssize_t result = innerOf(file)->backend->pwrite(innerOf(file), buffer, length, offset);
+    waitUntil(deadline);
+    return result;
+}
+
+static size_t vectorLength(const struct iovec *iov, int iovcnt) {
+    size_t length = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        length += iov[i].iov_len;
+    }
+    return length;
+}
+
+// A vectored transfer is one request to the device: one latency for all pages
+static ssize_t slowPreadv(SM_BackendFile *file, const struct iovec *iov, int iovcnt, off_t offset) {
+    int64_t deadline = scheduleOp(SLOW_READ, vectorLength(iov, iovcnt));
+    ssize_t result = innerOf(file)->backend->preadv(innerOf(file), iov, iovcnt, offset);
+    waitUntil(deadline);
+    return result;
+}
+
+static ssize_t slowPwritev(SM_BackendFile *file, const struct iovec *iov, int iovcnt, off_t offset) {
+    int64_t deadline = scheduleOp(SLOW_WRITE, vectorLength(iov, iovcnt));
+    ssize_t result = innerOf(file)->backend->pwritev(innerOf(file), iov, iovcnt, offset);
+    waitUntil(deadline);
+    return result;
+}
+
+static int slowSize(SM_BackendFile *file, off_t *size, off_t *allocated) {
+    return innerOf(file)->backend->size(innerOf(file), size, allocated);
+}
+
+static int slowTruncate(SM_BackendFile *file, off_t size) {
+    return innerOf(file)->backend->truncate(innerOf(file), size);
+}
+
+static int slowAllocate(SM_BackendFile *file, off_t offset, off_t length) {
+    return innerOf(file)->backend->allocate(innerOf(file), offset, length);
+}
+
+static int slowSync(SM_BackendFile *file) {
+    int64_t deadline = scheduleOp(SLOW_SYNC, 0);
+    int result = innerOf(file)->backend->sync(innerOf(file));
+    waitUntil(deadline);
+    return result;
+}
+
+static int slowAdvise(SM_BackendFile *file, off_t offset, off_t length, int advice) {
+    return innerOf(file)->backend->advise(innerOf(file), offset, length, advice);
+}
+
+// A mapping would reach the pages without passing through the delays
+static int slowDescriptor(SM_BackendFile *file) {
+    (void)file;
+    return -1;
+}
+
+const SM_Backend slowBackend = {
+    SLOW_PREFIX,
+    slowOpen,
+    slowClose,
+    slowUnlink,
+    slowExists,
+    slowPread,
+    slowPwrite,
+    slowPreadv,
+    slowPwritev,
+    slowSize,
+    slowTruncate,
+    slowAllocate,
+    slowSync,
+    slowAdvise,
+    slowDescriptor,
+};
@@ -0,0 +1,1389 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "storage_mgr.h"
+#include "storage_backend.h"
+#include "buffer_mgr.h"
+#include "buffer_mgr_stat.h"
+#include "dberror.h"
+#include "trace.h"
+#include "checksum.h"
+#include "test_helper.h"
+
+// test name
+char *testName;
+
+/* test output files */
+#define TESTPF "test_pagefile.bin"
+
+/* prototypes for test functions */
+static void testCreateOpenClose(void);
+static void testSinglePageContent(void);
+static void testMappedPageFile(void);
+static void testMultiBlockIO(void);
+static void testExtentGrowth(void);
+static void testDirectIO(void);
+static void testPageChecksums(void);
+static void testPageCompression(void);
+static void testCompressedCrashSafety(void);
+static void testFreePageReuse(void);
+static void testStripedPageFile(void);
+static void testGroupCommit(void);
+static void testGroupCommitWithWriters(void);
+static void testLargeSparseFile(void);
+static void testPageSizes(void);
+static void testReadAhead(void);
+static void testMemoryBackend(void);
+static void testSlowBackend(void);
+static void testFileCache(void);
+static void testOnlineBackup(void);
+static void testSharedBufferPool(void);
+static void testSharedPoolAppend(void);
+#ifdef DB_TRACE
+static void testTraceRing(void);
+#endif
+
+/* main function running all tests */
+int
+main (void)
+{
+  testName = "";
+  
+  initStorageManager();
+
+  testCreateOpenClose();
+  testSinglePageContent();
+  testMappedPageFile();
+  testMultiBlockIO();
+  testExtentGrowth();
+  testDirectIO();
+  testPageChecksums();
+  testPageCompression();
+  testCompressedCrashSafety();
+  testFreePageReuse();
+  testStripedPageFile();
+  testGroupCommit();
+  testGroupCommitWithWriters();
+  testLargeSparseFile();
+  testPageSizes();
+  testReadAhead();
+  testMemoryBackend();
+  testSlowBackend();
+  testFileCache();
+  testOnlineBackup();
+  testSharedBufferPool();
+  testSharedPoolAppend();
+#ifdef DB_TRACE
+  testTraceRing();
+#endif
+
+  return 0;
+}
+
+
+/* check a return code. If it is not RC_OK then output a message, error description, and exit */
+/* Try to create, open, and close a page file */
+void
+testCreateOpenClose(void)
+{
+  SM_FileHandle fh;
+
+  testName = "test create open and close methods";
+
+  TEST_CHECK(createPageFile (TESTPF));
+  
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_TRUE(strcmp(fh.fileName, TESTPF) == 0, "filename correct");
+  ASSERT_TRUE((fh.totalNumPages == 1), "expect 1 page in new file");
+  ASSERT_TRUE((fh.curPagePos == 0), "freshly opened file's page position should be 0");
+
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+
+  // after destruction trying to open the file should cause an error
+  ASSERT_TRUE((openPageFile(TESTPF, &fh) != RC_OK), "opening non-existing file should return an error.");
+
+  TEST_DONE();
+}
+
+/* Try to create, open, and close a page file */
+void
+testSinglePageContent(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  int i;
+
+  testName = "test single page content";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  // create a new page file
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  printf("created and opened file\n");
+  
+  // read first page into handle
+  TEST_CHECK(readFirstBlock (&fh, ph));
+  // the page should be empty (zero bytes)
+  for (i=0; i < PAGE_SIZE; i++)
+    ASSERT_TRUE((ph[i] == 0), "expected zero byte in first page of freshly initialized page");
+  printf("first block was empty\n");
+    
+  // change ph to be a string and write that one to disk
+  for (i=0; i < PAGE_SIZE; i++)
+    ph[i] = (i % 10) + '0';
+  TEST_CHECK(writeBlock (0, &fh, ph));
+  printf("writing first block\n");
+
+  // read back the page containing the string and check that it is correct
+  TEST_CHECK(readFirstBlock (&fh, ph));
+  for (i=0; i < PAGE_SIZE; i++)
+    ASSERT_TRUE((ph[i] == (i % 10) + '0'), "character in page read from disk is the one we expected.");
+  printf("reading first block\n");
+
+  // destroy new page file
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));  
+  
+  free(ph);
+  TEST_DONE();
+}
+
+/* Write through a mapped handle, grow it and read pages back without copying */
+void
+testMappedPageFile(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  SM_PageHandle mapped;
+  int i;
+
+  testName = "test memory-mapped page file";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  for (i=0; i < PAGE_SIZE; i++)
+    ph[i] = (i % 26) + 'a';
+
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFileWithFlags (TESTPF, &fh, SM_OPEN_MMAP));
+
+  // grow the mapping and write the last page through it
+  TEST_CHECK(ensureCapacity (4, &fh));
+  ASSERT_EQUALS_INT(4, fh.totalNumPages, "mapped file grew to 4 pages");
+  TEST_CHECK(writeBlock (3, &fh, ph));
+  TEST_CHECK(getBlockPointer (3, &fh, &mapped));
+  ASSERT_TRUE(memcmp(mapped, ph, PAGE_SIZE) == 0, "mapped page shows written content");
+  TEST_CHECK(getBlockPointer (2, &fh, &mapped));
+  ASSERT_TRUE(mapped[0] == 0 && mapped[PAGE_SIZE - 1] == 0, "grown page is zeroed");
+  TEST_CHECK(closePageFile (&fh));
+
+  // a read-only mapping sees the data and rejects writes
+  TEST_CHECK(openPageFileWithFlags (TESTPF, &fh, SM_OPEN_MMAP | SM_OPEN_READONLY));
+  ASSERT_EQUALS_INT(4, fh.totalNumPages, "mapped file has 4 pages after reopen");
+  TEST_CHECK(getBlockPointer (3, &fh, &mapped));
+  ASSERT_TRUE(memcmp(mapped, ph, PAGE_SIZE) == 0, "read-only mapping shows persisted content");
+  ASSERT_ERROR(writeBlock (0, &fh, ph), "writing a read-only handle fails");
+  ASSERT_ERROR(ensureCapacity (5, &fh), "growing a read-only handle fails");
+  TEST_CHECK(closePageFile (&fh));
+
+  // plain handles cannot hand out mapped pointers
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_TRUE(getBlockPointer (0, &fh, &mapped) == RC_FILE_NOT_MAPPED, "unmapped handle has no block pointer");
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+
+  free(ph);
+  TEST_DONE();
+}
+
+/* Move several pages per call, with separate and with contiguous buffers */
+void
+testMultiBlockIO(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle pages[8];
+  SM_PageHandle contiguous;
+  int i, j;
+
+  testName = "test vectored multi-block read and write";
+
+  contiguous = (SM_PageHandle) malloc(PAGE_SIZE * 8);
+  for (i=0; i < 8; i++)
+    {
+      pages[i] = (SM_PageHandle) malloc(PAGE_SIZE);
+      memset(pages[i], 'A' + i, PAGE_SIZE);
+    }
+
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  TEST_CHECK(ensureCapacity (10, &fh));
+
+  // write pages 2..9 from separate buffers
+  TEST_CHECK(writeBlocks (2, 8, &fh, pages));
+  ASSERT_EQUALS_INT(9, getBlockPos(&fh), "position is on the last written page");
+  ASSERT_ERROR(writeBlocks (4, 8, &fh, pages), "writing past the end of the file fails");
+
+  // read them back into one contiguous buffer
+  for (i=0; i < 8; i++)
+    {
+      free(pages[i]);
+      pages[i] = contiguous + i * PAGE_SIZE;
+    }
+  memset(contiguous, 0, PAGE_SIZE * 8);
+  TEST_CHECK(readBlocks (2, 8, &fh, pages));
+  for (i=0; i < 8; i++)
+    for (j=0; j < PAGE_SIZE; j += 512)
+      ASSERT_TRUE(contiguous[i * PAGE_SIZE + j] == 'A' + i, "page content read back in order");
+
+  // relative reads follow the position left by the last read
+  TEST_CHECK(readBlock (5, &fh, contiguous));
+  TEST_CHECK(readNextBlock (&fh, contiguous));
+  ASSERT_TRUE(contiguous[0] == 'A' + 4, "next block after page 5 is page 6");
+  TEST_CHECK(readPreviousBlock (&fh, contiguous));
+  ASSERT_TRUE(contiguous[0] == 'A' + 3, "previous block is page 5");
+  TEST_CHECK(readCurrentBlock (&fh, contiguous));
+  ASSERT_TRUE(contiguous[0] == 'A' + 3, "current block is page 5");
+  TEST_CHECK(readLastBlock (&fh, contiguous));
+  ASSERT_TRUE(contiguous[0] == 'A' + 7, "last block is page 9");
+  ASSERT_ERROR(readNextBlock (&fh, contiguous), "reading beyond the last block fails");
+
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+
+  free(contiguous);
+  TEST_DONE();
+}
+
+/* Grow a file through ensureCapacity and appendEmptyBlock under an extent policy */
+void
+testExtentGrowth(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  SM_ExtentPolicy policy = { 4, 64, 2 };
+  SM_ExtentPolicy defaultPolicy;
+  PageNumber allocated;
+  int i;
+
+  testName = "test extent-based file growth";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  getExtentPolicy(&defaultPolicy);
+  ASSERT_ERROR(setExtentPolicy(&(SM_ExtentPolicy){ 8, 4, 2 }), "max extent below initial extent is rejected");
+  TEST_CHECK(setExtentPolicy(&policy));
+
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+
+  TEST_CHECK(appendEmptyBlock (&fh));
+  ASSERT_EQUALS_INT(2, fh.totalNumPages, "append grows the logical size by one page");
+  ASSERT_TRUE(getAllocatedPages(&fh) >= 2, "allocated size covers the logical size");
+
+  // a jump past the maximal extent is left sparse, later growth reserves again
+  allocated = getAllocatedPages(&fh);
+  TEST_CHECK(ensureCapacity (300, &fh));
+  ASSERT_EQUALS_INT(300, fh.totalNumPages, "logical size is exactly the requested size");
+  ASSERT_EQUALS_INT(allocated, getAllocatedPages(&fh), "a sparse jump reserves nothing");
+  TEST_CHECK(ensureCapacity (310, &fh));
+  ASSERT_EQUALS_INT(310, fh.totalNumPages, "file grows past the sparse range");
+  ASSERT_EQUALS_INT(allocated + 10, getAllocatedPages(&fh), "growth reserves an extent after the sparse range");
+
+  TEST_CHECK(readLastBlock (&fh, ph));
+  for (i=0; i < PAGE_SIZE; i++)
+    ASSERT_TRUE(ph[i] == 0, "grown page reads back as zeros");
+  TEST_CHECK(closePageFile (&fh));
+
+  // preallocated space beyond the end of file does not show up as pages
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_EQUALS_INT(310, fh.totalNumPages, "reopened file keeps its logical size");
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+
+  TEST_CHECK(setExtentPolicy(&defaultPolicy));
+  free(ph);
+  TEST_DONE();
+}
+
+/* Read and write around the page cache with aligned buffers */
+void
+testDirectIO(void)
+{
+  SM_FileHandle fh;
+  void *aligned;
+  SM_PageHandle pages[2];
+  int i;
+
+  testName = "test direct I/O page file";
+
+  ASSERT_TRUE(posix_memalign(&aligned, SM_DIRECT_IO_ALIGNMENT, 2 * PAGE_SIZE) == 0, "allocated aligned buffer");
+  for (i=0; i < 2 * PAGE_SIZE; i++)
+    ((char *) aligned)[i] = (i % 7) + 'a';
+
+  TEST_CHECK(createPageFile (TESTPF));
+  ASSERT_TRUE(openPageFileWithFlags (TESTPF, &fh, SM_OPEN_DIRECT | SM_OPEN_MMAP) == RC_INVALID_ARGUMENT,
+      "direct I/O cannot be combined with a mapping");
+  TEST_CHECK(openPageFileWithFlags (TESTPF, &fh, SM_OPEN_DIRECT));
+  TEST_CHECK(ensureCapacity (3, &fh));
+
+  pages[0] = (SM_PageHandle) aligned;
+  pages[1] = (SM_PageHandle) aligned + PAGE_SIZE;
+  TEST_CHECK(writeBlocks (1, 2, &fh, pages));
+  ASSERT_TRUE(writeBlock (0, &fh, (SM_PageHandle) aligned + 1) == RC_BUFFER_NOT_ALIGNED,
+      "unaligned buffer is rejected");
+
+  memset(aligned, 0, 2 * PAGE_SIZE);
+  TEST_CHECK(readBlock (2, &fh, (SM_PageHandle) aligned));
+  for (i=0; i < PAGE_SIZE; i++)
+    ASSERT_TRUE(((char *) aligned)[i] == ((i + PAGE_SIZE) % 7) + 'a', "direct read returns written page");
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+
+  free(aligned);
+  TEST_DONE();
+}
+
+/* Checksummed files detect a page that was changed behind the storage manager's back */
+void
+testPageChecksums(void)
+{
+  SM_FileHandle fh;
+  SM_FileOptions options = { SM_FILE_CHECKSUM };
+  SM_PageHandle ph;
+  FILE *raw;
+  int i;
+
+  testName = "test page checksums";
+
+  ASSERT_TRUE(crc32c("123456789", 9) == 0xE3069283, "crc32c check value");
+  ASSERT_TRUE(crc32cSoftware("123456789", 9) == 0xE3069283, "software crc32c check value");
+  printf("crc32c implementation: %s\n", crc32cImplementation());
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  for (i=0; i < PAGE_SIZE; i++)
+    ph[i] = (i % 10) + '0';
+  ASSERT_TRUE(crc32c(ph, PAGE_SIZE - 3) == crc32cSoftware(ph, PAGE_SIZE - 3), "implementations agree");
+
+  TEST_CHECK(createPageFileWithOptions (TESTPF, &options));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  TEST_CHECK(ensureCapacity (3, &fh));
+  TEST_CHECK(writeBlock (1, &fh, ph));
+  TEST_CHECK(readBlock (2, &fh, ph));
+  ASSERT_TRUE(ph[0] == 0, "never written page passes verification");
+  TEST_CHECK(readBlock (1, &fh, ph));
+  ASSERT_TRUE(ph[17] == '7', "checksummed page reads back");
+  TEST_CHECK(closePageFile (&fh));
+
+  // flip one byte of logical page 1 (the header page comes first)
+  raw = fopen(TESTPF, "r+b");
+  fseek(raw, 2 * PAGE_SIZE + 100, SEEK_SET);
+  fputc('X', raw);
+  fclose(raw);
+
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_TRUE(readBlock (1, &fh, ph) == RC_CHECKSUM_MISMATCH, "corrupted page is detected");
+  TEST_CHECK(readBlock (0, &fh, ph));
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+
+  free(ph);
+  TEST_DONE();
+}
+
+/* Compressed files hold the same pages in fewer bytes and survive reopening */
+void
+testPageCompression(void)
+{
+  SM_FileHandle fh;
+  SM_FileOptions options = { SM_FILE_COMPRESSED | SM_FILE_CHECKSUM };
+  SM_PageHandle ph;
+  struct stat st;
+  int i, j;
+
+  testName = "test page compression";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  TEST_CHECK(createPageFileWithOptions (TESTPF, &options));
+  ASSERT_TRUE(openPageFileWithFlags (TESTPF, &fh, SM_OPEN_MMAP) == RC_INVALID_ARGUMENT, "compressed files cannot be mapped");
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  TEST_CHECK(ensureCapacity (64, &fh));
+  for (i = 0; i < 64; i++)
+    {
+      for (j = 0; j < PAGE_SIZE; j++)
+        ph[j] = (j / 40 + i) % 26 + 'a';
+      TEST_CHECK(writeBlock (i, &fh, ph));
+    }
+
+  // a page that does not compress moves to a larger slot
+  for (j = 0; j < PAGE_SIZE; j++)
+    ph[j] = (char) ((j * 2654435761u) >> 13);
+  TEST_CHECK(writeBlock (5, &fh, ph));
+  TEST_CHECK(closePageFile (&fh));
+
+  ASSERT_TRUE(stat(TESTPF, &st) == 0 && st.st_size < 16 * PAGE_SIZE, "compressed file is smaller than its pages");
+
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_TRUE(fh.totalNumPages == 64, "page count survives reopening");
+  for (i = 0; i < 64; i += 9)
+    {
+      TEST_CHECK(readBlock (i, &fh, ph));
+      ASSERT_TRUE(ph[100] == (100 / 40 + i) % 26 + 'a', "compressed page reads back");
+    }
+  TEST_CHECK(readBlock (5, &fh, ph));
+  ASSERT_TRUE(ph[300] == (char) ((300 * 2654435761u) >> 13), "incompressible page reads back");
+  TEST_CHECK(appendEmptyBlock (&fh));
+  TEST_CHECK(readBlock (64, &fh, ph));
+  ASSERT_TRUE(ph[0] == 0 && ph[PAGE_SIZE - 1] == 0, "appended page reads as zeros");
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+
+  free(ph);
+  TEST_DONE();
+}
+
+/* A compressed file whose handle never saves again still opens as of the
+ * last save, and rewritten pages reuse the space of the slots they left */
+static void
+fillCompressiblePage(SM_PageHandle ph, int seed)
+{
+  int j;
+
+  for (j = 0; j < PAGE_SIZE; j++)
+    ph[j] = (j / 40 + seed) % 26 + 'a';
+}
+
+void
+testCompressedCrashSafety(void)
+{
+  SM_FileHandle fh, crashed;
+  SM_FileOptions options = { SM_FILE_COMPRESSED };
+  SM_PageHandle ph;
+  struct stat st;
+  int i, j, same = 1;
+
+  testName = "test compressed file crash safety";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  TEST_CHECK(createPageFileWithOptions (TESTPF, &options));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  TEST_CHECK(ensureCapacity (8, &fh));
+  for (i = 0; i < 8; i++)
+    {
+      fillCompressiblePage(ph, i);
+      TEST_CHECK(writeBlock (i, &fh, ph));
+    }
+  TEST_CHECK(savePageFileMetadata (&fh));
+
+  // later writes rewrite, move and add pages without saving the map
+  for (i = 0; i < 8; i++)
+    {
+      fillCompressiblePage(ph, i + 13);
+      TEST_CHECK(writeBlock (i, &fh, ph));
+    }
+  for (j = 0; j < PAGE_SIZE; j++)
+    ph[j] = (char) ((j * 2654435761u) >> 13);
+  TEST_CHECK(writeBlock (3, &fh, ph));
+  TEST_CHECK(ensureCapacity (12, &fh));
+  TEST_CHECK(writeBlock (10, &fh, ph));
+
+  // what a restart after a crash would find
+  TEST_CHECK(openPageFileWithFlags (TESTPF, &crashed, SM_OPEN_READONLY));
+  ASSERT_EQUALS_INT(8, crashed.totalNumPages, "page count is the saved one");
+  for (i = 0; i < 8; i++)
+    {
+      TEST_CHECK(readBlock (i, &crashed, ph));
+      same &= (ph[100] == (100 / 40 + i) % 26 + 'a');
+    }
+  ASSERT_TRUE(same, "saved pages read back unchanged");
+  TEST_CHECK(closePageFile (&crashed));
+
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_EQUALS_INT(12, fh.totalNumPages, "close saves the new page count");
+  TEST_CHECK(readBlock (1, &fh, ph));
+  ASSERT_TRUE(ph[100] == (100 / 40 + 14) % 26 + 'a', "close saves rewritten pages");
+  TEST_CHECK(readBlock (10, &fh, ph));
+  ASSERT_TRUE(ph[300] == (char) ((300 * 2654435761u) >> 13), "close saves added pages");
+
+  // a page switching between a small and a full slot does not leak the other
+  for (i = 0; i < 50; i++)
+    {
+      if (i % 2)
+        fillCompressiblePage(ph, i);
+      TEST_CHECK(writeBlock (0, &fh, ph));
+      TEST_CHECK(savePageFileMetadata (&fh));
+    }
+  TEST_CHECK(closePageFile (&fh));
+  ASSERT_TRUE(stat(TESTPF, &st) == 0 && st.st_size < 8 * PAGE_SIZE, "replaced slots are reused");
+  TEST_CHECK(destroyPageFile (TESTPF));
+
+  free(ph);
+  TEST_DONE();
+}
+
+/* Freed pages are handed out again before the file grows */
+void
+testFreePageReuse(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  PageNumber pageNum;
+  int i;
+
+  testName = "test free page reuse";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_TRUE(isPageAllocated (0, &fh), "first page starts allocated");
+  for (i = 1; i < 8; i++)
+    {
+      TEST_CHECK(allocatePage (&fh, &pageNum));
+      ASSERT_TRUE(pageNum == i, "allocation appends while nothing is free");
+    }
+
+  memset(ph, 'x', PAGE_SIZE);
+  TEST_CHECK(writeBlock (3, &fh, ph));
+  TEST_CHECK(freePage (3, &fh));
+  TEST_CHECK(freePage (4, &fh));
+  TEST_CHECK(freePage (6, &fh));
+  ASSERT_ERROR(freePage (4, &fh), "freeing a free page fails");
+  ASSERT_TRUE(!isPageAllocated (4, &fh), "freed page is not allocated");
+  TEST_CHECK(closePageFile (&fh));
+
+  // the bitmap survives reopening; the search starts over from the front
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_TRUE(!isPageAllocated (3, &fh) && isPageAllocated (5, &fh), "bitmap is persistent");
+  TEST_CHECK(allocatePage (&fh, &pageNum));
+  ASSERT_TRUE(pageNum == 3, "first free page is reused");
+  TEST_CHECK(readBlock (3, &fh, ph));
+  ASSERT_TRUE(ph[0] == 0 && ph[PAGE_SIZE - 1] == 0, "reused page reads as zeros");
+  TEST_CHECK(allocatePage (&fh, &pageNum));
+  ASSERT_TRUE(pageNum == 4, "next allocation continues after the previous one");
+  TEST_CHECK(allocatePage (&fh, &pageNum));
+  ASSERT_TRUE(pageNum == 6, "next fit skips allocated pages");
+  TEST_CHECK(allocatePage (&fh, &pageNum));
+  ASSERT_TRUE(pageNum == 8 && fh.totalNumPages == 9, "file grows once nothing is free");
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+
+  free(ph);
+  TEST_DONE();
+}
+
+/* A striped file spreads its pages over several files in whole extents */
+void
+testStripedPageFile(void)
+{
+  SM_FileHandle fh, stripe;
+  char *stripes[] = { "test_stripe0.bin", "test_stripe1.bin", "test_stripe2.bin" };
+  SM_PageHandle pages[30];
+  char *block;
+  int i;
+
+  testName = "test striped page file";
+
+  ASSERT_ERROR(createStripedPageFile (TESTPF, stripes, 0, 4, NULL), "a striped file needs stripes");
+  TEST_CHECK(createStripedPageFile (TESTPF, stripes, 3, 4, NULL));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_TRUE(fh.totalNumPages == 1, "striped file starts with one page");
+  TEST_CHECK(ensureCapacity (30, &fh));
+
+  block = (char *) malloc(30 * PAGE_SIZE);
+  for (i = 0; i < 30; i++)
+    {
+      pages[i] = block + i * PAGE_SIZE;
+      memset(pages[i], 'A' + i, PAGE_SIZE);
+    }
+  TEST_CHECK(writeBlocks (0, 30, &fh, pages));
+  TEST_CHECK(closePageFile (&fh));
+
+  // extents of 4 pages go round-robin: 0-3, 12-15, 24-27 land on stripe 0
+  TEST_CHECK(openPageFile (stripes[0], &stripe));
+  ASSERT_TRUE(stripe.totalNumPages == 12, "stripe holds its share of the pages");
+  TEST_CHECK(readBlock (5, &stripe, pages[0]));
+  ASSERT_TRUE(pages[0][0] == 'A' + 13, "extents go round-robin over the stripes");
+  TEST_CHECK(closePageFile (&stripe));
+
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_TRUE(fh.totalNumPages == 30, "page count survives reopening");
+  TEST_CHECK(readBlocks (2, 20, &fh, pages));
+  for (i = 0; i < 20; i++)
+    ASSERT_TRUE(pages[i][PAGE_SIZE - 1] == 'A' + 2 + i, "vectored read crosses stripes");
+  TEST_CHECK(readBlock (29, &fh, pages[0]));
+  ASSERT_TRUE(pages[0][0] == 'A' + 29, "single page read is routed");
+  TEST_CHECK(closePageFile (&fh));
+
+  TEST_CHECK(destroyPageFile (TESTPF));
+  ASSERT_TRUE(openPageFile (stripes[1], &stripe) == RC_FILE_NOT_FOUND, "stripes are destroyed with the file");
+
+  free(block);
+  TEST_DONE();
+}
+
+/* Concurrent commits in group commit mode share fdatasync calls */
+static void *
+commitThread(void *arg)
+{
+  return (void *) (long) syncPageFile ((SM_FileHandle *) arg);
+}
+
+void
+testGroupCommit(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  pthread_t threads[8];
+  void *result;
+  long before;
+  int i, failed = 0;
+
+  testName = "test group commit";
+
+  ph = (SM_PageHandle) calloc(1, PAGE_SIZE);
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  TEST_CHECK(ensureCapacity (4, &fh));
+
+  TEST_CHECK(syncPageFile (&fh));
+  ASSERT_TRUE(getSyncCount (&fh) == 0, "no syncs without a durability mode");
+  ASSERT_ERROR(setDurabilityMode (&fh, SM_DURABILITY_GROUP_COMMIT, -1), "negative wait is rejected");
+
+  TEST_CHECK(setDurabilityMode (&fh, SM_DURABILITY_PER_WRITE, 0));
+  for (i = 0; i < 3; i++)
+    TEST_CHECK(writeBlock (i, &fh, ph));
+  ASSERT_TRUE(getSyncCount (&fh) == 3, "every write is synced");
+
+  TEST_CHECK(setDurabilityMode (&fh, SM_DURABILITY_GROUP_COMMIT, 20000));
+  TEST_CHECK(writeBlock (3, &fh, ph));
+  ASSERT_TRUE(getSyncCount (&fh) == 3, "group commit writes are not synced");
+  before = getSyncCount (&fh);
+  for (i = 0; i < 8; i++)
+    pthread_create(&threads[i], NULL, commitThread, &fh);
+  for (i = 0; i < 8; i++)
+    {
+      pthread_join(threads[i], &result);
+      failed |= (result != NULL);
+    }
+  ASSERT_TRUE(!failed, "every committer succeeds");
+  ASSERT_TRUE(getSyncCount (&fh) - before >= 1 && getSyncCount (&fh) - before < 8, "committers share syncs");
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+
+  free(ph);
+  TEST_DONE();
+}
+
+/* Writers allocate, write and free pages while other threads commit; the
+ * free-page bitmap the sync leaders save stays consistent with them */
+#define COMMIT_FILE_PAGES 64
+#define COMMIT_FREE_PAGES 8
+#define COMMIT_ROUNDS 500
+
+static void *
+allocateThread(void *arg)
+{
+  SM_FileHandle *fh = (SM_FileHandle *) arg;
+  SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  PageNumber page;
+  long failed = 0;
+  int i;
+
+  memset(ph, 'W', PAGE_SIZE);
+  for (i = 0; i < COMMIT_ROUNDS; i++)
+    {
+      failed |= (allocatePage (fh, &page) != RC_OK);
+      failed |= (writeBlock (page, fh, ph) != RC_OK);
+      failed |= (freePage (page, fh) != RC_OK);
+    }
+  free(ph);
+  return (void *) failed;
+}
+
+static void *
+repeatCommitThread(void *arg)
+{
+  long failed = 0;
+  int i;
+
+  for (i = 0; i < COMMIT_ROUNDS / 10; i++)
+    failed |= (syncPageFile ((SM_FileHandle *) arg) != RC_OK);
+  return (void *) failed;
+}
+
+void
+testGroupCommitWithWriters(void)
+{
+  SM_FileHandle fh;
+  pthread_t writers[4], committers[4];
+  void *result;
+  int i, numFree = 0, failed = 0;
+
+  testName = "test group commit with concurrent writers";
+
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  TEST_CHECK(ensureCapacity (COMMIT_FILE_PAGES, &fh));
+  // more free pages than writers, so allocatePage never grows the file
+  for (i = 1; i <= COMMIT_FREE_PAGES; i++)
+    TEST_CHECK(freePage (i, &fh));
+  TEST_CHECK(setDurabilityMode (&fh, SM_DURABILITY_GROUP_COMMIT, 100));
+
+  for (i = 0; i < 4; i++)
+    {
+      pthread_create(&writers[i], NULL, allocateThread, &fh);
+      pthread_create(&committers[i], NULL, repeatCommitThread, &fh);
+    }
+  for (i = 0; i < 4; i++)
+    {
+      pthread_join(writers[i], &result);
+      failed |= (result != NULL);
+      pthread_join(committers[i], &result);
+      failed |= (result != NULL);
+    }
+  ASSERT_TRUE(!failed, "writers and committers succeed side by side");
+  ASSERT_EQUALS_INT(COMMIT_FILE_PAGES, fh.totalNumPages, "writers reuse the free pages");
+  TEST_CHECK(syncPageFile (&fh));
+  TEST_CHECK(closePageFile (&fh));
+
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  for (i = 0; i < fh.totalNumPages; i++)
+    numFree += !isPageAllocated (i, &fh);
+  ASSERT_EQUALS_INT(COMMIT_FREE_PAGES, numFree, "saved bitmap holds the pages the writers freed");
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+
+  TEST_DONE();
+}
+
+/* Pages past the 2 GB and 4 GB offsets land where they belong in a sparse file */
+void
+testLargeSparseFile(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph, pages[4];
+  struct stat st;
+  PageNumber past2GB = ((PageNumber) 1 << 31) / PAGE_SIZE + 3;
+  PageNumber past4GB = ((PageNumber) 1 << 32) / PAGE_SIZE + 5;
+  int i;
+
+  testName = "test large sparse file";
+
+  ph = (SM_PageHandle) malloc(4 * PAGE_SIZE);
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  TEST_CHECK(ensureCapacity (past4GB + 8, &fh));
+
+  memset(ph, 'g', PAGE_SIZE);
+  TEST_CHECK(writeBlock (past2GB, &fh, ph));
+  for (i = 0; i < 4; i++)
+    {
+      pages[i] = ph + i * PAGE_SIZE;
+      memset(pages[i], 'k' + i, PAGE_SIZE);
+    }
+  TEST_CHECK(writeBlocks (past4GB - 2, 4, &fh, pages));
+  TEST_CHECK(closePageFile (&fh));
+
+  ASSERT_TRUE(stat(TESTPF, &st) == 0 && st.st_size == (off_t) (past4GB + 9) * PAGE_SIZE, "file size covers the last page");
+  ASSERT_TRUE((off_t) st.st_blocks * 512 < (off_t) 64 * 1024 * 1024, "skipped range stays sparse");
+
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_EQUALS_INT(past4GB + 8, fh.totalNumPages, "page count beyond 4 GB");
+  TEST_CHECK(readBlock (past2GB, &fh, ph));
+  ASSERT_TRUE(ph[0] == 'g' && ph[PAGE_SIZE - 1] == 'g', "page past 2 GB reads back");
+  TEST_CHECK(readBlock (past2GB - 1, &fh, ph));
+  ASSERT_TRUE(ph[0] == 0, "neighbour past 2 GB is untouched");
+  TEST_CHECK(readBlocks (past4GB - 2, 4, &fh, pages));
+  for (i = 0; i < 4; i++)
+    ASSERT_TRUE(pages[i][17] == 'k' + i, "pages around 4 GB read back");
+  ASSERT_EQUALS_INT(past4GB + 1, getBlockPos (&fh), "position is 64-bit");
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+
+  free(ph);
+  TEST_DONE();
+}
+
+/* Files keep the page size they were created with, and the buffer pool follows it */
+void
+testPageSizes(void)
+{
+  SM_FileHandle fh;
+  SM_FileOptions badSize = { 0, 6000 };
+  SM_FileOptions stripedFlag = { SM_FILE_STRIPED, 0 };
+  SM_FileOptions unknownFlag = { SM_FILE_CHECKSUM | 0x100, 0 };
+  SM_FileOptions bigPages = { SM_FILE_CHECKSUM, 32768 };
+  SM_FileOptions compressedPages = { SM_FILE_COMPRESSED, 65536 };
+  SM_PageHandle ph, pages[3];
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  struct stat st;
+  char *content;
+  int i;
+
+  testName = "test per-file page size";
+
+  ASSERT_ERROR(createPageFileWithOptions (TESTPF, &badSize), "page size must be a power of two");
+  ASSERT_EQUALS_INT(RC_INVALID_ARGUMENT, createPageFileWithOptions (TESTPF, &stripedFlag),
+                    "striping is not a creation option");
+  ASSERT_EQUALS_INT(RC_INVALID_ARGUMENT, createPageFileWithOptions (TESTPF, &unknownFlag),
+                    "unknown format flags are rejected");
+
+  ph = (SM_PageHandle) malloc(3 * 65536);
+  TEST_CHECK(createPageFileWithOptions (TESTPF, &bigPages));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_EQUALS_INT(32768, fh.pageSize, "handle reports the page size");
+  TEST_CHECK(ensureCapacity (3, &fh));
+  for (i = 0; i < 3; i++)
+    {
+      pages[i] = ph + i * 32768;
+      memset(pages[i], 'p' + i, 32768);
+    }
+  TEST_CHECK(writeBlocks (0, 3, &fh, pages));
+  TEST_CHECK(closePageFile (&fh));
+  ASSERT_TRUE(stat(TESTPF, &st) == 0 && st.st_size == 4 * 32768, "header and data pages are 32 KB each");
+
+  TEST_CHECK(initBufferPool(bm, TESTPF, 2, RS_FIFO, NULL));
+  ASSERT_EQUALS_INT(32768, bm->pageSize, "pool uses the file's page size");
+  TEST_CHECK(pinPage(bm, h, 2));
+  ASSERT_TRUE(h->data[0] == 'r' && h->data[30000] == 'r', "whole large page is pinned");
+  content = sprintPoolPageContent(bm, h);
+  ASSERT_EQUALS_INT(9 + 2 * 32768 + 32768 / 8 + 32768 / 64, (int) strlen(content), "dump shows the whole large page");
+  free(content);
+  TEST_CHECK(unpinPage(bm, h));
+  TEST_CHECK(shutdownBufferPool(bm));
+  TEST_CHECK(destroyPageFile (TESTPF));
+
+  TEST_CHECK(createPageFileWithOptions (TESTPF, &compressedPages));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  memset(ph, 'z', 65536);
+  TEST_CHECK(writeBlock (0, &fh, ph));
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  TEST_CHECK(readBlock (0, &fh, ph));
+  ASSERT_TRUE(ph[65535] == 'z', "64 KB compressed page reads back");
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+
+  free(ph);
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+/* Sequential reads are advised ahead of the reader, random ones are not */
+void
+testReadAhead(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  SM_ReadAheadStats stats;
+  int i;
+
+  testName = "test sequential read-ahead";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  TEST_CHECK(ensureCapacity (256, &fh));
+
+  TEST_CHECK(readFirstBlock (&fh, ph));
+  for (i = 1; i < 100; i++)
+    TEST_CHECK(readNextBlock (&fh, ph));
+  TEST_CHECK(getReadAheadStats (&fh, &stats));
+  ASSERT_EQUALS_INT(100, stats.sequentialReads, "scan is recognized as sequential");
+  ASSERT_TRUE(stats.readAheadPages >= 96, "scan is read ahead");
+  ASSERT_EQUALS_INT(96, stats.readAheadHits, "every read after the first four was advised");
+
+  for (i = 0; i < 10; i++)
+    TEST_CHECK(readBlock ((i * 97) % 256, &fh, ph));
+  TEST_CHECK(getReadAheadStats (&fh, &stats));
+  ASSERT_EQUALS_INT(10, stats.randomReads, "jumps are random reads");
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+
+  free(ph);
+  TEST_DONE();
+}
+
+/* "mem:" page files live in memory only and survive close until destroyed */
+void
+testMemoryBackend(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  struct stat st;
+  int i;
+
+  testName = "test in-memory backend";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  TEST_CHECK(createPageFile ("mem:scratch"));
+  ASSERT_TRUE(stat("mem:scratch", &st) != 0, "nothing is created on disk");
+  TEST_CHECK(openPageFile ("mem:scratch", &fh));
+  TEST_CHECK(ensureCapacity (64, &fh));
+  for (i = 0; i < 64; i += 7)
+    {
+      memset(ph, 'a' + i % 26, PAGE_SIZE);
+      TEST_CHECK(writeBlock (i, &fh, ph));
+    }
+  TEST_CHECK(closePageFile (&fh));
+
+  TEST_CHECK(openPageFile ("mem:scratch", &fh));
+  ASSERT_EQUALS_INT(64, fh.totalNumPages, "size survives close");
+  TEST_CHECK(readBlock (63, &fh, ph));
+  ASSERT_TRUE(ph[0] == 'a' + 63 % 26, "written page reads back");
+  TEST_CHECK(readBlock (5, &fh, ph));
+  ASSERT_TRUE(ph[0] == 0 && ph[PAGE_SIZE - 1] == 0, "unwritten page reads as zeros");
+  TEST_CHECK(closePageFile (&fh));
+  ASSERT_ERROR(openPageFileWithFlags ("mem:scratch", &fh, SM_OPEN_MMAP), "memory files cannot be mapped");
+
+  TEST_CHECK(initBufferPool(bm, "mem:scratch", 4, RS_LRU, NULL));
+  TEST_CHECK(pinPage(bm, h, 7));
+  ASSERT_TRUE(h->data[0] == 'h', "buffer pool reads memory pages");
+  h->data[0] = 'Z';
+  TEST_CHECK(markDirty(bm, h));
+  TEST_CHECK(unpinPage(bm, h));
+  TEST_CHECK(shutdownBufferPool(bm));
+  TEST_CHECK(openPageFile ("mem:scratch", &fh));
+  TEST_CHECK(readBlock (7, &fh, ph));
+  ASSERT_TRUE(ph[0] == 'Z', "buffer pool writes memory pages");
+  TEST_CHECK(closePageFile (&fh));
+
+  TEST_CHECK(destroyPageFile ("mem:scratch"));
+  ASSERT_ERROR(openPageFile ("mem:scratch", &fh), "destroyed memory file is gone");
+
+  free(ph);
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+/* "slow:" files behave like the file they wrap, only later */
+void
+testSlowBackend(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  SM_SlowBackendConfig config;
+  SM_SlowBackendStats stats;
+  struct timespec start, end;
+  long elapsedMicros;
+  int i;
+
+  testName = "test latency-injecting backend";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  memset(&config, 0, sizeof(config));
+  config.readLatencyMicros = 2000;
+  config.slowFraction = 0.5;
+  config.slowLatencyMicros = 1000;
+  config.seed = 42;
+  setSlowBackendConfig(&config);
+
+  TEST_CHECK(createPageFile ("slow:mem:slowfile"));
+  TEST_CHECK(openPageFile ("slow:mem:slowfile", &fh));
+  memset(ph, 's', PAGE_SIZE);
+  TEST_CHECK(writeBlock (0, &fh, ph));
+  setSlowBackendConfig(&config);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < 10; i++)
+    TEST_CHECK(readBlock (0, &fh, ph));
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  elapsedMicros = (end.tv_sec - start.tv_sec) * 1000000L + (end.tv_nsec - start.tv_nsec) / 1000;
+  ASSERT_TRUE(ph[0] == 's', "data passes through unchanged");
+  getSlowBackendStats(&stats);
+  ASSERT_EQUALS_INT(10, stats.reads, "every read is delayed");
+  ASSERT_TRUE(stats.slowIOs > 0 && stats.slowIOs < 10, "some reads are slow ones");
+  ASSERT_EQUALS_INT(20000 + 1000 * stats.slowIOs, stats.delayMicros, "fixed latency plus slow I/Os");
+  ASSERT_TRUE(elapsedMicros >= stats.delayMicros, "reads wait out the delay");
+  TEST_CHECK(closePageFile (&fh));
+
+  /* a bandwidth cap queues transfers behind each other */
+  memset(&config, 0, sizeof(config));
+  config.bandwidthBytesPerSec = 100 * PAGE_SIZE;
+  setSlowBackendConfig(&config);
+  TEST_CHECK(openPageFile ("slow:mem:slowfile", &fh));
+  setSlowBackendConfig(&config);
+  for (i = 0; i < 5; i++)
+    TEST_CHECK(readBlock (0, &fh, ph));
+  getSlowBackendStats(&stats);
+  ASSERT_TRUE(stats.delayMicros >= 5 * 10000, "pages take their transfer time");
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile ("slow:mem:slowfile"));
+  ASSERT_ERROR(openPageFile ("mem:slowfile", &fh), "destroy reaches the wrapped file");
+
+  setSlowBackendConfig(NULL);
+  free(ph);
+  TEST_DONE();
+}
+
+/* Closed files stay open for reuse, up to the cache limit */
+void
+testFileCache(void)
+{
+  SM_FileHandle fh, other;
+  SM_PageHandle ph;
+  SM_FileCacheStats before, after;
+  char *names[3] = { "test_cache_0.bin", "test_cache_1.bin", "test_cache_2.bin" };
+  int i;
+
+  testName = "test open file cache";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  TEST_CHECK(setFileCacheLimit(2));
+  for (i = 0; i < 3; i++)
+    TEST_CHECK(createPageFile (names[i]));
+
+  getFileCacheStats(&before);
+  TEST_CHECK(openPageFile (names[0], &fh));
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(openPageFile (names[0], &fh));
+  getFileCacheStats(&after);
+  ASSERT_EQUALS_INT(1, after.hits - before.hits, "reopening a closed file is a cache hit");
+
+  /* two handles on one file share it */
+  TEST_CHECK(openPageFile (names[0], &other));
+  memset(ph, 'c', PAGE_SIZE);
+  TEST_CHECK(writeBlock (0, &fh, ph));
+  memset(ph, 0, PAGE_SIZE);
+  TEST_CHECK(readBlock (0, &other, ph));
+  ASSERT_TRUE(ph[0] == 'c', "handles on one file see each other's writes");
+  TEST_CHECK(closePageFile (&other));
+  TEST_CHECK(closePageFile (&fh));
+
+  getFileCacheStats(&before);
+  for (i = 0; i < 3; i++)
+    {
+      TEST_CHECK(openPageFile (names[i], &fh));
+      TEST_CHECK(closePageFile (&fh));
+    }
+  getFileCacheStats(&after);
+  ASSERT_EQUALS_INT(2, after.openFiles, "idle files are kept within the limit");
+  ASSERT_TRUE(after.evictions > before.evictions, "least recently used file was closed");
+
+  /* a destroyed and recreated file is not served from a stale descriptor */
+  TEST_CHECK(destroyPageFile (names[2]));
+  TEST_CHECK(createPageFile (names[2]));
+  TEST_CHECK(openPageFile (names[2], &fh));
+  TEST_CHECK(readBlock (0, &fh, ph));
+  ASSERT_TRUE(ph[0] == 0, "recreated file is empty");
+  TEST_CHECK(closePageFile (&fh));
+
+  ASSERT_ERROR(setFileCacheLimit(-1), "negative limit is rejected");
+  TEST_CHECK(setFileCacheLimit(0));
+  getFileCacheStats(&after);
+  ASSERT_EQUALS_INT(0, after.openFiles, "limit 0 closes every idle file");
+  TEST_CHECK(setFileCacheLimit(SM_DEFAULT_FILE_CACHE_LIMIT));
+  for (i = 0; i < 3; i++)
+    TEST_CHECK(destroyPageFile (names[i]));
+
+  free(ph);
+  TEST_DONE();
+}
+
+/* A backup taken while pages are rewritten in order holds a prefix of the
+ * rewritten pages: every page written before the copy's final moment */
+#define BACKUP_PAGES 2048
+#define BACKUP_FILE "test_backup.bin"
+
+static void *
+rewriteThread(void *arg)
+{
+  SM_FileHandle *fh = (SM_FileHandle *) arg;
+  SM_PageHandle ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  long failed = 0;
+  int i;
+
+  memset(ph, 'B', PAGE_SIZE);
+  for (i = 0; i < BACKUP_PAGES; i++)
+    failed |= (writeBlock (i, fh, ph) != RC_OK);
+  free(ph);
+  return (void *) failed;
+}
+
+void
+testOnlineBackup(void)
+{
+  SM_FileHandle fh, backup;
+  SM_PageHandle ph;
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  pthread_t writer;
+  void *result;
+  int i, j, rewritten = 0, consistent = 1;
+
+  testName = "test online backup";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  TEST_CHECK(ensureCapacity (BACKUP_PAGES, &fh));
+  memset(ph, 'A', PAGE_SIZE);
+  for (i = 0; i < BACKUP_PAGES; i++)
+    TEST_CHECK(writeBlock (i, &fh, ph));
+
+  pthread_create(&writer, NULL, rewriteThread, &fh);
+  TEST_CHECK(backupPageFile (TESTPF, BACKUP_FILE));
+  pthread_join(writer, &result);
+  ASSERT_TRUE(result == NULL, "writes continue during the backup");
+
+  TEST_CHECK(openPageFile (BACKUP_FILE, &backup));
+  ASSERT_EQUALS_INT(BACKUP_PAGES, backup.totalNumPages, "backup has every page");
+  for (i = 0; i < BACKUP_PAGES; i++)
+    {
+      TEST_CHECK(readBlock (i, &backup, ph));
+      for (j = 1; j < PAGE_SIZE; j++)
+        consistent &= (ph[j] == ph[0]);
+      if (ph[0] == 'B')
+        consistent &= (rewritten++ == i);
+    }
+  ASSERT_TRUE(consistent, "backup shows the file at one moment");
+  TEST_CHECK(closePageFile (&backup));
+  TEST_CHECK(closePageFile (&fh));
+  ASSERT_ERROR(backupPageFile (TESTPF, TESTPF), "a file cannot be its own backup");
+
+  /* the pool writes its dirty pages and bitmap before copying */
+  TEST_CHECK(initBufferPool(bm, TESTPF, 4, RS_FIFO, NULL));
+  TEST_CHECK(pinPage(bm, h, 3));
+  h->data[0] = 'P';
+  TEST_CHECK(markDirty(bm, h));
+  TEST_CHECK(unpinPage(bm, h));
+  TEST_CHECK(backupBufferPool(bm, "mem:backup"));
+  TEST_CHECK(shutdownBufferPool(bm));
+  TEST_CHECK(openPageFile ("mem:backup", &backup));
+  TEST_CHECK(readBlock (3, &backup, ph));
+  ASSERT_TRUE(ph[0] == 'P', "pool backup holds the pool's dirty page");
+  TEST_CHECK(closePageFile (&backup));
+
+  TEST_CHECK(destroyPageFile ("mem:backup"));
+  TEST_CHECK(destroyPageFile (BACKUP_FILE));
+  TEST_CHECK(destroyPageFile (TESTPF));
+  free(ph);
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+/* Another process attaching to the same segment finds the page this one
+ * loaded and dirtied; it reports back through its exit status */
+#define SHARED_POOL "/test_assign1_pool"
+
+static int
+sharedPoolChild(void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  int status = 0;
+
+  if (initSharedBufferPool(bm, TESTPF, 3, RS_LRU, NULL, SHARED_POOL) != RC_OK)
+    return 1;
+  if (pinPage(bm, h, 5) != RC_OK)
+    return 2;
+  if (h->data[0] != 'S')
+    status = 3;
+  else if (getNumReadIO(bm) != 0)
+    status = 4;
+  h->data[0] = 'C';
+  if (markDirty(bm, h) != RC_OK || unpinPage(bm, h) != RC_OK)
+    status = 5;
+  if (shutdownBufferPool(bm) != RC_OK)
+    status = 6;
+  free(bm);
+  free(h);
+  return status;
+}
+
+void
+testSharedBufferPool(void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_BufferPool *other = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  int *fixCounts;
+  int status;
+  pid_t child;
+
+  testName = "test shared buffer pool";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(initSharedBufferPool(bm, TESTPF, 3, RS_LRU, NULL, SHARED_POOL));
+  ASSERT_ERROR(initSharedBufferPool(other, TESTPF, 4, RS_LRU, NULL, SHARED_POOL),
+               "attaching with another size fails");
+  TEST_CHECK(pinPage(bm, h, 5));
+  h->data[0] = 'S';
+  TEST_CHECK(markDirty(bm, h));
+  TEST_CHECK(unpinPage(bm, h));
+
+  fflush(stdout);
+  child = fork();
+  if (child == 0)
+    _exit(sharedPoolChild());
+  ASSERT_TRUE(child > 0 && waitpid(child, &status, 0) == child, "child process ran");
+  ASSERT_EQUALS_INT(0, WEXITSTATUS(status), "child found the page in the shared pool");
+
+  /* the child's change and flush are visible here */
+  TEST_CHECK(pinPage(bm, h, 5));
+  ASSERT_TRUE(h->data[0] == 'C', "child's write is in the shared frame");
+  fixCounts = getFixCounts(bm);
+  ASSERT_EQUALS_INT(1, fixCounts[0], "pins are counted across processes");
+  free(fixCounts);
+  ASSERT_ERROR(shutdownBufferPool(bm), "a pool with pinned pages cannot shut down");
+  TEST_CHECK(unpinPage(bm, h));
+  ASSERT_EQUALS_INT(1, getNumReadIO(bm), "the page was read once");
+  TEST_CHECK(shutdownBufferPool(bm));
+
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  TEST_CHECK(readBlock (5, &fh, ph));
+  ASSERT_TRUE(ph[0] == 'C', "the shared frame reached the file");
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+  free(ph);
+  free(bm);
+  free(other);
+  free(h);
+  TEST_DONE();
+}
+
+/* A child appends a page through the shared pool and leaves first; the
+ * parent reads it, and closes last without having seen a second append */
+static int
+sharedAppendChild(PageNumber page)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  int status = 0;
+
+  if (initSharedBufferPool(bm, TESTPF, 3, RS_LRU, NULL, SHARED_POOL) != RC_OK)
+    return 1;
+  if (pinPage(bm, h, page) != RC_OK)
+    return 2;
+  h->data[0] = 'A';
+  if (markDirty(bm, h) != RC_OK || unpinPage(bm, h) != RC_OK)
+    status = 3;
+  if (shutdownBufferPool(bm) != RC_OK)
+    status = 4;
+  free(bm);
+  free(h);
+  return status;
+}
+
+void
+testSharedPoolAppend(void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  SM_FileOptions options = { SM_FILE_COMPRESSED, 0 };
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  int status;
+  pid_t child;
+
+  testName = "test pages appended through a shared pool";
+
+  /* compressed files keep their page map per handle */
+  TEST_CHECK(createPageFileWithOptions (TESTPF, &options));
+  ASSERT_EQUALS_INT(RC_INVALID_ARGUMENT, initSharedBufferPool(bm, TESTPF, 3, RS_LRU, NULL, SHARED_POOL),
+                    "compressed files cannot be shared");
+  TEST_CHECK(destroyPageFile (TESTPF));
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  TEST_CHECK(createPageFile (TESTPF));
+  ASSERT_EQUALS_INT(RC_INVALID_ARGUMENT, initSharedBufferPool(bm, TESTPF, 3, RS_LRU, NULL, NULL),
+                    "a shared pool needs a segment name");
+  TEST_CHECK(initSharedBufferPool(bm, TESTPF, 3, RS_LRU, NULL, SHARED_POOL));
+
+  fflush(stdout);
+  child = fork();
+  if (child == 0)
+    _exit(sharedAppendChild(40));
+  ASSERT_TRUE(child > 0 && waitpid(child, &status, 0) == child, "child process ran");
+  ASSERT_EQUALS_INT(0, WEXITSTATUS(status), "child appended a page");
+
+  TEST_CHECK(pinPage(bm, h, 40));
+  ASSERT_TRUE(h->data[0] == 'A', "the appended page is read here");
+  TEST_CHECK(unpinPage(bm, h));
+
+  fflush(stdout);
+  child = fork();
+  if (child == 0)
+    _exit(sharedAppendChild(60));
+  ASSERT_TRUE(child > 0 && waitpid(child, &status, 0) == child, "second child process ran");
+  ASSERT_EQUALS_INT(0, WEXITSTATUS(status), "second child appended a page");
+  TEST_CHECK(shutdownBufferPool(bm));
+
+  /* the last process to close saved a bitmap with the children's pages in it */
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  ASSERT_TRUE(fh.totalNumPages > 60, "the file kept the appended pages");
+  ASSERT_TRUE(isPageAllocated(40, &fh) && isPageAllocated(60, &fh), "the appended pages stay allocated");
+  TEST_CHECK(readBlock (60, &fh, ph));
+  ASSERT_TRUE(ph[0] == 'A', "the appended page reached the file");
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+  free(ph);
+  free(bm);
+  free(h);
+  TEST_DONE();
+}
+
+#ifdef DB_TRACE
+/* Storage calls leave binary records in the trace ring instead of printing */
+void
+testTraceRing(void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle ph;
+  TraceRecord records[16];
+  int count, i, sawRead = 0, sawError = 0;
+
+  testName = "test trace ring buffer";
+
+  ph = (SM_PageHandle) malloc(PAGE_SIZE);
+  traceReset();
+  traceSetLevel(TRACE_DEBUG);
+  traceSetCategories(TRACE_CAT_STORAGE);
+
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(openPageFile (TESTPF, &fh));
+  TEST_CHECK(readBlock (0, &fh, ph));
+  ASSERT_ERROR(readBlock (7, &fh, ph), "reading a missing page fails");
+  TEST_CHECK(closePageFile (&fh));
+  TEST_CHECK(destroyPageFile (TESTPF));
+
+  count = traceSnapshot(records, 16);
+  for (i = 0; i < count; i++)
+    {
+      ASSERT_TRUE(i == 0 || records[i].seq > records[i - 1].seq, "records come out in order");
+      if (records[i].event == TE_SM_READ && records[i].arg1 == 0)
+        sawRead = 1;
+      if (records[i].event == TE_ERR_INVALID_ARGUMENT && records[i].arg0 == 7)
+        sawError = 1;
+    }
+  ASSERT_TRUE(sawRead, "read of page 0 was traced");
+  ASSERT_TRUE(sawError, "failed read of page 7 was traced");
+
+  // filtered out levels leave no records
+  traceReset();
+  traceSetLevel(TRACE_ERROR);
+  TEST_CHECK(createPageFile (TESTPF));
+  TEST_CHECK(destroyPageFile (TESTPF));
+  ASSERT_EQUALS_INT(0, traceSnapshot(records, 16), "debug records are filtered out");
+
+  traceSetLevel(TRACE_WARN);
+  traceSetCategories(TRACE_CAT_ALL);
+  free(ph);
+  TEST_DONE();
+}
+#endif
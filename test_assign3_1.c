@@ -2,6 +2,7 @@
 #include "dberror.h"
 #include "expr.h"
 #include "record_mgr.h"
+#include "storage_mgr.h"
 #include "tables.h"
 #include "test_helper.h"
 
@@ -55,6 +56,13 @@ static void testScans (void);
 static void testScansTwo (void);
 static void testInsertManyRecords(void);
 static void testMultipleScans(void);
+static void testSnapshot(void);
+static void testFreeSpaceReuse(void);
+static void testBulkLoad(void);
+static void testBulkLoadSpaceMap(void);
+static void testScanConditions(void);
+static void testParallelScan(void);
+static void testBatchScan(void);
 
 // struct for test records
 typedef struct TestRecord {
@@ -84,6 +92,13 @@ main (void)
 	testScans();
 	testScansTwo();
 	testMultipleScans();
+	testSnapshot();
+	testFreeSpaceReuse();
+	testBulkLoad();
+	testBulkLoadSpaceMap();
+	testScanConditions();
+	testParallelScan();
+	testBatchScan();
 
 	return 0;
 }
@@ -615,6 +630,560 @@ void testScansTwo (void)
 	TEST_DONE();
 }
 
+// ************************************************************ 
+void
+testSnapshot (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	RM_Snapshot snap;
+	Schema *schema;
+	Record *r;
+	Expr *sel, *left, *right;
+	char *page;
+	int i, rc, numFound = 0;
+	testName = "test frozen table snapshots";
+	schema = testSchema();
+
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTable("test_table_r",schema));
+	TEST_CHECK(openTable(table, "test_table_r"));
+	for(i = 0; i < 1000; i++)
+	{
+		r = testRecord(schema, i, "snap", i % 10);
+		TEST_CHECK(insertRecord(table,r));
+		freeRecord(r);
+	}
+	TEST_CHECK(freezeTable(table, "test_table_snap"));
+
+	// later changes do not reach the snapshot
+	r = testRecord(schema, 1000, "late", 3);
+	TEST_CHECK(insertRecord(table,r));
+	freeRecord(r);
+	TEST_CHECK(closeTable(table));
+
+	// snapshot pages come straight from the mapping
+	TEST_CHECK(openSnapshot(&snap, "test_table_snap"));
+	ASSERT_EQUALS_INT(1000, snap.numTuples, "snapshot keeps the tuple count");
+	TEST_CHECK(getSnapshotPage(&snap, 0, &page));
+	ASSERT_TRUE(getSnapshotPage(&snap, snap.numPages, &page) != RC_OK, "no page past the end");
+
+	MAKE_CONS(left, stringToValue("i3"));
+	MAKE_ATTRREF(right, 2);
+	MAKE_BINOP_EXPR(sel, left, right, OP_COMP_EQUAL);
+	createRecord(&r, schema);
+	TEST_CHECK(startSnapshotScan(&snap, sc, sel));
+	while((rc = next(sc, r)) == RC_OK)
+		numFound++;
+	if (rc != RC_RM_NO_MORE_TUPLES)
+		TEST_CHECK(rc);
+	TEST_CHECK(closeScan(sc));
+	ASSERT_EQUALS_INT(100, numFound, "snapshot scan sees the frozen records");
+	TEST_CHECK(closeSnapshot(&snap));
+
+	TEST_CHECK(deleteTable("test_table_snap"));
+	TEST_CHECK(deleteTable("test_table_r"));
+	TEST_CHECK(shutdownRecordManager());
+
+	freeRecord(r);
+	freeSchema(schema);
+	freeExpr(sel);
+	free(table);
+	free(sc);
+	TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testFreeSpaceReuse (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	int numInserts = 2000, i;
+	PageNumber lastPage = 0;
+	bool reused = TRUE, intact = TRUE;
+	Record *r;
+	RID *rids;
+	Schema *schema;
+	SM_FileHandle fh;
+	SM_PageHandle page;
+	testName = "test inserts reuse space freed by deletes";
+	schema = testSchema();
+	rids = (RID *) malloc(sizeof(RID) * numInserts);
+
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTable("test_table_r",schema));
+	TEST_CHECK(openTable(table, "test_table_r"));
+	for(i = 0; i < numInserts; i++)
+	{
+		r = testRecord(schema, i, "free", i % 10);
+		TEST_CHECK(insertRecord(table,r));
+		rids[i] = r->id;
+		if (r->id.page > lastPage)
+			lastPage = r->id.page;
+		freeRecord(r);
+	}
+	for(i = 0; i < numInserts; i += 2)
+		TEST_CHECK(deleteRecord(table,rids[i]));
+
+	// the free-space map survives closing the table
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(openTable(table, "test_table_r"));
+	for(i = 0; i < numInserts / 2; i++)
+	{
+		r = testRecord(schema, i, "back", i % 10);
+		TEST_CHECK(insertRecord(table,r));
+		reused &= (r->id.page <= lastPage);
+		freeRecord(r);
+	}
+	ASSERT_TRUE(reused, "inserts fill freed slots before appending pages");
+	ASSERT_EQUALS_INT(numInserts, getNumTuples(table), "tuple count after reuse");
+
+	// a stale map (as after an unclean exit) claims the full pages are empty
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(openPageFile("test_table_r", &fh));
+	page = (SM_PageHandle) calloc(1, fh.pageSize);
+	TEST_CHECK(writeBlock(1, &fh, page));
+	TEST_CHECK(closePageFile(&fh));
+	free(page);
+	TEST_CHECK(openTable(table, "test_table_r"));
+	for(i = 0; i < 1000; i++)
+	{
+		r = testRecord(schema, numInserts + i, "late", i % 10);
+		TEST_CHECK(insertRecord(table,r));
+		freeRecord(r);
+	}
+	ASSERT_EQUALS_INT(numInserts * 3 / 2, getNumTuples(table), "inserts succeed with a stale map");
+	createRecord(&r, schema);
+	for(i = 1; i < numInserts; i += 2)
+	{
+		Value *a;
+		TEST_CHECK(getRecord(table, rids[i], r));
+		TEST_CHECK(getAttr(r, schema, 0, &a));
+		intact &= (a->v.intV == i);
+		freeVal(a);
+	}
+	freeRecord(r);
+	ASSERT_TRUE(intact, "records on full pages are not overwritten");
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_r"));
+	TEST_CHECK(shutdownRecordManager());
+
+	freeSchema(schema);
+	free(rids);
+	free(table);
+	TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testBulkLoad (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	int numInserts = 50000, i, rc, numFound = 0;
+	bool same = TRUE;
+	Record **records, *r;
+	RID *rids;
+	Schema *schema;
+	testName = "test bulk loading records";
+	schema = testSchema();
+	rids = (RID *) malloc(sizeof(RID) * numInserts);
+	records = (Record **) malloc(sizeof(Record *) * numInserts);
+
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTable("test_table_r",schema));
+	TEST_CHECK(openTable(table, "test_table_r"));
+	for(i = 0; i < numInserts; i++)
+		records[i] = testRecord(schema, i, "bulk", i % 10);
+	TEST_CHECK(insertRecords(table, records, numInserts, rids));
+	ASSERT_EQUALS_INT(numInserts, getNumTuples(table), "tuple count after the load");
+
+	// records are read back through the buffer pool after reopening
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(openTable(table, "test_table_r"));
+	ASSERT_EQUALS_INT(numInserts, getNumTuples(table), "tuple count is saved");
+	createRecord(&r, schema);
+	for(i = 0; i < numInserts; i += 97)
+	{
+		TEST_CHECK(getRecord(table, rids[i], r));
+		same &= (memcmp(r->data, records[i]->data, getRecordSize(schema)) == 0);
+	}
+	ASSERT_TRUE(same, "loaded records are found under their RIDs");
+	TEST_CHECK(startScan(table, sc, NULL));
+	while((rc = next(sc, r)) == RC_OK)
+		numFound++;
+	if (rc != RC_RM_NO_MORE_TUPLES)
+		TEST_CHECK(rc);
+	TEST_CHECK(closeScan(sc));
+	ASSERT_EQUALS_INT(numInserts, numFound, "scan sees every loaded record");
+
+	// the last loaded page still takes single inserts
+	TEST_CHECK(insertRecord(table, records[0]));
+	ASSERT_EQUALS_INT(rids[numInserts - 1].page, records[0]->id.page, "insert fills the last loaded page");
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_r"));
+	TEST_CHECK(shutdownRecordManager());
+
+	for(i = 0; i < numInserts; i++)
+		freeRecord(records[i]);
+	freeRecord(r);
+	freeSchema(schema);
+	free(records);
+	free(rids);
+	free(sc);
+	free(table);
+	TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testBulkLoadSpaceMap (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	char **names = (char **) malloc(sizeof(char *) * 2);
+	DataType *dt = (DataType *) malloc(sizeof(DataType) * 2);
+	int *sizes = (int *) malloc(sizeof(int) * 2);
+	int *keys = (int *) malloc(sizeof(int));
+	int numInserts = 34000, i;
+	Record **records, *r;
+	Schema *schema;
+	SM_FileHandle fh;
+	SM_PageHandle page;
+	testName = "test bulk loading past a space map page";
+
+	// two records per page, so the load crosses the second map page
+	names[0] = strdup("a");
+	names[1] = strdup("b");
+	dt[0] = DT_INT;
+	dt[1] = DT_STRING;
+	sizes[0] = 0;
+	sizes[1] = 2000;
+	keys[0] = 0;
+	schema = createSchema(2, names, dt, sizes, 1, keys);
+	createRecord(&r, schema);
+	memset(r->data, 'x', getRecordSize(schema));
+	records = (Record **) malloc(sizeof(Record *) * numInserts);
+	for(i = 0; i < numInserts; i++)
+		records[i] = r;
+
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTable("mem:test_table_map",schema));
+	TEST_CHECK(openTable(table, "mem:test_table_map"));
+	TEST_CHECK(insertRecords(table, records, numInserts, NULL));
+
+	// the map page written with the load describes its pages before closeTable
+	TEST_CHECK(openPageFile("mem:test_table_map", &fh));
+	page = (SM_PageHandle) malloc(fh.pageSize);
+	TEST_CHECK(readBlock(1 + (fh.pageSize - PAGE_CHECKSUM_SIZE) * 4 + 1, &fh, page));
+	ASSERT_EQUALS_INT(0xFF, (unsigned char) page[0], "loaded pages are full in the map on disk");
+	TEST_CHECK(closePageFile(&fh));
+	free(page);
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("mem:test_table_map"));
+	TEST_CHECK(shutdownRecordManager());
+
+	freeRecord(r);
+	freeSchema(schema);
+	free(records);
+	free(table);
+	TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testScanConditions (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	int numInserts = 3000, i, rc, expected = 0, numFound = 0;
+	bool inRange = TRUE;
+	Record *r;
+	RID *rids;
+	Schema *schema;
+	Expr *sel, *smaller, *equal, *notEqual, *left, *right;
+	testName = "test scans evaluating conditions in place";
+	schema = testSchema();
+	rids = (RID *) malloc(sizeof(RID) * numInserts);
+
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTable("test_table_r",schema));
+	TEST_CHECK(openTable(table, "test_table_r"));
+	for(i = 0; i < numInserts; i++)
+	{
+		r = testRecord(schema, i, (i % 2) ? "odd" : "even", i % 10);
+		TEST_CHECK(insertRecord(table,r));
+		rids[i] = r->id;
+		freeRecord(r);
+	}
+	for(i = 0; i < numInserts; i += 3)
+		TEST_CHECK(deleteRecord(table,rids[i]));
+	for(i = 0; i < 1000; i++)
+		if (i % 3 != 0 && i % 10 != 3)
+			expected++;
+
+	// a < 1000 AND NOT c = 3, on a table with holes
+	MAKE_ATTRREF(left, 0);
+	MAKE_CONS(right, stringToValue("i1000"));
+	MAKE_BINOP_EXPR(smaller, left, right, OP_COMP_SMALLER);
+	MAKE_ATTRREF(left, 2);
+	MAKE_CONS(right, stringToValue("i3"));
+	MAKE_BINOP_EXPR(equal, left, right, OP_COMP_EQUAL);
+	MAKE_UNOP_EXPR(notEqual, equal, OP_BOOL_NOT);
+	MAKE_BINOP_EXPR(sel, smaller, notEqual, OP_BOOL_AND);
+	createRecord(&r, schema);
+	TEST_CHECK(startScan(table, sc, sel));
+	while((rc = next(sc, r)) == RC_OK)
+	{
+		Value *a;
+		TEST_CHECK(getAttr(r, schema, 0, &a));
+		inRange &= (a->v.intV < 1000 && a->v.intV % 3 != 0 && a->v.intV % 10 != 3);
+		freeVal(a);
+		numFound++;
+	}
+	if (rc != RC_RM_NO_MORE_TUPLES)
+		TEST_CHECK(rc);
+	TEST_CHECK(closeScan(sc));
+	ASSERT_TRUE(inRange, "scan returns only matching records");
+	ASSERT_EQUALS_INT(expected, numFound, "scan returns every matching record");
+	freeExpr(sel);
+
+	// strings fill their attribute without a terminator
+	MAKE_ATTRREF(left, 1);
+	MAKE_CONS(right, stringToValue("seven"));
+	MAKE_BINOP_EXPR(sel, left, right, OP_COMP_EQUAL);
+	TEST_CHECK(startScan(table, sc, sel));
+	numFound = 0;
+	while((rc = next(sc, r)) == RC_OK)
+		numFound++;
+	TEST_CHECK(closeScan(sc));
+	ASSERT_EQUALS_INT(1000, numFound, "string attributes are compared in place");
+	freeExpr(sel);
+
+	// a condition comparing different types fails the scan
+	MAKE_ATTRREF(left, 1);
+	MAKE_CONS(right, stringToValue("i1"));
+	MAKE_BINOP_EXPR(sel, left, right, OP_COMP_EQUAL);
+	TEST_CHECK(startScan(table, sc, sel));
+	ASSERT_EQUALS_INT(RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE, next(sc, r), "type mismatch is reported");
+	TEST_CHECK(closeScan(sc));
+	freeExpr(sel);
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_r"));
+	TEST_CHECK(shutdownRecordManager());
+
+	freeRecord(r);
+	freeSchema(schema);
+	free(rids);
+	free(sc);
+	free(table);
+	TEST_DONE();
+}
+
+// ************************************************************ 
+#define PARALLEL_WORKERS 4
+
+// per-worker results of a parallel scan, written without locking
+typedef struct ParallelScanResult {
+	int count[PARALLEL_WORKERS];
+	long sum[PARALLEL_WORKERS];
+} ParallelScanResult;
+
+static RC
+collectMatch (int worker, Record *record, void *context)
+{
+	ParallelScanResult *result = (ParallelScanResult *) context;
+	int a;
+	memcpy(&a, record->data, sizeof(int));
+	result->count[worker]++;
+	result->sum[worker] += a;
+	return RC_OK;
+}
+
+static RC
+failMatch (int worker, Record *record, void *context)
+{
+	return RC_WRITE_FAILED;
+}
+
+void
+testParallelScan (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	int numInserts = 50000, i, expected = 0, numFound = 0;
+	long expectedSum = 0, sum = 0;
+	ParallelScanResult result;
+	Record **records;
+	RID *rids;
+	Schema *schema;
+	Expr *sel, *left, *right;
+	testName = "test parallel scans";
+	schema = testSchema();
+	rids = (RID *) malloc(sizeof(RID) * numInserts);
+	records = (Record **) malloc(sizeof(Record *) * numInserts);
+
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTable("test_table_r",schema));
+	TEST_CHECK(openTable(table, "test_table_r"));
+	for(i = 0; i < numInserts; i++)
+		records[i] = testRecord(schema, i, "par", i % 10);
+	TEST_CHECK(insertRecords(table, records, numInserts, rids));
+	// deletions still only in the buffer pool must be seen by the workers
+	for(i = 0; i < numInserts; i += 7)
+		TEST_CHECK(deleteRecord(table, rids[i]));
+	for(i = 0; i < 20000; i++)
+		if (i % 7 != 0)
+		{
+			expected++;
+			expectedSum += i;
+		}
+
+	MAKE_ATTRREF(left, 0);
+	MAKE_CONS(right, stringToValue("i20000"));
+	MAKE_BINOP_EXPR(sel, left, right, OP_COMP_SMALLER);
+	memset(&result, 0, sizeof(result));
+	TEST_CHECK(parallelScan(table, sel, PARALLEL_WORKERS, collectMatch, &result));
+	for(i = 0; i < PARALLEL_WORKERS; i++)
+	{
+		numFound += result.count[i];
+		sum += result.sum[i];
+	}
+	ASSERT_EQUALS_INT(expected, numFound, "parallel scan finds every match");
+	ASSERT_TRUE(sum == expectedSum, "each match is reported once");
+
+	// a single worker runs on the calling thread
+	memset(&result, 0, sizeof(result));
+	TEST_CHECK(parallelScan(table, NULL, 1, collectMatch, &result));
+	ASSERT_EQUALS_INT(getNumTuples(table), result.count[0], "one worker sees the whole table");
+
+	ASSERT_EQUALS_INT(RC_WRITE_FAILED, parallelScan(table, sel, PARALLEL_WORKERS, failMatch, NULL),
+			"callback failure stops the scan");
+	ASSERT_EQUALS_INT(RC_INVALID_ARGUMENT, parallelScan(table, sel, 0, collectMatch, &result),
+			"at least one worker");
+	freeExpr(sel);
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_r"));
+	TEST_CHECK(shutdownRecordManager());
+
+	for(i = 0; i < numInserts; i++)
+		freeRecord(records[i]);
+	free(records);
+	free(rids);
+	freeSchema(schema);
+	free(table);
+	TEST_DONE();
+}
+
+// ************************************************************ 
+void
+testBatchScan (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	RM_ColumnBatch *batch, *empty, *wideBatch;
+	int numInserts = 3000, i, rc, expected = 0, numFound = 0, numBatches = 0;
+	bool consistent = TRUE, sameRids = TRUE;
+	Record *r;
+	RID *rids;
+	Schema *schema, *wide;
+	char **wideNames;
+	DataType *wideTypes;
+	Expr *sel, *left, *right;
+	testName = "test batch scans into columns";
+	schema = testSchema();
+	rids = (RID *) malloc(sizeof(RID) * numInserts);
+
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTable("test_table_r",schema));
+	TEST_CHECK(openTable(table, "test_table_r"));
+	for(i = 0; i < numInserts; i++)
+	{
+		r = testRecord(schema, i, (i % 2) ? "odd" : "even", i % 10);
+		TEST_CHECK(insertRecord(table,r));
+		rids[i] = r->id;
+		freeRecord(r);
+	}
+	for(i = 0; i < numInserts; i += 3)
+		TEST_CHECK(deleteRecord(table,rids[i]));
+	for(i = 0; i < numInserts; i++)
+		if (i % 3 != 0 && i % 10 < 5)
+			expected++;
+
+	// c < 5, in batches that end in the middle of pages
+	MAKE_ATTRREF(left, 2);
+	MAKE_CONS(right, stringToValue("i5"));
+	MAKE_BINOP_EXPR(sel, left, right, OP_COMP_SMALLER);
+	TEST_CHECK(createColumnBatch(&batch, schema, 100));
+	TEST_CHECK(startScan(table, sc, sel));
+	while((rc = nextBatch(sc, batch)) == RC_OK)
+	{
+		int *a = (int *) batch->columns[0];
+		char *b = (char *) batch->columns[1];
+		int *c = (int *) batch->columns[2];
+		for(i = 0; i < batch->numSelected; i++)
+		{
+			int row = batch->selection[i];
+			consistent &= (c[row] == a[row] % 10 && c[row] < 5);
+			consistent &= (memcmp(b + row * 4, (a[row] % 2) ? "odd" : "even", 3) == 0);
+			sameRids &= (batch->rids[row].page == rids[a[row]].page && batch->rids[row].slot == rids[a[row]].slot);
+		}
+		numFound += batch->numTuples;
+		numBatches++;
+	}
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "batches end with no more tuples");
+	TEST_CHECK(closeScan(sc));
+	ASSERT_EQUALS_INT(expected, numFound, "batches hold every matching record");
+	ASSERT_EQUALS_INT((expected + 99) / 100, numBatches, "every batch but the last is full");
+	ASSERT_TRUE(consistent, "columns hold the attributes of each record");
+	ASSERT_TRUE(sameRids, "batches carry the RIDs of their records");
+
+	// next and nextBatch continue where the other stopped
+	createRecord(&r, schema);
+	TEST_CHECK(startScan(table, sc, sel));
+	TEST_CHECK(next(sc, r));
+	TEST_CHECK(nextBatch(sc, batch));
+	ASSERT_TRUE(batch->rids[0].page != r->id.page || batch->rids[0].slot != r->id.slot,
+			"batch starts after the record returned by next");
+	TEST_CHECK(closeScan(sc));
+	freeRecord(r);
+
+	ASSERT_EQUALS_INT(RC_INVALID_ARGUMENT, createColumnBatch(&empty, schema, 0), "batches hold at least one tuple");
+
+	// a batch of a wider schema does not fit the scan's records
+	wideNames = (char **) malloc(sizeof(char *) * 4);
+	wideTypes = (DataType *) malloc(sizeof(DataType) * 4);
+	for(i = 0; i < 4; i++)
+	{
+		wideNames[i] = (char *) malloc(2);
+		wideNames[i][0] = 'w' + i;
+		wideNames[i][1] = '\0';
+		wideTypes[i] = DT_INT;
+	}
+	wide = createSchema(4, wideNames, wideTypes, (int *) calloc(4, sizeof(int)), 1, (int *) calloc(1, sizeof(int)));
+	TEST_CHECK(createColumnBatch(&wideBatch, wide, 100));
+	TEST_CHECK(startScan(table, sc, sel));
+	ASSERT_EQUALS_INT(RC_INVALID_ARGUMENT, nextBatch(sc, wideBatch), "batch of another schema is rejected");
+	TEST_CHECK(closeScan(sc));
+	TEST_CHECK(freeColumnBatch(wideBatch));
+	freeSchema(wide);
+	TEST_CHECK(freeColumnBatch(batch));
+	freeExpr(sel);
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_r"));
+	TEST_CHECK(shutdownRecordManager());
+
+	freeSchema(schema);
+	free(rids);
+	free(sc);
+	free(table);
+	TEST_DONE();
+}
+
 
 Schema *
 testSchema (void)
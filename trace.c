@@ -0,0 +1,123 @@
+#include "trace.h"
+
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+
+volatile int traceLevel = TRACE_WARN;
+volatile int traceCategories = TRACE_CAT_ALL;
+
+// ring buffer shared by all threads; writers claim slots with one atomic add
+static TraceRecord ring[TRACE_RING_SIZE];
+static _Atomic uint64_t ringHead = 0;
+
+static const char *eventNames[TE_NUM_EVENTS] = {
+	"SM_INIT", "SM_CREATE", "SM_OPEN", "SM_CLOSE", "SM_DELETE", "SM_READ", "SM_WRITE", "SM_EXTEND",
+	"SM_READAHEAD", "SM_BACKUP",
+	"BM_PIN", "BM_EVICT",
+	"ERR_INVALID_ARGUMENT", "ERR_NO_SUCH_FILE", "ERR_SYSCALL", "ERR_OUT_OF_MEMORY",
+	"ERR_READ_ONLY", "ERR_NOT_MAPPED", "ERR_UNALIGNED_BUFFER",
+	"ERR_CHECKSUM", "ERR_BAD_HEADER", "ERR_PAGE_NOT_RESIDENT", "ERR_PAGE_NOT_PINNED",
+	"ERR_PAGE_PINNED", "ERR_NO_FREE_FRAME"
+};
+
+static const char *levelNames[] = { "ERROR", "WARN", "INFO", "DEBUG" };
+
+void
+traceSetLevel (TraceLevel level)
+{
+	traceLevel = level;
+}
+
+void
+traceSetCategories (int categories)
+{
+	traceCategories = categories;
+}
+
+void
+traceRecord (TraceLevel level, int category, TraceEvent event, int64_t arg0, int64_t arg1)
+{
+	struct timespec now;
+	uint64_t pos = atomic_fetch_add_explicit(&ringHead, 1, memory_order_relaxed);
+	TraceRecord *slot = &ring[pos & (TRACE_RING_SIZE - 1)];
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	// invalidate the slot, fill it in, then publish it under its sequence number
+	atomic_store_explicit((_Atomic uint64_t *) &slot->seq, 0, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	slot->timestampNs = (uint64_t) now.tv_sec * 1000000000ull + now.tv_nsec;
+	slot->event = event;
+	slot->level = level;
+	slot->category = category;
+	slot->arg0 = arg0;
+	slot->arg1 = arg1;
+	atomic_store_explicit((_Atomic uint64_t *) &slot->seq, pos + 1, memory_order_release);
+}
+
+int
+traceSnapshot (TraceRecord *records, int max)
+{
+	uint64_t head = atomic_load_explicit(&ringHead, memory_order_acquire);
+	uint64_t first = (head > TRACE_RING_SIZE) ? head - TRACE_RING_SIZE : 0;
+	int count = 0;
+
+	if (head - first > (uint64_t) max)
+		first = head - max;
+
+	for (uint64_t pos = first; pos < head; pos++)
+	{
+		TraceRecord *slot = &ring[pos & (TRACE_RING_SIZE - 1)];
+		if (atomic_load_explicit((_Atomic uint64_t *) &slot->seq, memory_order_acquire) != pos + 1)
+			continue;
+		records[count] = *slot;
+		// a writer that lapped us while copying leaves a torn record; drop it
+		atomic_thread_fence(memory_order_acquire);
+		if (atomic_load_explicit((_Atomic uint64_t *) &slot->seq, memory_order_relaxed) != pos + 1)
+			continue;
+		records[count].seq = pos + 1;
+		count++;
+	}
+	return count;
+}
+
+void
+traceDump (FILE *out)
+{
+	static TraceRecord records[TRACE_RING_SIZE];
+	int count = traceSnapshot(records, TRACE_RING_SIZE);
+
+	for (int i = 0; i < count; i++)
+	{
+		TraceRecord *r = &records[i];
+		fprintf(out, "%llu %llu.%09llu %s %s %lld %lld\n",
+				(unsigned long long) r->seq,
+				(unsigned long long) (r->timestampNs / 1000000000ull),
+				(unsigned long long) (r->timestampNs % 1000000000ull),
+				(r->level <= TRACE_DEBUG) ? levelNames[r->level] : "?",
+				(r->event < TE_NUM_EVENTS) ? eventNames[r->event] : "?",
+				(long long) r->arg0, (long long) r->arg1);
+	}
+}
+
+void
+traceReset (void)
+{
+	memset(ring, 0, sizeof(ring));
+	atomic_store_explicit(&ringHead, 0, memory_order_release);
+}
+
+int64_t
+traceHashName (const char *name)
+{
+	uint64_t hash = 14695981039346656037ull;
+
+	// FNV-1a
+	while (name != NULL && *name != '\0')
+	{
+		hash ^= (unsigned char) *name++;
+		hash *= 1099511628211ull;
+	}
+	return (int64_t) (hash >> 1);
+}
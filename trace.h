@@ -0,0 +1,108 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/************************************************************
+ *                    levels and categories                 *
+ ************************************************************/
+typedef enum TraceLevel {
+	TRACE_ERROR = 0,
+	TRACE_WARN = 1,
+	TRACE_INFO = 2,
+	TRACE_DEBUG = 3
+} TraceLevel;
+
+#define TRACE_CAT_STORAGE 0x1
+#define TRACE_CAT_BUFFER 0x2
+#define TRACE_CAT_RECORD 0x4
+#define TRACE_CAT_ALL 0xff
+
+/************************************************************
+ *                    events                                *
+ ************************************************************/
+typedef enum TraceEvent {
+	/* storage manager: arg0 = descriptor or name hash, arg1 = page */
+	TE_SM_INIT = 0,
+	TE_SM_CREATE,
+	TE_SM_OPEN,
+	TE_SM_CLOSE,
+	TE_SM_DELETE,
+	TE_SM_READ,
+	TE_SM_WRITE,
+	TE_SM_EXTEND,
+	TE_SM_READAHEAD,
+	TE_SM_BACKUP,
+	/* buffer manager: arg0 = page, arg1 = frame */
+	TE_BM_PIN,
+	TE_BM_EVICT,
+	/* failures: arg0 = errno or page, arg1 = context */
+	TE_ERR_INVALID_ARGUMENT,
+	TE_ERR_NO_SUCH_FILE,
+	TE_ERR_SYSCALL,
+	TE_ERR_OUT_OF_MEMORY,
+	TE_ERR_READ_ONLY,
+	TE_ERR_NOT_MAPPED,
+	TE_ERR_UNALIGNED_BUFFER,
+	TE_ERR_CHECKSUM,
+	TE_ERR_BAD_HEADER,
+	TE_ERR_PAGE_NOT_RESIDENT,
+	TE_ERR_PAGE_NOT_PINNED,
+	TE_ERR_PAGE_PINNED,
+	TE_ERR_NO_FREE_FRAME,
+	TE_NUM_EVENTS
+} TraceEvent;
+
+/* one binary trace record; seq is written last and marks the record complete */
+typedef struct TraceRecord {
+	uint64_t seq;
+	uint64_t timestampNs;
+	uint16_t event;
+	uint8_t level;
+	uint8_t category;
+	int64_t arg0;
+	int64_t arg1;
+} TraceRecord;
+
+/* records kept in the ring before the oldest ones are overwritten (power of two) */
+#define TRACE_RING_SIZE 4096
+
+/************************************************************
+ *                    interface                             *
+ ************************************************************/
+/* runtime filters; only records at or below the level and in one of the
+ * categories are kept */
+extern void traceSetLevel (TraceLevel level);
+extern void traceSetCategories (int categories);
+
+/* append a record to the lock-free ring buffer */
+extern void traceRecord (TraceLevel level, int category, TraceEvent event, int64_t arg0, int64_t arg1);
+
+/* copy up to max of the most recent records, oldest first; returns the count */
+extern int traceSnapshot (TraceRecord *records, int max);
+
+/* print the ring buffer contents in readable form; traceReset empties the
+ * ring and must not race with writers */
+extern void traceDump (FILE *out);
+extern void traceReset (void);
+
+/* stable hash identifying a file name in trace records */
+extern int64_t traceHashName (const char *name);
+
+/* TRACE(level, category, event, arg0, arg1) compiles to nothing unless the
+ * library is built with -DDB_TRACE; arguments are not evaluated when disabled */
+#ifdef DB_TRACE
+extern volatile int traceLevel;
+extern volatile int traceCategories;
+
+#define TRACE(level, category, event, arg0, arg1)				\
+		do {									\
+			if ((int)(level) <= traceLevel && (traceCategories & (category)))	\
+				traceRecord((level), (category), (event), (int64_t)(arg0), (int64_t)(arg1)); \
+		} while (0)
+#else
+#define TRACE(level, category, event, arg0, arg1) do { } while (0)
+#endif
+
+#endif